@@ -4,6 +4,7 @@
 #include <fstream>
 #include <cstdint>
 #include <cmath>
+#include <algorithm>
 
 //include for sajid mnist parsing lib
 #include <stdio.h>
@@ -14,6 +15,11 @@
 const unsigned long MNISTDataSet::CHANNEL_FEATURE = 0;
 const unsigned long MNISTDataSet::CHANNEL_LABEL = 1;
 const unsigned long MNISTDataSet::CHANNEL_SIG_NEWSEQ = 2;
+const unsigned long MNISTDataSet::STREAM_BATCH;
+
+std::mutex MNISTDataSet::corpusMtx;
+infimnist_t *MNISTDataSet::corpus = NULL;
+unsigned long MNISTDataSet::corpusRefCount = 0;
 
 int inputVectorSize = 784;//1024;
 
@@ -30,12 +36,47 @@ MNISTDataSet::MNISTDataSet()
 	featDim = 0;
 	
 	labelDim = 0;
+
+	streamFirst = 0;
+	ringSize = 0;
+	produceTicket = consumeTicket = 0;
+	streamStop = false;
 	
-	p = infimnist_create(datadir);
+	p = AcquireCorpus();
 }
 MNISTDataSet::~MNISTDataSet()
 {
-  infimnist_destroy(p);
+	StopStreaming();
+	ReleaseCorpus();
+}
+
+
+infimnist_t *MNISTDataSet::AcquireCorpus()
+{
+	std::lock_guard<std::mutex> lock(corpusMtx);
+
+	if(corpusRefCount == 0)
+		corpus = infimnist_create(datadir);
+
+	corpusRefCount++;
+
+	return corpus;
+}
+
+
+void MNISTDataSet::ReleaseCorpus()
+{
+	std::lock_guard<std::mutex> lock(corpusMtx);
+
+	verify(corpusRefCount > 0);
+
+	corpusRefCount--;
+
+	if(corpusRefCount == 0)
+	{
+		infimnist_destroy(corpus);
+		corpus = NULL;
+	}
 }
 const unsigned long MNISTDataSet::GetNumChannel() const
 {
@@ -77,18 +118,6 @@ const unsigned long MNISTDataSet::GetNumFrame(const unsigned long seqIdx) const
 	return nFrame[seqIdx];
 }
 
-struct infimnist_s 
-{
-  float (*x)[EXSIZE];               /* x[0]...x[l-1] */
-  float (*fields)[EXSIZE];          /* F[0]...F[nb_fields-1] */
-  float (*tangent)[NTAN][EXSIZE];   /* T[0]...T[2*nb_train-1] */
-  float *y; 			    /* category */
-  float alpha;
-  long  count;
-  long (*cachekeys)[CACHECOLS];
-  unsigned char* (*cacheptr)[CACHECOLS];
-};
-
 void MNISTDataSet::GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
 		const unsigned long frameIdx, FLOAT *const frame)
 {
@@ -101,10 +130,19 @@ void MNISTDataSet::GetFrameData(const unsigned long seqIdx, const unsigned long
 	switch(channelIdx)
 	{
 		case CHANNEL_FEATURE:
-		
-			memcpy(frame, feature[seqIdx].data(), sizeof(FLOAT) * featDim);
+			{
+				const unsigned char *s = (IsStreaming() == true) ? StreamExample(seqIdx, frameIdx) :
+					infimnist_get_pattern(p, feature[seqIdx]);
+
+				for(i = 0; i < featDim; i++)
+				{
+					frame[i] = s[i] / 255.0;
+				}
+			}
 			break;
 		case CHANNEL_LABEL:
+			if(IsStreaming() == true) StreamExample(seqIdx, frameIdx);
+
 			for(i = 0; i < labelDim; i++)
 			{
 #if SIPS
@@ -127,6 +165,42 @@ void MNISTDataSet::GetFrameData(const unsigned long seqIdx, const unsigned long
 	}
 }
 
+const fractal::FrameType MNISTDataSet::GetFrameType(const unsigned long channelIdx) const
+{
+	return (channelIdx == CHANNEL_FEATURE) ? fractal::FRAME_UINT8 : fractal::FRAME_FLOAT;
+}
+
+
+void MNISTDataSet::GetCompactFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+		const unsigned long frameIdx, void *const frame)
+{
+	verify(channelIdx == CHANNEL_FEATURE);
+	verify(seqIdx < nSeq);
+	verify(frameIdx < nFrame[seqIdx]);
+
+	if(IsStreaming() == true)
+	{
+		memcpy(frame, StreamExample(seqIdx, frameIdx), featDim);
+	}
+	else
+	{
+		memcpy(frame, infimnist_get_pattern(p, feature[seqIdx]), featDim);
+	}
+}
+
+
+void MNISTDataSet::GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const
+{
+	unsigned long i;
+
+	verify(channelIdx == CHANNEL_FEATURE);
+
+	for(i = 0; i < 256; i++)
+	{
+		table[i] = i / 255.0;
+	}
+}
+
 void MNISTDataSet::Resize(unsigned long numSamples,unsigned long dimInput,unsigned long dimTarget,unsigned long numFrames)
 {
 	unsigned long i;
@@ -142,31 +216,187 @@ void MNISTDataSet::Resize(unsigned long numSamples,unsigned long dimInput,unsign
 		this->nFrame[i] = numFrames;
 	}
 
+	verify(dimInput <= EXSIZE);
+
 	feature.resize(numSamples);
 	feature.shrink_to_fit();
 	label.resize(numSamples);
 	label.shrink_to_fit();
+}
 
-	for(i=0;i<numSamples;i++)
+void MNISTDataSet::StartStreaming(const long firstIndex, const unsigned long nWorker, const unsigned long ringSize)
+{
+	unsigned long i;
+
+	verify(SIPS == 0);
+	verify(firstIndex >= 0);
+	verify(nWorker > 0 && ringSize > 0);
+
+	StopStreaming();
+
+	if(firstIndex >= TESTNUM + TRAINNUM)
 	{
-		feature[i].resize(dimInput);
-		feature[i].shrink_to_fit();
+		std::lock_guard<std::mutex> lock(corpusMtx);
+		infimnist_load_deformations(p);
+	}
+
+	this->streamFirst = firstIndex;
+	this->ringSize = ringSize;
+	produceTicket = consumeTicket = 0;
+	streamStop = false;
+
+	ringImage.resize(ringSize * EXSIZE);
+	ringIndex.assign(ringSize, -1);
+
+	streamImage.resize(nSeq * featDim);
+	streamFrame.assign(nSeq, -1);
+
+	for(i = 0; i < nWorker; i++)
+	{
+		workers.push_back(std::thread(&MNISTDataSet::StreamWorker, this));
 	}
 }
 
+
+void MNISTDataSet::StopStreaming()
+{
+	std::vector<std::thread>::iterator iter, iter_end;
+
+	if(IsStreaming() == false) return;
+
+	{
+		std::lock_guard<std::mutex> lock(ringMtx);
+		streamStop = true;
+	}
+
+	ringSpaceCv.notify_all();
+
+	iter_end = workers.end();
+	for(iter = workers.begin(); iter != iter_end; ++iter)
+	{
+		iter->join();
+	}
+
+	workers.clear();
+	ringImage.clear();
+	ringImage.shrink_to_fit();
+	ringIndex.clear();
+	ringIndex.shrink_to_fit();
+	streamImage.clear();
+	streamImage.shrink_to_fit();
+	streamFrame.clear();
+	streamFrame.shrink_to_fit();
+}
+
+
+void MNISTDataSet::StreamWorker()
+{
+	unsigned long ticket, slot, n, k;
+	long index[STREAM_BATCH];
+
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(ringMtx);
+
+			/* Wait until the slot of the next ticket has been consumed */
+			while(streamStop == false && produceTicket - consumeTicket >= ringSize)
+				ringSpaceCv.wait(lock);
+
+			if(streamStop == true) return;
+
+			/* Claim up to STREAM_BATCH free slots without wrapping around the ring */
+			ticket = produceTicket;
+			slot = ticket % ringSize;
+			n = std::min(std::min(STREAM_BATCH, ringSize - (produceTicket - consumeTicket)), ringSize - slot);
+			produceTicket += n;
+		}
+
+		for(k = 0; k < n; k++)
+		{
+			index[k] = streamFirst + ticket + k;
+		}
+
+		infimnist_transform_batch(p, index, n, ringImage.data() + slot * EXSIZE);
+
+		{
+			std::lock_guard<std::mutex> lock(ringMtx);
+
+			for(k = 0; k < n; k++)
+			{
+				ringIndex[slot + k] = index[k];
+			}
+		}
+
+		ringReadyCv.notify_all();
+	}
+}
+
+
+const long MNISTDataSet::PopStream(unsigned char *const image)
+{
+	const unsigned long slot = consumeTicket % ringSize;
+	const unsigned char *s = ringImage.data() + slot * EXSIZE;
+	long index;
+
+	{
+		std::unique_lock<std::mutex> lock(ringMtx);
+
+		while(ringIndex[slot] < 0)
+			ringReadyCv.wait(lock);
+
+		index = ringIndex[slot];
+	}
+
+	/* The slot is not reused before consumeTicket advances */
+	memcpy(image, s, featDim);
+
+	{
+		std::lock_guard<std::mutex> lock(ringMtx);
+		ringIndex[slot] = -1;
+		consumeTicket++;
+	}
+
+	ringSpaceCv.notify_one();
+
+	return index;
+}
+
+
+/* Example of the frame, taken from the stream on the first read of the frame */
+const unsigned char *MNISTDataSet::StreamExample(const unsigned long seqIdx, const unsigned long frameIdx)
+{
+	unsigned char *image = streamImage.data() + seqIdx * featDim;
+
+	if(streamFrame[seqIdx] != (long) frameIdx)
+	{
+		feature[seqIdx] = PopStream(image);
+#if !SIPS
+		label[seqIdx] = infimnist_get_label(p, feature[seqIdx]);
+#endif
+		streamFrame[seqIdx] = frameIdx;
+	}
+
+	return image;
+}
+
+
+void MNISTDataSet::BeginSeq(const unsigned long seqIdx)
+{
+	verify(seqIdx < nSeq);
+
+	if(IsStreaming() == true) streamFrame[seqIdx] = -1;
+}
+
+
 int MNISTDataSet::readTestFiles(MNISTDataSet& test_samples)
 {
-	//infimnist_t *p;
-	int i,j;
+	int i;
 	
 	for(i=0;i<10000;i++)
 	{
-		const unsigned char *s = infimnist_get_pattern(p,i);
 		test_samples.label[i] = infimnist_get_label(p,i);
-		for(j=0;j<inputVectorSize;j++)
-		{
-			test_samples.feature[i][j] = s[j]/255.0;
-		}
+		test_samples.feature[i] = i;
 	}
 
 
@@ -176,26 +406,19 @@ int MNISTDataSet::readTestFiles(MNISTDataSet& test_samples)
 
 int MNISTDataSet::readTrainingDevFiles(MNISTDataSet &train_samples, MNISTDataSet &dev_samples)
 {
-	int i,j;
+	int i;
 		
+	/* The features are read from the shared corpus in GetFrameData() */
 	for(i=10000;i<65000;i++)
 	{
-		const unsigned char *s = infimnist_get_pattern(p,i);
 		train_samples.label[i-10000] = infimnist_get_label(p,i);
-		for(j=0;j<inputVectorSize;j++)
-		{
-			train_samples.feature[i-10000][j] = s[j]/255.0;
-		}
+		train_samples.feature[i-10000] = i;
 	}
 
 	for(i=65000;i<70000;i++)
 	{
-		const unsigned char *s = infimnist_get_pattern(p,i);
 		dev_samples.label[i-65000] = infimnist_get_label(p,i);
-		for(j=0;j<inputVectorSize;j++)
-		{
-			dev_samples.feature[i-65000][j] = s[j]/255.0;
-		}
+		dev_samples.feature[i-65000] = i;
 	}
 
 
@@ -5,6 +5,9 @@
 #include <vector>
 #include <string>
 #include <list>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include <fractal/fractal.h>
 #include "infimnist.h"
@@ -20,6 +23,7 @@ public:
 	static const unsigned long CHANNEL_FEATURE;
 	static const unsigned long CHANNEL_LABEL;
 	static const unsigned long CHANNEL_SIG_NEWSEQ;
+	static const unsigned long STREAM_BATCH = 16; /* examples deformed per call by a streaming worker */
 
 	MNISTDataSet();
 	~MNISTDataSet();
@@ -32,14 +36,43 @@ public:
 
 	void GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx, const unsigned long frameIdx, FLOAT *const frame);
 
+	/* The feature channel is the 8-bit image; code c stands for c / 255 */
+	const fractal::FrameType GetFrameType(const unsigned long channelIdx) const;
+	void GetCompactFrameData(const unsigned long seqIdx, const unsigned long channelIdx, const unsigned long frameIdx, void *const frame);
+	void GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const;
+
+	void BeginSeq(const unsigned long seqIdx);
+
 	int readTestFiles(MNISTDataSet &test_samples);
 	int readTrainingDevFiles(MNISTDataSet &train_samples, MNISTDataSet &dev_samples);
 	
 	void Resize(unsigned long numSamples,unsigned long dimInput,unsigned  long dimTarget,unsigned long numFrames);
 
+	/* Infinite MNIST: every frame is the next example firstIndex, firstIndex + 1, ... (deformed training
+	 * examples from index 70000 on), taken from the stream when any channel first reads the frame. The
+	 * example stays with (seqIdx, frameIdx) for all channels and repeated reads until BeginSeq(seqIdx)
+	 * starts the sequence again, so the label always matches the features (one image per sequence is
+	 * kept). nWorker threads compute the examples ahead into a ring of ringSize images, in the same
+	 * order for any number of workers. */
+	void StartStreaming(const long firstIndex, const unsigned long nWorker, const unsigned long ringSize);
+	void StopStreaming();
+	inline const bool IsStreaming() const { return workers.empty() == false; }
+
 	unsigned long LT;
-	infimnist_t *p;
+	infimnist_t *p; /* shared by all instances */
 protected:
+	/* The corpus is loaded by the first instance and destroyed with the last one */
+	static infimnist_t *AcquireCorpus();
+	static void ReleaseCorpus();
+
+	void StreamWorker();
+	const long PopStream(unsigned char *const image);
+	const unsigned char *StreamExample(const unsigned long seqIdx, const unsigned long frameIdx);
+
+	static std::mutex corpusMtx;
+	static infimnist_t *corpus;
+	static unsigned long corpusRefCount;
+
 	//typedef std::unordered_map<std::string, unsigned long> LabelTable;
 
 	
@@ -51,14 +84,27 @@ protected:
 	
 	std::vector<unsigned long> nFrame;
 
-	std::vector<std::vector<FLOAT>> feature;
-	//std::vector<std::vector<unsigned char>> feature;
+	std::vector<long> feature; /* index of the pattern in the corpus */
 #if SIPS
 	std::vector<std::vector<unsigned long>> label;
 #else
 	std::vector<unsigned long> label;
 #endif
 	//LabelTable labelTable;
+
+	/* Streaming: ticket t is the example streamFirst + t in slot t % ringSize */
+	long streamFirst;
+	unsigned long ringSize;
+	unsigned long produceTicket, consumeTicket;
+	bool streamStop;
+	std::vector<unsigned char> ringImage;
+	std::vector<long> ringIndex; /* -1 while the slot is being computed or consumed */
+	std::mutex ringMtx;
+	std::condition_variable ringSpaceCv, ringReadyCv;
+	std::vector<std::thread> workers;
+
+	std::vector<unsigned char> streamImage; /* example of each sequence */
+	std::vector<long> streamFrame; /* frame of the example of each sequence, -1: none */
 };
 
 
@@ -29,6 +29,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__FMA__) && (defined(__AVX512F__) || defined(__AVX2__))
+#include <immintrin.h>
+#endif
 
 #define ASSERTFAIL(f,l) do {                         \
     fprintf(stderr,"Assertion failed: %s:%d\n",f,l); \
@@ -53,16 +59,43 @@
 
 
 
+/* Pattern cache: CACHESHARDS independently locked hash tables. Each entry
+   is pinned while acquired and is only evicted (oldest first) when unpinned. */
+
+typedef struct infimnist_entry_s
+{
+  long key;
+  long pins;
+  struct infimnist_entry_s *hnext;        /* hash chain */
+  struct infimnist_entry_s *prev, *next;  /* eviction order, newest first */
+  unsigned char data[EXSIZE];
+} infimnist_entry_t;
+
+typedef struct infimnist_shard_s
+{
+  pthread_mutex_t lock;
+  infimnist_entry_t **buckets;
+  long nbuckets;
+  infimnist_entry_t *head, *tail;
+  long count, maxcount;
+  long hits, misses, evictions;
+} infimnist_shard_t;
+
 struct infimnist_s 
 {
-  float (*x)[EXSIZE];               /* x[0]...x[l-1] */
+  unsigned char (*x)[EXSIZE];       /* x[0]...x[l-1] */
   float (*fields)[EXSIZE];          /* F[0]...F[nb_fields-1] */
   float (*tangent)[NTAN][EXSIZE];   /* T[0]...T[2*nb_train-1] */
-  float *y; 			    /* category */
+  unsigned char *y; 		    /* category */
   float alpha;
   long  count;
-  long (*cachekeys)[CACHECOLS];
-  unsigned char* (*cacheptr)[CACHECOLS];
+  infimnist_shard_t *shards;
+  int policy;
+  long maxbytes;
+  pthread_mutex_t recentlock;
+  long recent[CACHERECENT];         /* pinned by infimnist_get_pattern */
+  long recentpos;
+  char *dir;
 };
 
 static void
@@ -89,49 +122,137 @@ load_float_dataset(const char *dir, const char *file, int nbp, int s, int bla, f
 }
 
 static void
-load_ubyte_dataset(const char *dir, const char *file, int nbp, int s, int bla, float *into)
+load_ubyte_dataset(const char *dir, const char *file, int nbp, int s, int bla, unsigned char *into)
 {
-  int i,j;
   FILE *fid;
   char *filename = (char*)malloc(strlen(dir)+strlen(file)+4);
-  unsigned char *temp = (unsigned char*)malloc(s);
   ASSERT(filename);
-  ASSERT(temp);
   strcpy(filename, dir);
   strcat(filename, "");
   strcat(filename, file);
   fid = fopen(filename, "rb");
   ASSERTX(fid, fprintf(stderr,"Cannot open file \"%s\"\n", filename));
   fseek(fid, bla, SEEK_SET);
-  for (i=0; i<nbp; i++)
-    {
-      int r = fread(temp, 1, s, fid);
-      ASSERT(r == s);
-      for (j=0; j<s; j++)
-        *into++ = (float)temp[j];
-    }
+  /* The images stay in bytes; the deformation converts them on the fly */
+  int r = fread(into, 1, (size_t)nbp * s, fid);
+  ASSERT(r == nbp * s);
   fclose(fid);
   free(filename);
-  free(temp);
+}
+
+static void infimnist_release_recent(infimnist_t *p);
+
+static void
+cache_init(infimnist_t *p, long maxbytes, int policy)
+{
+  int i;
+  long maxcount = maxbytes / (long)sizeof(infimnist_entry_t) / CACHESHARDS;
+  long nbuckets = 16;
+  if (maxcount < 1)
+    maxcount = 1;
+  while (nbuckets < maxcount)
+    nbuckets *= 2;
+  p->maxbytes = maxbytes;
+  p->policy = policy;
+  p->shards = (infimnist_shard_t*)malloc(CACHESHARDS*sizeof(infimnist_shard_t));
+  ASSERT(p->shards);
+  for (i=0; i<CACHESHARDS; i++)
+    {
+      infimnist_shard_t *sh = &p->shards[i];
+      memset(sh, 0, sizeof(infimnist_shard_t));
+      pthread_mutex_init(&sh->lock, NULL);
+      sh->buckets = (infimnist_entry_t**)calloc(nbuckets, sizeof(infimnist_entry_t*));
+      ASSERT(sh->buckets);
+      sh->nbuckets = nbuckets;
+      sh->maxcount = maxcount;
+    }
+}
+
+static void
+cache_free(infimnist_t *p)
+{
+  int i;
+  infimnist_cache_clear(p);
+  for (i=0; i<CACHESHARDS; i++)
+    {
+      ASSERTX(p->shards[i].count == 0,
+              fprintf(stderr,"Acquired infimnist patterns were not released\n"));
+      pthread_mutex_destroy(&p->shards[i].lock);
+      free(p->shards[i].buckets);
+    }
+  free(p->shards);
+  p->shards = NULL;
+}
+
+static unsigned long
+cache_hash(long i)
+{
+  unsigned long h = (unsigned long)i * 0x9E3779B97F4A7C15UL;
+  return h ^ (h >> 29);
+}
+
+static infimnist_entry_t **
+cache_find(infimnist_shard_t *sh, unsigned long h, long i)
+{
+  infimnist_entry_t **e = &sh->buckets[(h / CACHESHARDS) & (sh->nbuckets - 1)];
+  while (*e && (*e)->key != i)
+    e = &(*e)->hnext;
+  return e;
+}
+
+static void
+cache_unlink(infimnist_shard_t *sh, infimnist_entry_t *e)
+{
+  if (e->prev) e->prev->next = e->next; else sh->head = e->next;
+  if (e->next) e->next->prev = e->prev; else sh->tail = e->prev;
+  e->prev = e->next = NULL;
+}
+
+static void
+cache_push_front(infimnist_shard_t *sh, infimnist_entry_t *e)
+{
+  e->prev = NULL;
+  e->next = sh->head;
+  if (sh->head) sh->head->prev = e; else sh->tail = e;
+  sh->head = e;
+}
+
+/* Remove unpinned entries, oldest first, until the shard fits its cap */
+static void
+cache_evict(infimnist_shard_t *sh)
+{
+  infimnist_entry_t *e = sh->tail;
+  while (sh->count > sh->maxcount && e)
+    {
+      infimnist_entry_t *prev = e->prev;
+      if (e->pins == 0)
+        {
+          infimnist_entry_t **h = cache_find(sh, cache_hash(e->key), e->key);
+          *h = e->hnext;
+          cache_unlink(sh, e);
+          free(e);
+          sh->count--;
+          sh->evictions++;
+        }
+      e = prev;
+    }
 }
 
 infimnist_t *
 infimnist_create(const char *dirname)
 {
-  int i,j;
+  int i;
   infimnist_t *p;
   const char *dir = (dirname) ? dirname : "";
   p = (infimnist_t*)malloc(sizeof(infimnist_t));
   ASSERT(p);
   memset(p, 0, sizeof(infimnist_t));
-  p->x = (void*)malloc(EXSIZE*(TESTNUM+TRAINNUM)*sizeof(float));
+  p->x = (void*)malloc(EXSIZE*(TESTNUM+TRAINNUM)*sizeof(unsigned char));
   //p->fields = (void*)malloc(EXSIZE*FIELDNUM*sizeof(float));
   //p->tangent = (void*)malloc(EXSIZE*NTAN*TRAINNUM*sizeof(float));
-  p->y = (float*)malloc((TESTNUM+TRAINNUM)*sizeof(float));
+  p->y = (unsigned char*)malloc((TESTNUM+TRAINNUM)*sizeof(unsigned char));
   //ASSERT(p->x && p->fields && p->tangent && p->y);
-  p->cachekeys = (void*)malloc((CACHEROWS*CACHECOLS)*sizeof(long));
-  p->cacheptr = (void*)malloc((CACHEROWS*CACHECOLS)*sizeof(void*));
-  ASSERT(p->cachekeys && p->cacheptr);
+  ASSERT(p->x && p->y);
 
   load_ubyte_dataset(dir, T10K_IMAGES, TESTNUM, EXSIZE, 16, &p->x[0][0]);
   load_ubyte_dataset(dir, T10K_LABELS, TESTNUM, 1, 8, &p->y[0]);
@@ -139,29 +260,72 @@ infimnist_create(const char *dirname)
   load_ubyte_dataset(dir, TRAIN_LABELS, TRAINNUM, 1, 8, &p->y[TESTNUM]);
   //load_float_dataset(dir, DEFORM_FIELDS, FIELDNUM, EXSIZE, 0, &p->fields[0][0]);
   //load_float_dataset(dir, TRAIN_TANGENTS, TRAINNUM*NTAN, EXSIZE, 0, &p->tangent[0][0][0]);
+  p->dir = strdup(dir);
+  ASSERT(p->dir);
   p->alpha = 1.00;
   p->count = 0;
-  for (i=0; i<CACHEROWS; i++)
-    for (j=0; j<CACHECOLS; j++)
-      {
-        p->cachekeys[i][j] = -1;
-        p->cacheptr[i][j] = NULL;
-      }
+  pthread_mutex_init(&p->recentlock, NULL);
+  for (i=0; i<CACHERECENT; i++)
+    p->recent[i] = -1;
+  p->recentpos = 0;
+  cache_init(p, CACHEBYTES, INFIMNIST_CACHE_LRU);
   return p;
 }
 
 void 
 infimnist_cache_clear(infimnist_t *p)
 {
-  int i,j;
-  for (i=0; i<CACHEROWS; i++)
-    for (j=0; j<CACHECOLS; j++)
-      {
-        p->cachekeys[i][j] = -1;
-        if (p->cacheptr[i][j])
-          free(p->cacheptr[i][j]);
-        p->cacheptr[i][j] = NULL;
-      }
+  int i;
+  infimnist_entry_t *e, *next;
+  for (i=0; i<CACHESHARDS; i++)
+    {
+      infimnist_shard_t *sh = &p->shards[i];
+      pthread_mutex_lock(&sh->lock);
+      for (e = sh->head; e; e = next)
+        {
+          next = e->next;
+          if (e->pins == 0)
+            {
+              infimnist_entry_t **h = cache_find(sh, cache_hash(e->key), e->key);
+              *h = e->hnext;
+              cache_unlink(sh, e);
+              free(e);
+              sh->count--;
+            }
+        }
+      pthread_mutex_unlock(&sh->lock);
+    }
+}
+
+void
+infimnist_cache_config(infimnist_t *p, long maxbytes, int policy)
+{
+  ASSERT(maxbytes >= 0);
+  ASSERT(policy == INFIMNIST_CACHE_LRU || policy == INFIMNIST_CACHE_FIFO);
+  infimnist_release_recent(p);
+  cache_free(p);
+  cache_init(p, maxbytes, policy);
+}
+
+void
+infimnist_cache_stats(infimnist_t *p, long *hits, long *misses, long *evictions, long *bytes)
+{
+  int i;
+  long h = 0, m = 0, e = 0, n = 0;
+  for (i=0; i<CACHESHARDS; i++)
+    {
+      infimnist_shard_t *sh = &p->shards[i];
+      pthread_mutex_lock(&sh->lock);
+      h += sh->hits;
+      m += sh->misses;
+      e += sh->evictions;
+      n += sh->count;
+      pthread_mutex_unlock(&sh->lock);
+    }
+  if (hits) *hits = h;
+  if (misses) *misses = m;
+  if (evictions) *evictions = e;
+  if (bytes) *bytes = n * (long)sizeof(infimnist_entry_t);
 }
 
 void 
@@ -169,8 +333,12 @@ infimnist_destroy(infimnist_t *p)
 {
   if (p) 
     {
-      if (p->cachekeys && p->cacheptr)
-        infimnist_cache_clear(p);
+      if (p->shards)
+        {
+          infimnist_release_recent(p);
+          cache_free(p);
+        }
+      pthread_mutex_destroy(&p->recentlock);
       if (p->x) 
         free(p->x);
       if (p->y) 
@@ -179,10 +347,8 @@ infimnist_destroy(infimnist_t *p)
         free(p->fields);
       if (p->tangent) 
         free(p->tangent);
-      if (p->cachekeys) 
-        free(p->cachekeys);
-      if (p->cacheptr)
-        free(p->cacheptr);
+      if (p->dir)
+        free(p->dir);
       free(p);
     }
 }
@@ -199,8 +365,10 @@ infimnist_get_label(infimnist_t *p, long i)
 }
 
 
-unsigned char *
-translation(unsigned char *c, int t)
+/* The translations only move pixels, so that the same code computes the
+   shift maps of <shift_maps> on arrays of indices */
+template<class T> static T *
+translate(T *c, int t)
 {
   int i;
   switch (t)
@@ -234,20 +402,20 @@ translation(unsigned char *c, int t)
       c[0] = 0;
       break;
     case 4: // 0 & 2
-      c = translation(c, 0);
-      c = translation(c, 2);
+      c = translate(c, 0);
+      c = translate(c, 2);
       break;
     case 5: // 0 & 3
-      c = translation(c, 0);
-      c = translation(c, 3);
+      c = translate(c, 0);
+      c = translate(c, 3);
       break;
     case 6: // 1 & 2
-      c = translation(c, 1);
-      c = translation(c, 2);
+      c = translate(c, 1);
+      c = translate(c, 2);
       break;
     case 7: // 1 & 3
-      c = translation(c, 1);
-      c = translation(c, 3);
+      c = translate(c, 1);
+      c = translate(c, 3);
       break;
     case 8: // nothing
       break;
@@ -255,66 +423,256 @@ translation(unsigned char *c, int t)
   return c;
 }
 
+void
+infimnist_load_deformations(infimnist_t *p)
+{
+  if (p->fields && p->tangent)
+    return;
+  p->fields = (void*)malloc(EXSIZE*FIELDNUM*sizeof(float));
+  p->tangent = (void*)malloc(EXSIZE*NTAN*TRAINNUM*sizeof(float));
+  ASSERT(p->fields && p->tangent);
+  load_float_dataset(p->dir, DEFORM_FIELDS, FIELDNUM, EXSIZE, 0, &p->fields[0][0]);
+  load_float_dataset(p->dir, TRAIN_TANGENTS, TRAINNUM*NTAN, EXSIZE, 0, &p->tangent[0][0][0]);
+}
+
+
+unsigned char *
+translation(unsigned char *c, int t)
+{
+  return translate(c, t);
+}
+
+
+/* Source of each pixel of the 9 translations: 1 + index, or 0 for a blank pixel */
+static short shiftmap[9][EXSIZE];
+static pthread_once_t shiftmaponce = PTHREAD_ONCE_INIT;
+
+static void
+shift_maps(void)
+{
+  int t,j;
+  for (t=0; t<9; t++)
+    {
+      for (j=0; j<EXSIZE; j++)
+        shiftmap[t][j] = (short)(j + 1);
+      translate(shiftmap[t], t);
+    }
+}
+
+
+/* s = clamp(x + alpha * (f1 * t0 - f2 * t1)) truncated to bytes. The vector
+   kernels are only built with FMA, and on such builds the scalar loop rounds
+   as fmaf(alpha, fmaf(f1, t0, -(f2 * t1)), x) to give the same bytes, so the
+   reference output is the fused form. Without FMA the scalar loop keeps the
+   original unfused expression. */
+static void
+deform_vector(const unsigned char *x, const float *f1, const float *t0,
+              const float *f2, const float *t1, float alpha, unsigned char *s)
+{
+  int j = 0;
+#if defined(__FMA__) && defined(__AVX512F__)
+  const __m512 va = _mm512_set1_ps(alpha);
+  const __m512 vlo = _mm512_setzero_ps();
+  const __m512 vhi = _mm512_set1_ps(255.0f);
+  for (; j + 16 <= EXSIZE; j += 16)
+    {
+      __m512 vx = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(x + j))));
+      __m512 m = _mm512_mul_ps(_mm512_loadu_ps(f2 + j), _mm512_loadu_ps(t1 + j));
+      __m512 d = _mm512_fmsub_ps(_mm512_loadu_ps(f1 + j), _mm512_loadu_ps(t0 + j), m);
+      __m512 v = _mm512_min_ps(_mm512_max_ps(_mm512_fmadd_ps(va, d, vx), vlo), vhi);
+      _mm_storeu_si128((__m128i*)(s + j), _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(v)));
+    }
+#elif defined(__FMA__) && defined(__AVX2__)
+  const __m256 va = _mm256_set1_ps(alpha);
+  const __m256 vlo = _mm256_setzero_ps();
+  const __m256 vhi = _mm256_set1_ps(255.0f);
+  for (; j + 8 <= EXSIZE; j += 8)
+    {
+      __m256 vx = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(x + j))));
+      __m256 m = _mm256_mul_ps(_mm256_loadu_ps(f2 + j), _mm256_loadu_ps(t1 + j));
+      __m256 d = _mm256_fmsub_ps(_mm256_loadu_ps(f1 + j), _mm256_loadu_ps(t0 + j), m);
+      __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_fmadd_ps(va, d, vx), vlo), vhi);
+      __m256i w = _mm256_cvttps_epi32(v);
+      __m128i h = _mm_packus_epi32(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+      _mm_storel_epi64((__m128i*)(s + j), _mm_packus_epi16(h, h));
+    }
+#endif
+  for (; j < EXSIZE; j++)
+    {
+#if defined(__FMA__)
+      float v = fmaf(alpha, fmaf(f1[j], t0[j], -(f2[j] * t1[j])), (float)x[j]);
+#else
+      float v = x[j] + alpha * (f1[j] * t0[j] - f2[j] * t1[j]);
+#endif
+      if (v < 0) 
+        s[j] = 0;
+      else if (v > 255) 
+        s[j] = 255;
+      else
+        s[j] = (unsigned char)(int)v;
+    }
+}
+
+
 unsigned char *
 compute_transformed_vector(infimnist_t *p, long i)
 {
-  float alpha;
-  int j,a,k1,k2;
   unsigned char *s;
   ASSERT(i >= 0);
   s = (unsigned char*)malloc(EXSIZE);
   ASSERT(s);
+  infimnist_transform(p, i, s);
+  return s;
+}
+
+
+void
+infimnist_transform(infimnist_t *p, long i, unsigned char *s)
+{
+  float alpha;
+  int j,a,k1,k2;
+  const short *map;
+  unsigned char d[EXSIZE + 1];
+  ASSERT(i >= 0);
   if (i < TESTNUM+TRAINNUM)
     {
-      for (j=0; j<EXSIZE; j++)
-        s[j] = p->x[i][j];
-      return s;
+      memcpy(s, p->x[i], EXSIZE);
+      return;
     }
+  ASSERTX(p->fields && p->tangent,
+          fprintf(stderr,"Deformations are not loaded (infimnist_load_deformations)\n"));
+  pthread_once(&shiftmaponce, shift_maps);
   k1 = (int)(((unsigned long)(i*131071L))%(FIELDNUM-1));
   k2 = (int)(((unsigned long)(k1+1+2*i))%FIELDNUM);
   a = (int)((unsigned long)(i-TESTNUM)%TRAINNUM);
   alpha = p->alpha;
   if ((k1 + k2) & 1)
     alpha = -alpha;
+  /* d[0] is the blank pixel of the shift maps */
+  d[0] = 0;
+  deform_vector(p->x[a+TESTNUM], p->fields[k1], p->tangent[a][0],
+                p->fields[k2], p->tangent[a][1], alpha, d + 1);
+  map = shiftmap[k1 % 9];
   for (j=0; j<EXSIZE; j++)
-    {
-      float x = p->x[a+TESTNUM][j] +
-        alpha * (p->fields[k1][j] * p->tangent[a][0][j] -
-                 p->fields[k2][j] * p->tangent[a][1][j] );
-      if (x < 0) 
-        s[j] = 0;
-      else if (x > 255) 
-        s[j] = 255;
-      else
-        s[j] = (unsigned char)(int)x;
-    }
-  return translation(s, k1 % 9);
+    s[j] = d[map[j]];
+}
+
+
+void
+infimnist_transform_batch(infimnist_t *p, const long *index, int n, unsigned char *s)
+{
+  int k;
+  for (k=0; k<n; k++)
+    infimnist_transform(p, index[k], s + (long)k * EXSIZE);
 }
 
 
 const unsigned char *
-infimnist_get_pattern(infimnist_t *p, long i)
+infimnist_acquire_pattern(infimnist_t *p, long i)
 {
-  int j, b;
-  unsigned char *s;
+  unsigned long h;
+  infimnist_shard_t *sh;
+  infimnist_entry_t **e, *n;
   ASSERTX(i >= 0, fprintf(stderr,"Invalid infimnist index\n"));
-  b = (int)(i % CACHEROWS);
-  for (j=0; j<CACHECOLS; j++)
-    if (i == p->cachekeys[b][j])
-      return p->cacheptr[b][j];
-  s = compute_transformed_vector(p, i);
-  for (j=0; j<CACHECOLS; j++)
-    if (p->cachekeys[b][j] < 0)
+  /* The original examples are not deformed; they are read from the corpus */
+  if (i < TESTNUM+TRAINNUM)
+    return p->x[i];
+  h = cache_hash(i);
+  sh = &p->shards[h % CACHESHARDS];
+  pthread_mutex_lock(&sh->lock);
+  e = cache_find(sh, h, i);
+  if (*e)
+    {
+      n = *e;
+      n->pins++;
+      sh->hits++;
+      if (p->policy == INFIMNIST_CACHE_LRU)
+        {
+          cache_unlink(sh, n);
+          cache_push_front(sh, n);
+        }
+      pthread_mutex_unlock(&sh->lock);
+      return n->data;
+    }
+  sh->misses++;
+  pthread_mutex_unlock(&sh->lock);
+  /* Deform outside of the lock */
+  n = (infimnist_entry_t*)malloc(sizeof(infimnist_entry_t));
+  ASSERT(n);
+  infimnist_transform(p, i, n->data);
+  n->key = i;
+  n->pins = 1;
+  pthread_mutex_lock(&sh->lock);
+  e = cache_find(sh, h, i);
+  if (*e)
+    {
+      /* Another thread inserted it in the meantime */
+      free(n);
+      n = *e;
+      n->pins++;
+    }
+  else
+    {
+      n->hnext = NULL;
+      *e = n;
+      cache_push_front(sh, n);
+      sh->count++;
+      cache_evict(sh);
+    }
+  pthread_mutex_unlock(&sh->lock);
+  return n->data;
+}
+
+
+void
+infimnist_release_pattern(infimnist_t *p, long i)
+{
+  unsigned long h;
+  infimnist_shard_t *sh;
+  infimnist_entry_t **e;
+  if (i < TESTNUM+TRAINNUM)
+    return;
+  h = cache_hash(i);
+  sh = &p->shards[h % CACHESHARDS];
+  pthread_mutex_lock(&sh->lock);
+  e = cache_find(sh, h, i);
+  ASSERTX(*e && (*e)->pins > 0, fprintf(stderr,"Releasing an infimnist pattern that is not acquired\n"));
+  (*e)->pins--;
+  cache_evict(sh);
+  pthread_mutex_unlock(&sh->lock);
+}
+
+
+static void
+infimnist_release_recent(infimnist_t *p)
+{
+  int j;
+  pthread_mutex_lock(&p->recentlock);
+  for (j=0; j<CACHERECENT; j++)
+    if (p->recent[j] >= 0)
       {
-        p->cachekeys[b][j] = i;
-        p->cacheptr[b][j] = s;
-        return s;
+        infimnist_release_pattern(p, p->recent[j]);
+        p->recent[j] = -1;
       }
-  j = (p->count++) % CACHECOLS;
-  free (p->cacheptr[b][j]);
-  p->cacheptr[b][j] = s;
-  p->cachekeys[b][j] = i;
-  return s;
+  pthread_mutex_unlock(&p->recentlock);
 }
 
 
+const unsigned char *
+infimnist_get_pattern(infimnist_t *p, long i)
+{
+  const unsigned char *s;
+  long old;
+  s = infimnist_acquire_pattern(p, i);
+  if (i < TESTNUM+TRAINNUM)
+    return s;
+  /* Keep the last CACHERECENT patterns pinned */
+  pthread_mutex_lock(&p->recentlock);
+  old = p->recent[p->recentpos];
+  p->recent[p->recentpos] = i;
+  p->recentpos = (p->recentpos + 1) % CACHERECENT;
+  pthread_mutex_unlock(&p->recentlock);
+  if (old >= 0)
+    infimnist_release_pattern(p, old);
+  return s;
+}
@@ -39,7 +39,7 @@
 typedef struct infimnist_s infimnist_t;
 
 /* Function <infimnist_create> creates the infimnist_t data structure that
-   contains the digit data (about 450MB) and caches up to about 1GB worth of
+   contains the digit data (about 55MB, kept in bytes) and caches up to about 1GB worth of
    deformed digit images. The argument <datadir> points to the directory
    containing the data files. Setting it to NULL implicitly selects the
    directory named "data" in the current directory. */
@@ -64,15 +64,68 @@ int infimnist_get_label(infimnist_t*, long index);
    resulting pointer as it directly points into the pattern cache. These
    vectors may be automatically deallocated in the future.  However, at any
    time, you can safely access the last ten vectors returned by this
-   function. */
+   function. The ten are counted over all threads, so that concurrent
+   callers should use <infimnist_acquire_pattern> instead. The examples 0
+   to 69999 point directly into the read-only corpus and remain valid until
+   <infimnist_destroy> is called. */
 
 const unsigned char *infimnist_get_pattern(infimnist_t*, long index);
 
+/* Functions <infimnist_acquire_pattern> and <infimnist_release_pattern>
+   give a stable lifetime: the pattern returned by the former is not
+   deallocated before the matching call to the latter. Both can be called
+   from several threads at the same time. The cache is split into
+   CACHESHARDS independently locked shards, and a deformation is computed
+   outside of the lock of its shard. */
+
+const unsigned char *infimnist_acquire_pattern(infimnist_t*, long index);
+
+void infimnist_release_pattern(infimnist_t*, long index);
+
 /* Function <infimnist_cache_clear> deallocates all the cached patterns
-   potentially freeing up to 1GB of memory. */
+   that are not acquired, potentially freeing up to 1GB of memory. */
 
 void infimnist_cache_clear(infimnist_t*);
 
+/* Function <infimnist_cache_config> sets the memory cap of the cache in
+   bytes (1GB by default) and its eviction policy: INFIMNIST_CACHE_LRU
+   evicts the least recently used pattern, INFIMNIST_CACHE_FIFO the oldest
+   one (a hit does not reorder the shard). Acquired patterns are never
+   evicted, so the cap can be exceeded while they are held. The cache is
+   cleared; no pattern may be acquired and no other thread may use the
+   cache during the call. */
+
+#define INFIMNIST_CACHE_LRU  0
+#define INFIMNIST_CACHE_FIFO 1
+
+void infimnist_cache_config(infimnist_t*, long maxbytes, int policy);
+
+/* Function <infimnist_cache_stats> returns the number of hits, misses and
+   evictions since the last configuration and the memory held by the cache.
+   Any of the pointers can be NULL. */
+
+void infimnist_cache_stats(infimnist_t*, long *hits, long *misses, long *evictions, long *bytes);
+
+/* Function <infimnist_load_deformations> loads the deformation fields and
+   the tangent vectors (about 380MB) needed by the examples numbered 70000
+   and above, unless they are already loaded. */
+
+void infimnist_load_deformations(infimnist_t*);
+
+/* Function <infimnist_transform> writes the image of example <index> into
+   the 784 bytes at <s> without going through the pattern cache. It only
+   reads the data structure, so that several threads can call it at the
+   same time. */
+
+void infimnist_transform(infimnist_t*, long index, unsigned char *s);
+
+/* Function <infimnist_transform_batch> writes the images of the <n>
+   examples listed in <index> into consecutive blocks of 784 bytes at <s>.
+   The deformation uses AVX-512 or AVX2 + FMA when the compiler targets
+   them, with the same bytes as the scalar code. */
+
+void infimnist_transform_batch(infimnist_t*, const long *index, int n, unsigned char *s);
+
 unsigned char *
 translation(unsigned char *c, int t);
 
@@ -87,7 +140,8 @@ compute_transformed_vector(infimnist_t *p, long i);
 #define TRAINNUM 	(60000)
 #define FIELDNUM	(1522)
 #define NTAN            (2)
-#define CACHEROWS       (131071)
-#define CACHECOLS       (10)
+#define CACHESHARDS     (64)
+#define CACHERECENT     (10)
+#define CACHEBYTES      (1L << 30)
 
 #endif
@@ -41,6 +41,10 @@ int main(int argc, char *argv[])
 	
 	readMNISTDB(MNISTTrainData,MNISTDevData,MNISTTestData,RELU);
 
+	/* Train on fresh deformations of the training examples (infinite MNIST) */
+	if(argc > 2 && std::string(argv[2]) == "infinite")
+		MNISTTrainData.StartStreaming(TESTNUM + TRAINNUM, 4, 4096);
+
 	MNISTTrainDataStream.LinkDataSet(&MNISTTrainData);
 	MNISTDevDataStream.LinkDataSet(&MNISTDevData);
 	MNISTTestDataStream.LinkDataSet(&MNISTTestData);
@@ -36,6 +36,13 @@ Connection::Connection(Layer *const from, Layer *const to, const unsigned long d
 	dstLayer = to;
 	this->delayAmount = delayAmount;
 	this->_identity = isIdentity;
+	this->foldedBias = false;
+	this->fused = false;
+	this->fusedConvConn = this->fusedBiasConn = NULL;
+	this->poolArgmax = false;
+	this->gradAccValid = false;
+	this->compactState = false;
+	this->stateSeed = 0;
         this->spec = connSpec;
 	this->quant_done = 0;
 	this-> quant_cnt = 0;        
@@ -151,12 +158,19 @@ void Connection::SetEngine(Engine *const engine, PStream *const stream)
 
 	vels.SetEngine(engine);
 	derivs.SetEngine(engine);
+	gradAcc.SetEngine(engine);
 	msDeriv.SetEngine(engine);
 	msDelta.SetEngine(engine);
+	velsCompact.SetEngine(engine);
+	msDerivCompact.SetEngine(engine);
+	msDeltaCompact.SetEngine(engine);
+	msDerivScale.SetEngine(engine);
+	msDeltaScale.SetEngine(engine);
 	dstAct.SetEngine(engine);
 	srcAct.SetEngine(engine);
 	dstErr.SetEngine(engine);
 	srcErr.SetEngine(engine);
+	argmax.SetEngine(engine);
 
 	weightsTransValid = false;
 
@@ -187,6 +201,9 @@ void Connection::SetBatchSize(const unsigned long batchSize)
             dstAct.Resize(dstLayer->GetSize(), batchSize);
             srcErr.Resize(srcLayer->GetSize(), batchSize);
             dstErr.Resize(dstLayer->GetSize(), batchSize);
+
+	if(poolArgmax == true)
+		argmax.Resize(dstLayer->GetSize(), batchSize);
 }
 
 void Connection::UnlinkMatrices()
@@ -204,12 +221,19 @@ void Connection::UnlinkMatrices()
 
 	vels.Unlink();
 	derivs.Unlink();
+	gradAcc.Unlink();
 	msDeriv.Unlink();
 	msDelta.Unlink();
+	velsCompact.Unlink();
+	msDerivCompact.Unlink();
+	msDeltaCompact.Unlink();
+	msDerivScale.Unlink();
+	msDeltaScale.Unlink();
 	dstAct.Unlink();
 	srcAct.Unlink();
 	dstErr.Unlink();
 	srcErr.Unlink();
+	argmax.Unlink();
 
 	weightsTransValid = false;
 }
@@ -237,6 +261,10 @@ void Connection::InitAdadelta(const FLOAT decayRate)
 {
 	verify(engine != NULL);
 
+	const bool compact = compactState;
+
+	SetCompactState(false);
+
 	if(IsIdentity() == false)
 	{
             if(this->spec.connType == CONN_FULL)
@@ -292,6 +320,8 @@ void Connection::InitAdadelta(const FLOAT decayRate)
 		engine->MatSet(msDeriv, (FLOAT) 1, *stream);
 		engine->MatSet(msDelta, (FLOAT) 0, *stream);
 	}
+
+	SetCompactState(compact);
 }
 
 
@@ -299,10 +329,16 @@ void Connection::InitNesterov()
 {
 	verify(engine != NULL);
 
+	const bool compact = compactState;
+
+	SetCompactState(false);
+
 	if(IsIdentity() == false)
 	{
 		engine->MatSet(vels, (FLOAT) 0, *stream);
 	}
+
+	SetCompactState(compact);
 }
 
 
@@ -310,6 +346,10 @@ void Connection::InitRmsprop(const FLOAT decayRate)
 {
 	verify(engine != NULL);
 
+	const bool compact = compactState;
+
+	SetCompactState(false);
+
 	if(IsIdentity() == false)
 	{
             if(this->spec.connType == CONN_FULL)
@@ -360,6 +400,92 @@ void Connection::InitRmsprop(const FLOAT decayRate)
 
             engine->MatSet(msDeriv, (FLOAT) 1, *stream);
         }
+
+	SetCompactState(compact);
+}
+
+
+void Connection::SetFoldedBias(const bool enable)
+{
+	if(enable == true)
+	{
+		verify(IsIdentity() == false && IsDelayed() == false);
+		verify(spec.connType == CONN_FULL);
+		verify(srcLayer->GetSize() == 1);
+	}
+
+	foldedBias = enable;
+}
+
+
+void Connection::SetFused(const bool enable)
+{
+	if(enable == true)
+	{
+		verify(IsIdentity() == false && IsDelayed() == false);
+		verify(spec.connType == CONN_CONV || spec.connType == CONN_CONVBIAS);
+	}
+
+	fused = enable;
+}
+
+
+void Connection::SetPoolArgmax(const bool enable)
+{
+	if(enable == true)
+	{
+		verify(IsIdentity() == false);
+		verify(spec.connType == CONN_POOL);
+		verify(POOL_WINDOW * POOL_WINDOW <= 256);
+	}
+
+	poolArgmax = enable;
+
+	if(enable == true)
+		argmax.Resize(dstLayer->GetSize(), batchSize);
+	else
+		argmax.Resize(0, 0);
+}
+
+
+void Connection::SetFusedBlock(Connection *const convConn, Connection *const biasConn)
+{
+	if(convConn != NULL)
+	{
+		verify(IsIdentity() == false && IsDelayed() == false);
+		verify(spec.connType == CONN_POOL);
+		verify(convConn->GetDstLayer() == srcLayer && convConn->spec.connType == CONN_CONV);
+		verify(biasConn == NULL || (biasConn->GetDstLayer() == srcLayer && biasConn->spec.connType == CONN_CONVBIAS));
+	}
+
+	fusedConvConn = convConn;
+	fusedBiasConn = convConn == NULL ? NULL : biasConn;
+}
+
+
+void Connection::ForwardFusedBlock(const unsigned long batchFrom, const unsigned long batchTo)
+{
+	Layer *inLayer = fusedConvConn->GetSrcLayer();
+	Layer *convLayer = srcLayer;
+	Matrix<FLOAT> *convWeights = &fusedConvConn->weights;
+
+#if QUANT_DIRECT
+	if(fusedConvConn->M != 100 && fusedConvConn->quant_done != 0)
+		convWeights = &fusedConvConn->weights_fixed;
+#endif
+
+	Matrix<FLOAT> inActSub(inLayer->act, batchFrom, batchTo);
+	Matrix<FLOAT> dstActSub(dstAct, batchFrom, batchTo);
+
+	/* Same quantization step as Layer::Activation() */
+	engine->ConvActPoolForward(inActSub, *convWeights, fusedBiasConn == NULL ? NULL : &fusedBiasConn->weights, dstActSub,
+			fusedConvConn->spec.kernelDimX, fusedConvConn->spec.kernelDimY,
+			inLayer->spec.dimX, inLayer->spec.dimY, inLayer->spec.numMaps,
+			convLayer->spec.dimX, convLayer->spec.dimY, convLayer->spec.numMaps,
+			dstLayer->spec.dimX, dstLayer->spec.dimY,
+			POOL_WINDOW, POOL_STRIDE, batchTo - batchFrom + 1, *stream,
+			convLayer->relu_delta_final_decision == 1 ? convLayer->relu_delta : (FLOAT) 100.0,
+			convLayer->M_relu, convLayer->relu_delta_final_decision);
 }
 
 
@@ -393,6 +519,18 @@ void Connection::Forward(const unsigned long batchFrom, const unsigned long batc
 
 	//srcLayer->StreamWaitEvent(*stream);
 
+	/* Folded biases are applied by the destination layer in Layer::UpdateState() */
+	if(IsFoldedBias() == true) return;
+
+	/* Fused convolutions are computed by the downstream pooling connection */
+	if(IsFused() == true) return;
+
+	if(IsFusedBlock() == true)
+	{
+		ForwardFusedBlock(batchFrom, batchTo);
+		return;
+	}
+
 	if(IsDelayed() == true)
 	{
 		delay = IsDelayed() == true ? nStream * delayAmount : 0;
@@ -457,6 +595,15 @@ void Connection::Forward(const unsigned long batchFrom, const unsigned long batc
                     /* IBM check start */
                     /* Forward propagation for pooling layer using CUDNN v2*/    
                     case CONN_POOL:
+                        if(poolArgmax == true)
+                        {
+                            Matrix<unsigned char> argmaxSub(argmax, batchFrom, batchTo);
+
+                            engine->MaxPoolArgmaxForward(srcActSub, dstActSub, argmaxSub,
+                                    srcLayer->spec.dimX, srcLayer->spec.dimY, dstLayer->spec.dimX, dstLayer->spec.dimY,
+                                    dstLayer->spec.numMaps, POOL_WINDOW, POOL_STRIDE, batchTo - batchFrom + 1, *stream);
+                            break;
+                        }
                         engine->MaxPoolForward(srcActSub,dstActSub,
                                 srcLayer->spec.dimX,srcLayer->spec.dimY,srcLayer->spec.numMaps,
                                 dstLayer->spec.dimX,dstLayer->spec.dimY,dstLayer->spec.numMaps,
@@ -607,6 +754,15 @@ void Connection::Backward(const unsigned long batchFrom, const unsigned long bat
                 /* IBM check start */
                 /* Backward propagation for pooling layer using cudnn v2 */ 
                 case CONN_POOL:
+                    if(poolArgmax == true)
+                    {
+                        Matrix<unsigned char> argmaxSub(argmax, batchFrom, batchTo);
+
+                        engine->MaxPoolArgmaxBackward(dstErrSub, argmaxSub, srcErrSub,
+                                srcLayer->spec.dimX, srcLayer->spec.dimY, dstLayer->spec.dimX, dstLayer->spec.dimY,
+                                dstLayer->spec.numMaps, POOL_WINDOW, POOL_STRIDE, srcErrTo - srcErrFrom + 1, *stream);
+                        break;
+                    }
                     engine->MaxPoolBackward(srcActSub,dstActSub,
                             srcErrSub,dstErrSub,
                             srcLayer->spec.dimX,srcLayer->spec.dimY,srcLayer->spec.numMaps,
@@ -704,6 +860,7 @@ void Connection::UpdateWeights(const unsigned long batchFrom, const unsigned lon
 #endif
         verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
         verify(engine != NULL);
+        verify(compactState == false);
 
         if(IsIdentity() == true) return;
 
@@ -727,7 +884,7 @@ void Connection::UpdateWeights(const unsigned long batchFrom, const unsigned lon
             verify(rmsprop == false);
             if(this->spec.connType == CONN_FULL)
             {
-                engine->MatMult(dstErrSub, false, srcActSub, true, derivs, (FLOAT) 1, (FLOAT) 0, *stream);
+                FullGradient(dstErrSub, srcActSub, derivs, (FLOAT) 1, (FLOAT) 0);
             }
             
             /* IBM check start */
@@ -799,16 +956,16 @@ void Connection::UpdateWeights(const unsigned long batchFrom, const unsigned lon
 #if QUANT_RETRAIN 
                 if(NUM_WEIGHTS==dstLayer->size)
                 {
-                    engine->MatMult(dstErrSub, false, srcActSub, true, derivs, (FLOAT) 1, (FLOAT) 0, *stream);
+                    FullGradient(dstErrSub, srcActSub, derivs, (FLOAT) 1, (FLOAT) 0);
                     //derivs = dstErrSub * srcActSub;
                 }
                 else
                 {
-                    engine->MatMult(dstErrSub, false, srcActSub, true, derivs, (FLOAT) 1, (FLOAT) 0, *stream);
+                    FullGradient(dstErrSub, srcActSub, derivs, (FLOAT) 1, (FLOAT) 0);
 
                 }
 #else
-                engine->MatMult(dstErrSub, false, srcActSub, true, derivs, (FLOAT) 1, (FLOAT) 0, *stream);
+                FullGradient(dstErrSub, srcActSub, derivs, (FLOAT) 1, (FLOAT) 0);
 
 #endif
             }
@@ -880,7 +1037,7 @@ void Connection::UpdateWeights(const unsigned long batchFrom, const unsigned lon
             //engine->MatMult(dstErrSub, false, srcActSub, true, vels, rate / (FLOAT) nFrame, momentum, *stream);
             if(this->spec.connType == CONN_FULL)
             {
-                engine->MatMult(dstErrSub, false, srcActSub, true, vels, rate/128.f, momentum, *stream);
+                FullGradient(dstErrSub, srcActSub, vels, rate/128.f, momentum);
                 // A : dstErrSub, B : srcActSub, C : vels,                                   // alpha : rate beta : momentum	
             }
             /* IBM check start */
@@ -961,6 +1118,262 @@ void Connection::UpdateWeights(const unsigned long batchFrom, const unsigned lon
         weightsTransValid = false;
     }
 }
+
+void Connection::AccumulateGradient(const unsigned long batchFrom, const unsigned long batchTo)
+{
+    if(this->no_weight == true || IsIdentity() == true) return;
+
+    verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+    verify(engine != NULL);
+
+    /* Only full connections are supported (convolutions are not recurrent) */
+    verify(this->spec.connType == CONN_FULL);
+
+    Matrix<FLOAT> srcActSub(srcAct, batchFrom, batchTo);
+    Matrix<FLOAT> dstErrSub(dstErr, batchFrom, batchTo);
+
+    if(gradAccValid == false)
+    {
+        gradAcc.Resize(weights.GetNumRows(), weights.GetNumCols());
+    }
+
+    /* gradAcc (+)= dstErr * srcAct^T */
+    if(IsFoldedBias() == true)
+        engine->MatRowSum(dstErrSub, gradAcc, (FLOAT) 1, gradAccValid == true ? (FLOAT) 1 : (FLOAT) 0, *stream);
+    else
+        engine->MatMult(dstErrSub, false, srcActSub, true, gradAcc, (FLOAT) 1, gradAccValid == true ? (FLOAT) 1 : (FLOAT) 0, *stream);
+
+    gradAccValid = true;
+}
+
+
+void Connection::ComputeGradient(const unsigned long batchFrom, const unsigned long batchTo)
+{
+    if(this->no_weight == true || IsIdentity() == true) return;
+
+    verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+    verify(engine != NULL);
+
+    Matrix<FLOAT> srcActSub(srcAct, batchFrom, batchTo);
+    Matrix<FLOAT> dstErrSub(dstErr, batchFrom, batchTo);
+    Matrix<FLOAT> srcErrSub_dummy(srcErr, batchFrom, batchTo);
+
+    /* derivs is only allocated by InitRmsprop() and InitAdadelta() */
+    if(derivs.GetNumRows() != weights.GetNumRows() || derivs.GetNumCols() != weights.GetNumCols())
+        derivs.Resize(weights.GetNumRows(), weights.GetNumCols());
+
+    if(this->spec.connType == CONN_FULL)
+    {
+        FullGradient(dstErrSub, srcActSub, derivs, (FLOAT) 1, (FLOAT) 0);
+    }
+    else if(this->spec.connType == CONN_CONV)
+    {
+#if QUANT_RETRAIN
+        Matrix<FLOAT> &convWeights = (M == 100) ? weights : weights_fixed;
+#else
+        Matrix<FLOAT> &convWeights = weights;
+#endif
+        engine->ConvBackward(srcActSub, srcErrSub_dummy,
+                dstErrSub,
+                convWeights, derivs,
+                spec.kernelDimX, spec.kernelDimY,
+                srcLayer->spec.dimX, srcLayer->spec.dimY, srcLayer->spec.numMaps,
+                dstLayer->spec.dimX, dstLayer->spec.dimY, dstLayer->spec.numMaps,
+                false, batchTo - batchFrom + 1, *stream);
+    }
+    else if(this->spec.connType == CONN_CONVBIAS)
+    {
+        engine->ConvBiasBackward(dstErrSub, derivs, dstLayer->spec.dimX, dstLayer->spec.dimY, dstLayer->spec.numMaps, batchTo - batchFrom + 1, *stream);
+    }
+}
+
+
+const bool Connection::GetOptTensor(OptTensor &tensor, const FLOAT rate, const FLOAT momentum, const bool adadelta, const bool rmsprop)
+{
+    if(this->no_weight == true || IsIdentity() == true) return false;
+
+    tensor = OptTensor();
+    tensor.weights = &weights;
+    tensor.vels = &vels;
+    tensor.derivs = &derivs;
+
+    if(compactState == true)
+    {
+        tensor.velsBf16 = &velsCompact;
+        tensor.msDerivCode = &msDerivCompact;
+        tensor.msDerivScale = &msDerivScale;
+        tensor.msDeltaCode = &msDeltaCompact;
+        tensor.msDeltaScale = &msDeltaScale;
+        tensor.param.seed = stateSeed++;
+    }
+    tensor.param.momentum = momentum;
+    tensor.param.decayRate = rmsDecayRate;
+    tensor.param.velDecay = momentum;
+
+    if(adadelta == true)
+    {
+        verify(rmsprop == false);
+
+        tensor.msDeriv = &msDeriv;
+        tensor.msDelta = &msDelta;
+        tensor.param.rule = hostOpt::UPDATE_ADADELTA;
+        tensor.param.rate = rate;
+        tensor.param.velScale = (FLOAT) 1;
+    }
+    else if(rmsprop == true)
+    {
+        tensor.msDeriv = &msDeriv;
+        tensor.param.rule = hostOpt::UPDATE_RMSPROP;
+        tensor.param.velScale = rate;
+    }
+    else if(this->spec.connType == CONN_FULL)
+    {
+        /* vels = momentum * vels + rate / 128 * derivs */
+        tensor.param.rule = hostOpt::UPDATE_NESTEROV;
+        tensor.param.velScale = rate / (FLOAT) 128;
+    }
+    else
+    {
+        /* vels += rate * derivs; vels += momentum * vels (UpdateWeights() of the convolutions) */
+        tensor.param.rule = hostOpt::UPDATE_NESTEROV;
+        tensor.param.velDecay = (FLOAT) 1 + momentum;
+        tensor.param.velScale = rate * ((FLOAT) 1 + momentum);
+    }
+
+#if QUANT_RETRAIN
+    /* Same conditions as WeightQuant2_gpu() */
+    const unsigned long nWeights = weights.GetNumRows() * weights.GetNumCols();
+
+    if(nWeights != dstLayer->GetSize() && nWeights != 0 && M != 100)
+    {
+        tensor.weightsFixed = &weights_fixed;
+        tensor.param.quantDelta = delta;
+        tensor.param.quantM = M;
+    }
+#endif
+
+    return true;
+}
+
+
+void Connection::FinishUpdate()
+{
+    weightsTransValid = false;
+}
+
+
+void Connection::SetCompactState(const bool enable)
+{
+    if(compactState == enable) return;
+
+    compactState = enable;
+
+    if(this->no_weight == true || IsIdentity() == true) return;
+
+    verify(engine != NULL);
+
+    if(enable == true)
+    {
+        velsCompact.Resize(vels.GetNumRows(), vels.GetNumCols());
+        msDerivCompact.Resize(msDeriv.GetNumRows(), msDeriv.GetNumCols());
+        msDeltaCompact.Resize(msDelta.GetNumRows(), msDelta.GetNumCols());
+        msDerivScale.Resize((msDeriv.GetNumRows() * msDeriv.GetNumCols() + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK, 1);
+        msDeltaScale.Resize((msDelta.GetNumRows() * msDelta.GetNumCols() + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK, 1);
+
+        engine->Bf16Encode(vels, velsCompact, *stream);
+        engine->StateQuantEncode(msDeriv, msDerivCompact, msDerivScale, *stream);
+        engine->StateQuantEncode(msDelta, msDeltaCompact, msDeltaScale, *stream);
+        engine->StreamSynchronize(*stream);
+
+        vels.Resize(0, 1);
+        msDeriv.Resize(0, 1);
+        msDelta.Resize(0, 1);
+    }
+    else
+    {
+        vels.Resize(velsCompact.GetNumRows(), velsCompact.GetNumCols());
+        msDeriv.Resize(msDerivCompact.GetNumRows(), msDerivCompact.GetNumCols());
+        msDelta.Resize(msDeltaCompact.GetNumRows(), msDeltaCompact.GetNumCols());
+
+        engine->Bf16Decode(velsCompact, vels, *stream);
+        engine->StateQuantDecode(msDerivCompact, msDerivScale, msDeriv, *stream);
+        engine->StateQuantDecode(msDeltaCompact, msDeltaScale, msDelta, *stream);
+        engine->StreamSynchronize(*stream);
+
+        velsCompact.Resize(0, 1);
+        msDerivCompact.Resize(0, 1);
+        msDeltaCompact.Resize(0, 1);
+        msDerivScale.Resize(0, 1);
+        msDeltaScale.Resize(0, 1);
+    }
+}
+
+
+Matrix<FLOAT> *const Connection::GetParamMatrix(const ParamKind kind)
+{
+    Matrix<FLOAT> *mat = NULL;
+
+    if(this->no_weight == true || IsIdentity() == true) return NULL;
+
+    switch(kind)
+    {
+        case PARAM_WEIGHTS:
+            mat = &weights;
+            break;
+        case PARAM_WEIGHTS_FIXED:
+            mat = &weights_fixed;
+            break;
+        case PARAM_VELS:
+            mat = &vels;
+            break;
+        case PARAM_DERIVS:
+            if(derivs.GetNumRows() != weights.GetNumRows() || derivs.GetNumCols() != weights.GetNumCols())
+                derivs.Resize(weights.GetNumRows(), weights.GetNumCols());
+            mat = &derivs;
+            break;
+        case PARAM_MSDERIV:
+            mat = &msDeriv;
+            break;
+        case PARAM_MSDELTA:
+            mat = &msDelta;
+            break;
+        default:
+            verify(false);
+    }
+
+    if(mat->GetNumRows() * mat->GetNumCols() == 0) return NULL;
+
+    return mat;
+}
+
+
+void Connection::FullGradient(Matrix<FLOAT> &dstErrSub, Matrix<FLOAT> &srcActSub, Matrix<FLOAT> &dst, const FLOAT alpha, const FLOAT beta)
+{
+    /* dst = alpha * dstErr * srcAct^T + beta * dst */
+    if(gradAccValid == true)
+    {
+        /* Use the gradient accumulated by AccumulateGradient() instead of the given range */
+        if(beta == (FLOAT) 0)
+            engine->MatSet(dst, (FLOAT) 0, *stream);
+        else
+            engine->MatAdd(dst, dst, beta - (FLOAT) 1, *stream);
+
+        engine->MatAdd(gradAcc, dst, alpha, *stream);
+
+        gradAccValid = false;
+    }
+    else if(IsFoldedBias() == true)
+    {
+        /* Gradient of a broadcast bias: sum of the errors over the batch */
+        engine->MatRowSum(dstErrSub, dst, alpha, beta, *stream);
+    }
+    else
+    {
+        engine->MatMult(dstErrSub, false, srcActSub, true, dst, alpha, beta, *stream);
+    }
+}
+
+
 void Connection::SetPStream(PStream *const stream)
         {
             verify(stream->engine == engine);
@@ -1022,6 +1435,11 @@ void Connection::SetPStream(PStream *const stream)
 
         void Connection::SaveState(const std::string &filename)
         {
+            /* The files hold the full-precision state */
+            const bool compact = compactState;
+
+            SetCompactState(false);
+
             /* Save weights, vels, msDeriv */
             
             weights.Save(filename + ".weights");
@@ -1036,6 +1454,8 @@ void Connection::SetPStream(PStream *const stream)
             msDeriv.Save(filename + ".msDeriv");
             msDelta.Save(filename + ".msDelta");
 
+            SetCompactState(compact);
+
 
             /* Save rmsDecayRate */
 
@@ -1056,6 +1476,10 @@ void Connection::SetPStream(PStream *const stream)
 
         void Connection::LoadState(const std::string &filename)
         {
+            const bool compact = compactState;
+
+            SetCompactState(false);
+
             /* Load weights, vels, msDeriv */
 
             weights.Load(filename + ".weights");
@@ -1072,6 +1496,8 @@ void Connection::SetPStream(PStream *const stream)
             msDelta.Load(filename + ".msDelta");
             weightsTransValid = false;
 
+            SetCompactState(compact);
+
             /* Load rmsDecayRate */
 
             std::string paramFileName = filename + ".param";
@@ -30,6 +30,10 @@ namespace fractal
 {
 
 enum ConnType {CONN_FULL, CONN_POOL,CONN_POOL_AVG, CONN_CONV, CONN_CONVBIAS};
+
+/* Parameter matrices of a connection (see Rnn::SetParamArena) */
+enum ParamKind {PARAM_WEIGHTS, PARAM_WEIGHTS_FIXED, PARAM_VELS, PARAM_DERIVS, PARAM_MSDERIV, PARAM_MSDELTA, N_PARAM_KIND};
+
 class ConnSpec
 {
     public:
@@ -71,8 +75,41 @@ public:
 	void UpdateWeights(const unsigned long batchFrom, const unsigned long batchTo, const unsigned long nFrame,
 			const FLOAT rate, const FLOAT momentum, const bool adaptiveRates, const bool rmsprop);
 
+	/* Sum the weight gradient over several ranges; the next UpdateWeights() consumes it */
+	void AccumulateGradient(const unsigned long batchFrom, const unsigned long batchTo);
+
+	/* Fused optimizer step (see Rnn::SetFusedOptimizer): ComputeGradient() writes the gradient to derivs,
+	 * GetOptTensor() describes the update of UpdateWeights() for Engine::FusedUpdate() (false if there
+	 * are no weights) and FinishUpdate() is called after the update */
+	void ComputeGradient(const unsigned long batchFrom, const unsigned long batchTo);
+	const bool GetOptTensor(OptTensor &tensor, const FLOAT rate, const FLOAT momentum, const bool adaptiveRates, const bool rmsprop);
+	void FinishUpdate();
+
+	/* NULL if the connection has no weights or the matrix is not allocated; derivs is allocated with the
+	 * shape of the weights if it is empty */
+	Matrix<FLOAT> *const GetParamMatrix(const ParamKind kind);
+
+	/* Keep vels in bfloat16 and msDeriv, msDelta in 8 bits per element between the updates (see
+	 * Rnn::SetCompactOptimizerState); only the fused optimizer updates the compact state */
+	void SetCompactState(const bool enable);
+	inline const bool IsCompactState() const { return compactState; }
+
 	inline const bool IsDelayed() const { return delayAmount > 0; }
+	inline const unsigned long GetDelayAmount() const { return delayAmount; }
 	inline const bool IsIdentity() const { return _identity; }
+	inline const bool IsFoldedBias() const { return foldedBias; }
+	void SetFoldedBias(const bool enable);
+
+	/* Inference: a CONN_POOL connection computes conv + bias + rectlinear + pool of its source layer in one pass */
+	inline const bool IsFused() const { return fused; }
+	inline const bool IsFusedBlock() const { return fusedConvConn != NULL; }
+	void SetFused(const bool enable);
+	void SetFusedBlock(Connection *const convConn, Connection *const biasConn);
+
+	/* CONN_POOL: record the argmax of each window in the forward pass and scatter through it in the backward pass */
+	inline const bool IsPoolArgmax() const { return poolArgmax; }
+	void SetPoolArgmax(const bool enable);
+
 	inline Layer *const GetSrcLayer() const { return srcLayer; }
 	inline Layer *const GetDstLayer() const { return dstLayer; }
 
@@ -113,8 +150,14 @@ public:
 	Layer *srcLayer, *dstLayer;
 protected:
 	void TransposeWeightMatrix();
+	void FullGradient(Matrix<FLOAT> &dstErrSub, Matrix<FLOAT> &srcActSub, Matrix<FLOAT> &dst, const FLOAT alpha, const FLOAT beta);
+	void ForwardFusedBlock(const unsigned long batchFrom, const unsigned long batchTo);
 	Engine *engine;
 	bool _identity;
+	bool foldedBias; /* weights are added to the destination state as a broadcast bias vector */
+	bool fused; /* computed by the fused block of a downstream pooling connection */
+	Connection *fusedConvConn, *fusedBiasConn; /* sources of the fused block (pooling connection only) */
+	bool poolArgmax;
 	unsigned long delayAmount;
 
 	unsigned long batchSize;
@@ -127,9 +170,17 @@ protected:
 
 	Matrix<FLOAT> vels; /* momentum */
 	Matrix<FLOAT> derivs, msDeriv; /* Rmsprop, Adadelta */
+	Matrix<FLOAT> gradAcc; /* Accumulated gradient (gradient checkpointing) */
+	bool gradAccValid;
 	Matrix<FLOAT> msDelta; /* Adadelta */
+	bool compactState;
+	unsigned long stateSeed; /* hostOpt::UpdateParam::seed of the next update */
+	Matrix<unsigned short> velsCompact; /* bfloat16 */
+	Matrix<unsigned char> msDerivCompact, msDeltaCompact;
+	Matrix<FLOAT> msDerivScale, msDeltaScale; /* one per hostOpt::STATE_BLOCK elements */
 	Matrix<FLOAT> dstAct, srcAct;
 	Matrix<FLOAT> dstErr, srcErr;
+	Matrix<unsigned char> argmax; /* offset of the maximum within each pooling window */
 
 	//for fixed point optimization mode
 	Matrix<FLOAT> dstAct_fixed, srcAct_fixed;
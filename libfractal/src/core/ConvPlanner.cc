@@ -0,0 +1,258 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "ConvPlanner.h"
+
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+
+
+/* Repetitions of each candidate; the fastest one is taken */
+#define BENCHMARK_REPEAT 3
+
+
+namespace fractal
+{
+
+namespace hostConv
+{
+
+ConvPlanner::ConvPlanner()
+{
+	cpuModel = GetCpuModel();
+}
+
+
+ConvPlanner::~ConvPlanner()
+{
+}
+
+
+void ConvPlanner::SetCacheFile(const std::string &filename)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+
+	this->filename = filename;
+
+	if(filename.empty() == false) Load();
+}
+
+
+template<class T>
+const ConvPlan &ConvPlanner::GetPlan(const ConvShape &shape)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+
+	const std::string key = GetKey(shape, sizeof(T));
+	auto it = plans.find(key);
+
+	if(it != plans.end()) return it->second;
+
+	ConvPlan &plan = plans[key];
+
+	Benchmark<T>(shape, plan);
+
+	if(filename.empty() == false) Save(key, plan);
+
+	return plan;
+}
+
+
+void ConvPlanner::Clear()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+
+	plans.clear();
+}
+
+
+template<class T>
+void ConvPlanner::Benchmark(const ConvShape &shape, ConvPlan &plan)
+{
+	verify(shape.IsValid() == true);
+
+	std::vector<ConvAlgo> candidates;
+
+	if(shape.kernelDimX <= DIRECT_MAX_KERNEL) candidates.push_back(CONV_ALGO_DIRECT);
+	candidates.push_back(CONV_ALGO_IM2COL);
+	if(IsWinogradSupported(shape) == true) candidates.push_back(CONV_ALGO_WINOGRAD);
+	candidates.push_back(CONV_ALGO_FFT);
+
+	std::vector<T> x(shape.batchSize * shape.GetInSize());
+	std::vector<T> w(shape.outMaps * shape.GetKernelSize());
+	std::vector<T> y(shape.batchSize * shape.GetOutSize());
+	std::vector<T> workspace;
+	unsigned int seed = 1;
+
+	for(auto it = x.begin(); it != x.end(); ++it)
+		*it = (T) 2 * (T) rand_r(&seed) / (T) RAND_MAX - (T) 1;
+	for(auto it = w.begin(); it != w.end(); ++it)
+		*it = (T) 2 * (T) rand_r(&seed) / (T) RAND_MAX - (T) 1;
+
+	plan.algo = CONV_ALGO_AUTO;
+
+	for(auto it = candidates.begin(); it != candidates.end(); ++it)
+	{
+		double best = 0.0;
+		long i;
+
+		workspace.resize(GetWorkspaceSize(shape, *it));
+
+		/* The first call warms up the caches and the thread pool */
+		ConvForward(x.data(), w.data(), y.data(), shape, *it, workspace.data());
+
+		for(i = 0; i < BENCHMARK_REPEAT; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			ConvForward(x.data(), w.data(), y.data(), shape, *it, workspace.data());
+			auto end = std::chrono::steady_clock::now();
+
+			double t = std::chrono::duration<double>(end - start).count();
+			if(i == 0 || t < best) best = t;
+		}
+
+		if(plan.algo == CONV_ALGO_AUTO || best < plan.time)
+		{
+			plan.algo = *it;
+			plan.time = best;
+			plan.workspaceSize = workspace.size() * sizeof(T);
+		}
+	}
+}
+
+
+const std::string ConvPlanner::GetKey(const ConvShape &shape, const size_t elemSize)
+{
+	std::ostringstream key;
+
+	key << elemSize << ' ' << shape.batchSize << ' '
+		<< shape.inMaps << ' ' << shape.inDimY << ' ' << shape.inDimX << ' '
+		<< shape.outMaps << ' ' << shape.outDimY << ' ' << shape.outDimX << ' '
+		<< shape.kernelDimY << ' ' << shape.kernelDimX;
+
+	return key.str();
+}
+
+
+/* File format: one plan per line, fields separated by tabs
+ * <CPU model> <key> <algorithm> <workspace size> <time> */
+void ConvPlanner::Load()
+{
+	std::ifstream fileStream(filename);
+	std::string line;
+
+	if(fileStream.is_open() == false) return;
+
+	while(std::getline(fileStream, line))
+	{
+		std::vector<std::string> fields;
+		std::istringstream lineStream(line);
+		std::string field;
+
+		while(std::getline(lineStream, field, '\t')) fields.push_back(field);
+
+		if(fields.size() != 5 || fields[0] != cpuModel) continue;
+
+		ConvAlgo algo = GetAlgoByName(fields[2]);
+		if(algo == CONV_ALGO_AUTO) continue;
+
+		/* Later entries override the earlier ones */
+		ConvPlan &plan = plans[fields[1]];
+
+		plan.algo = algo;
+		plan.workspaceSize = std::strtoul(fields[3].c_str(), NULL, 10);
+		plan.time = std::strtod(fields[4].c_str(), NULL);
+	}
+}
+
+
+void ConvPlanner::Save(const std::string &key, const ConvPlan &plan)
+{
+	std::ofstream fileStream(filename, std::ofstream::out | std::ofstream::app);
+
+	/* The plan is still valid for this run even if the file cannot be written */
+	if(fileStream.is_open() == false) return;
+
+	fileStream << cpuModel << '\t' << key << '\t' << GetAlgoName(plan.algo) << '\t'
+		<< plan.workspaceSize << '\t' << plan.time << std::endl;
+}
+
+
+const std::string ConvPlanner::GetCpuModel()
+{
+	std::ifstream fileStream("/proc/cpuinfo");
+	std::string line;
+
+	while(std::getline(fileStream, line))
+	{
+		/* x86 reports "model name"; some ARM kernels report only "Hardware" or "CPU part" */
+		if(line.compare(0, 10, "model name") == 0 || line.compare(0, 8, "Hardware") == 0
+				|| line.compare(0, 8, "CPU part") == 0)
+		{
+			size_t pos = line.find(':');
+
+			if(pos == std::string::npos) continue;
+
+			pos = line.find_first_not_of(" \t", pos + 1);
+
+			return pos == std::string::npos ? std::string("unknown") : line.substr(pos);
+		}
+	}
+
+	return std::string("unknown");
+}
+
+
+const char *ConvPlanner::GetAlgoName(const ConvAlgo algo)
+{
+	switch(algo)
+	{
+		case CONV_ALGO_DIRECT:
+			return "direct";
+		case CONV_ALGO_IM2COL:
+			return "im2col";
+		case CONV_ALGO_WINOGRAD:
+			return "winograd";
+		case CONV_ALGO_FFT:
+			return "fft";
+		default:
+			return "auto";
+	}
+}
+
+
+const ConvAlgo ConvPlanner::GetAlgoByName(const std::string &name)
+{
+	if(name == "direct") return CONV_ALGO_DIRECT;
+	if(name == "im2col") return CONV_ALGO_IM2COL;
+	if(name == "winograd") return CONV_ALGO_WINOGRAD;
+	if(name == "fft") return CONV_ALGO_FFT;
+
+	return CONV_ALGO_AUTO;
+}
+
+
+template const ConvPlan &ConvPlanner::GetPlan<float>(const ConvShape &shape);
+template const ConvPlan &ConvPlanner::GetPlan<double>(const ConvShape &shape);
+
+}
+
+}
+
@@ -0,0 +1,90 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_CONVPLANNER_H_
+#define FRACTAL_CONVPLANNER_H_
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#include "HostConv.h"
+#include "FractalCommon.h"
+
+
+namespace fractal
+{
+
+namespace hostConv
+{
+
+class ConvPlan
+{
+public:
+	ConvPlan() : algo(CONV_ALGO_AUTO), workspaceSize(0), time(0.0) {}
+
+	ConvAlgo algo;
+	size_t workspaceSize;	/* Bytes */
+	double time;			/* Seconds per call, measured */
+};
+
+
+/* Chooses the fastest forward algorithm for each shape by benchmarking them the first
+ * time the shape is seen. The plans can be kept in a file so that later runs on the same
+ * CPU model skip the benchmark; entries of other CPU models in the file are ignored. */
+class ConvPlanner
+{
+public:
+	ConvPlanner();
+	virtual ~ConvPlanner();
+
+	/* Load the plans from the file (if it exists), and append new plans to it. Empty: memory only */
+	void SetCacheFile(const std::string &filename);
+	inline const std::string &GetCacheFile() const { return filename; }
+
+	template<class T>
+	const ConvPlan &GetPlan(const ConvShape &shape);
+
+	void Clear();
+
+	static const std::string GetCpuModel();
+	static const char *GetAlgoName(const ConvAlgo algo);
+	static const ConvAlgo GetAlgoByName(const std::string &name);
+
+protected:
+	ConvPlanner(const ConvPlanner &obj);
+
+	template<class T>
+	void Benchmark(const ConvShape &shape, ConvPlan &plan);
+
+	static const std::string GetKey(const ConvShape &shape, const size_t elemSize);
+
+	void Load();
+	void Save(const std::string &key, const ConvPlan &plan);
+
+	std::string filename;
+	std::string cpuModel;
+	std::unordered_map<std::string, ConvPlan> plans;
+	std::mutex mtx;
+};
+
+}
+
+}
+
+#endif /* FRACTAL_CONVPLANNER_H_ */
+
@@ -45,6 +45,12 @@ static __global__ void ElemMultKernel(const T *x, const T *y, T *z, const unsign
 template<class T>
 static __global__ void AddKernel(const T *x, const T *y, T *z, const unsigned long n);
 
+template<class T>
+static __global__ void AddBiasKernel(const T *x, const T *b, T *z, const unsigned long nRows, const unsigned long n);
+
+template<class T>
+static __global__ void RowSumKernel(const T *x, T *y, const T alpha, const T beta, const unsigned long nRows, const unsigned long nCols);
+
 template<class T>
 static __global__ void FuncSigmoidKernel(const T *x, T *y, const unsigned long n, FLOAT delta);
 
@@ -72,6 +78,29 @@ static __global__ void FuncRectLinearKernel(const T *x, T *y,T *y_fixed , const
 /* template signal quantization for rectlinear */
 /* IBM check end */
 
+template<class T>
+static __global__ void ConvActPoolKernel(const T *x, const T *w, const T *b, T *y,
+        const unsigned long inMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outMaps, const unsigned long kernelDimY, const unsigned long kernelDimX,
+        const unsigned long poolWindow, const unsigned long poolStride, const unsigned long poolDimY, const unsigned long poolDimX,
+        const unsigned long n, FLOAT delta, int M, int relu_delta_final_decision);
+
+template<class T>
+static __global__ void FuncStepLookupKernel(const T *x, T *y, const unsigned long n, const T *thresholds, const T *values, const int *cells,
+        const long nCode, const long nCell, const T lo, const T invStep);
+
+template<class T>
+static __global__ void MaxPoolArgmaxForwardKernel(const T *x, T *y, unsigned char *argmax,
+        const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const unsigned long n);
+
+template<class T>
+static __global__ void MaxPoolArgmaxBackwardKernel(const T *dy, const unsigned char *argmax, T *dx,
+        const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const unsigned long n);
+
 template<class T>
 static __global__ void FuncSoftmaxKernel(const T *x, T *y, const unsigned long n);
 
@@ -99,6 +128,27 @@ static __global__ void RmspropKernel(T *newDerivs, const T *derivs, T *msDeriv,
 template<class T>
 static __global__ void AdadeltaKernel(T *deltas, const T *derivs, T *msDeriv, T *msDelta, const T learningRate, const T decayRate, const unsigned long n);
 
+template<class T>
+static __global__ void FusedUpdateKernel(const hostOpt::UpdateTensor<T> t);
+
+template<class T>
+static __global__ void Bf16EncodeKernel(const T *x, unsigned short *y, const unsigned long n);
+
+template<class T>
+static __global__ void Bf16DecodeKernel(const unsigned short *x, T *y, const unsigned long n);
+
+template<class T>
+static __global__ void StateQuantEncodeKernel(const T *x, unsigned char *codes, T *scales, const unsigned long n);
+
+template<class T>
+static __global__ void StateQuantDecodeKernel(const unsigned char *codes, const T *scales, T *y, const unsigned long n);
+
+template<class T>
+static __global__ void DequantKernel(const unsigned char *x, T *y, const unsigned long n, const T *table);
+
+template<class T>
+static __global__ void HalfToFloatKernel(const unsigned short *x, T *y, const unsigned long n);
+
 
 template<>
 inline __device__ float _exp<float>(const float x)
@@ -182,6 +232,40 @@ static __global__ void AddKernel(const T *x, const T *y, T *z, const unsigned lo
 }
 
 
+template<class T>
+static __global__ void AddBiasKernel(const T *x, const T *b, T *z, const unsigned long nRows, const unsigned long n)
+{
+    unsigned long idx;
+
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if(idx >= n) return;
+
+    z[idx] = x[idx] + b[idx % nRows];
+}
+
+
+template<class T>
+static __global__ void RowSumKernel(const T *x, T *y, const T alpha, const T beta, const unsigned long nRows, const unsigned long nCols)
+{
+    unsigned long idx, j;
+    T sum;
+
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if(idx >= nRows) return;
+
+    /* Column-major: adjacent threads read adjacent rows */
+    sum = (T)0;
+    for(j = 0; j < nCols; j++)
+    {
+        sum += x[j * nRows + idx];
+    }
+
+    y[idx] = alpha * sum + (beta == (T)0 ? (T)0 : beta * y[idx]);
+}
+
+
 /* IBM check start */
 /* Signal quantization kernel for Sigmoid */
 /* If the QUANT_RELU flag is on Quantization Model */
@@ -311,6 +395,176 @@ if(relu_delta_final_decision == 1)
 /* IBM check end */
 
 
+template<class T>
+static __global__ void ConvActPoolKernel(const T *x, const T *w, const T *b, T *y,
+        const unsigned long inMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outMaps, const unsigned long kernelDimY, const unsigned long kernelDimX,
+        const unsigned long poolWindow, const unsigned long poolStride, const unsigned long poolDimY, const unsigned long poolDimX,
+        const unsigned long n, FLOAT delta, int M, int relu_delta_final_decision)
+{
+    unsigned long idx, nk, k, py, px, i, j, c, r, s;
+    const T *in, *wk;
+    T z, acc, a;
+
+    /* One pooled output per thread; the convolution outputs of the window are not stored */
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if(idx >= n) return;
+
+    px = idx % poolDimX;
+    py = (idx / poolDimX) % poolDimY;
+    nk = idx / (poolDimX * poolDimY);
+    k = nk % outMaps;
+
+    z = (T)0;
+    for(i = 0; i < poolWindow; i++)
+    {
+        for(j = 0; j < poolWindow; j++)
+        {
+            acc = (b == NULL) ? (T)0 : b[k];
+
+            for(c = 0; c < inMaps; c++)
+            {
+                in = x + ((nk / outMaps) * inMaps + c) * inDimY * inDimX
+                    + (py * poolStride + i) * inDimX + px * poolStride + j;
+                wk = w + (k * inMaps + c) * kernelDimY * kernelDimX;
+
+                /* CUDNN_CONVOLUTION: the kernel is flipped */
+                for(r = 0; r < kernelDimY; r++)
+                {
+                    for(s = 0; s < kernelDimX; s++)
+                    {
+                        acc += wk[(kernelDimY - 1 - r) * kernelDimX + (kernelDimX - 1 - s)] * in[r * inDimX + s];
+                    }
+                }
+            }
+
+            /* The activation is monotonic, so the maximum is taken before it */
+            z = (i == 0 && j == 0) ? acc : max(z, acc);
+        }
+    }
+
+    /* Leaky, as in FuncRectLinearKernel */
+    a = max((T)0.01 * z, z);
+#if QUANT_RELU
+    if(relu_delta_final_decision == 1)
+    {
+        a = min((T)floor((a/delta)+(T)0.5),(T)(M-1));
+        a = a*delta;
+    }
+#endif
+    y[idx] = a;
+}
+
+
+template<class T>
+static __global__ void FuncStepLookupKernel(const T *x, T *y, const unsigned long n, const T *thresholds, const T *values, const int *cells,
+        const long nCode, const long nCell, const T lo, const T invStep)
+{
+    unsigned long idx;
+    long code;
+    T v;
+
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if(idx >= n) return;
+
+    v = x[idx];
+    code = 0;
+
+    if(v >= lo)
+    {
+        code = cells[min((long) ((v - lo) * invStep), nCell - 1)];
+
+        while(code < nCode - 1 && v >= thresholds[code]) code++;
+        while(code > 0 && v < thresholds[code - 1]) code--;
+    }
+
+    y[idx] = values[code];
+}
+
+
+template<class T>
+static __global__ void MaxPoolArgmaxForwardKernel(const T *x, T *y, unsigned char *argmax,
+        const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const unsigned long n)
+{
+    unsigned long idx, nc, py, px, i, j, maxIdx;
+    const T *in;
+    T v, maxVal;
+
+    /* One pooled output per thread */
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if(idx >= n) return;
+
+    px = idx % outDimX;
+    py = (idx / outDimX) % outDimY;
+    nc = idx / (outDimX * outDimY);
+
+    in = x + nc * inDimY * inDimX + py * stride * inDimX + px * stride;
+
+    maxVal = in[0];
+    maxIdx = 0;
+    for(i = 0; i < window; i++)
+    {
+        for(j = 0; j < window; j++)
+        {
+            v = in[i * inDimX + j];
+            if(v > maxVal)
+            {
+                maxVal = v;
+                maxIdx = i * window + j;
+            }
+        }
+    }
+
+    y[idx] = maxVal;
+    argmax[idx] = (unsigned char) maxIdx;
+}
+
+
+template<class T>
+static __global__ void MaxPoolArgmaxBackwardKernel(const T *dy, const unsigned char *argmax, T *dx,
+        const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const unsigned long n)
+{
+    unsigned long idx, nc, iy, ix, py, px, pyFrom, pyTo, pxFrom, pxTo, offset;
+    T sum;
+
+    /* One input per thread, gathering from the windows that cover it (no atomics needed) */
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if(idx >= n) return;
+
+    ix = idx % inDimX;
+    iy = (idx / inDimX) % inDimY;
+    nc = idx / (inDimX * inDimY);
+
+    pyFrom = iy + 1 > window ? (iy + 1 - window + stride - 1) / stride : 0;
+    pxFrom = ix + 1 > window ? (ix + 1 - window + stride - 1) / stride : 0;
+    pyTo = min(iy / stride + 1, outDimY);
+    pxTo = min(ix / stride + 1, outDimX);
+
+    dy += nc * outDimY * outDimX;
+    argmax += nc * outDimY * outDimX;
+
+    sum = (T)0;
+    for(py = pyFrom; py < pyTo; py++)
+    {
+        for(px = pxFrom; px < pxTo; px++)
+        {
+            offset = (iy - py * stride) * window + (ix - px * stride);
+            if(argmax[py * outDimX + px] == offset) sum += dy[py * outDimX + px];
+        }
+    }
+
+    dx[idx] = sum;
+}
+
+
 template<class T>
 static __global__ void FuncSoftmaxKernel(const T *x, T *y, const unsigned long n)
 {
@@ -534,6 +788,272 @@ static __global__ void AdadeltaKernel(T *deltas, const T *derivs, T *msDeriv, T
 }
 
 
+/* bfloat16: the upper half of a float, rounded to nearest even */
+inline __device__ unsigned short _toBf16(const float x)
+{
+    unsigned int u = __float_as_uint(x);
+
+    u += 0x7fff + ((u >> 16) & 1);
+
+    return (unsigned short) (u >> 16);
+}
+
+
+inline __device__ float _fromBf16(const unsigned short x)
+{
+    return __uint_as_float((unsigned int) x << 16);
+}
+
+
+inline __device__ float _fromHalf(const unsigned short x)
+{
+    unsigned int sign = (unsigned int) (x & 0x8000) << 16;
+    unsigned int exponent = (x >> 10) & 0x1f;
+    unsigned int mantissa = x & 0x3ff;
+
+    if(exponent == 0)
+    {
+        float f = (float) mantissa * 5.9604644775390625e-8f; /* subnormal: mantissa * 2^-24 */
+        return (sign != 0) ? -f : f;
+    }
+
+    return __uint_as_float(sign | (mantissa << 13) | ((exponent == 31) ? 0x7f800000u : (exponent + 112) << 23));
+}
+
+
+/* 8-bit code of the compact mean squares (see hostOpt::StateQuantEncode) */
+template<class T>
+inline __device__ T _stateValue(const unsigned char c, const T scale)
+{
+    return (c == 0) ? (T)0 : scale * exp2((T)((int) c - 255) / (T)hostOpt::STATE_CODES_PER_OCTAVE);
+}
+
+
+/* Number in [0, 1) for the stochastic rounding of element i at update seed (see hostOpt::StateDither) */
+inline __device__ float _stateDither(const unsigned long seed, const unsigned long i)
+{
+    unsigned int h = (unsigned int) i;
+
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    h += (unsigned int) seed * 0x9e3779b9u;
+
+    return (float) (h >> 8) * (1.0f / 16777216.0f);
+}
+
+
+template<class T>
+inline __device__ unsigned char _stateCode(const T x, const T invScale, const T u)
+{
+    const T r = x * invScale;
+    long c;
+
+    if(r <= (T)0) return 0;
+    if(r >= (T)1) return 255;
+    if(r <= _stateValue<T>(1, (T)1)) return 1;
+
+    c = max(1L, (long) floor((T)255 + (T)hostOpt::STATE_CODES_PER_OCTAVE * log2(r)));
+    if(c > 1 && r < _stateValue<T>(c, (T)1)) c--;
+    else if(c < 255 && r >= _stateValue<T>(c + 1, (T)1)) c++;
+
+    /* Round up with probability (r - value(c)) / (value(c + 1) - value(c)) */
+    if(c < 255)
+    {
+        const T lo = _stateValue<T>(c, (T)1);
+
+        if(u * (_stateValue<T>(c + 1, (T)1) - lo) < r - lo) c++;
+    }
+
+    return (unsigned char) c;
+}
+
+
+/* Maximum over a block of hostOpt::STATE_BLOCK threads; every thread calls it */
+template<class T>
+inline __device__ T _blockMax(const T x, T *buf)
+{
+    unsigned long i;
+
+    buf[threadIdx.x] = x;
+    __syncthreads();
+
+    for(i = blockDim.x / 2; i > 0; i /= 2)
+    {
+        if(threadIdx.x < i) buf[threadIdx.x] = max(buf[threadIdx.x], buf[threadIdx.x + i]);
+        __syncthreads();
+    }
+
+    T y = buf[0];
+    __syncthreads();
+
+    return y;
+}
+
+
+template<class T>
+static __global__ void FusedUpdateKernel(const hostOpt::UpdateTensor<T> t)
+{
+    /* One block per hostOpt::STATE_BLOCK elements, so that a compact mean square is re-encoded by its block */
+    __shared__ T buf[hostOpt::STATE_BLOCK];
+
+    const hostOpt::UpdateParam<T> &p = t.param;
+    const unsigned long idx = blockIdx.x * blockDim.x + threadIdx.x;
+    const bool active = (idx < t.n);
+    const bool useMsDeriv = (p.rule != hostOpt::UPDATE_NESTEROV);
+    const bool useMsDelta = (p.rule == hostOpt::UPDATE_ADADELTA);
+
+    T w, v, step, ms, md, rms;
+
+    w = v = step = ms = md = (T)0;
+
+    if(active == true)
+    {
+        /* Same sequence as the unfused update: MatAdd (Nesterov), Rmsprop or Adadelta, MatAdd, MatAdd, WeightQuant */
+        v = (t.velsBf16 != NULL) ? (T)_fromBf16(t.velsBf16[idx]) : t.vels[idx];
+        w = t.weights[idx] - p.momentum * v;
+        step = t.derivs[idx];
+
+        if(useMsDeriv == true)
+            ms = (t.msDerivCode != NULL) ? _stateValue<T>(t.msDerivCode[idx], t.msDerivScale[blockIdx.x]) : t.msDeriv[idx];
+
+        if(useMsDelta == true)
+            md = (t.msDeltaCode != NULL) ? _stateValue<T>(t.msDeltaCode[idx], t.msDeltaScale[blockIdx.x]) : t.msDelta[idx];
+
+        if(p.rule == hostOpt::UPDATE_RMSPROP)
+        {
+            T bound = _sqrt<T>((T)1 / ((T)1 - p.decayRate));
+
+            ms = p.decayRate * ms + ((T)1 - p.decayRate) * step * step;
+            rms = _sqrt<T>(ms) + (T)1e-20;
+
+            step = min(bound, max(-bound, step / rms));
+        }
+        else if(p.rule == hostOpt::UPDATE_ADADELTA)
+        {
+            const T bound = (T)10;
+
+            ms = p.decayRate * ms + ((T)1 - p.decayRate) * step * step;
+            rms = _sqrt<T>(ms) + (T)1e-20;
+
+            step = _sqrt<T>(md + p.rate * p.rate) * min(bound, max(-bound, step / rms));
+            md = p.decayRate * md + ((T)1 - p.decayRate) * step * step;
+        }
+
+        v = p.velDecay * v + p.velScale * step;
+        w += ((T)1 + p.momentum) * v;
+
+        if(t.velsBf16 != NULL)
+            t.velsBf16[idx] = _toBf16((float) v);
+        else
+            t.vels[idx] = v;
+
+        t.weights[idx] = w;
+
+        if(useMsDeriv == true && t.msDerivCode == NULL) t.msDeriv[idx] = ms;
+        if(useMsDelta == true && t.msDeltaCode == NULL) t.msDelta[idx] = md;
+
+        if(p.quantM > 0)
+        {
+            if(signbit(w) != 0)
+                t.weightsFixed[idx] = (T)-1 * min((T)floor((fabs(w)/p.quantDelta)+(T)0.5),(T)(p.quantM-1)/2) * p.quantDelta;
+            else
+                t.weightsFixed[idx] = min((T)floor((fabs(w)/p.quantDelta)+(T)0.5),(T)((p.quantM-1)/2)) * p.quantDelta;
+        }
+    }
+
+    /* Re-encode the compact mean squares with the new maximum of the block (uniform branches) */
+    if(useMsDeriv == true && t.msDerivCode != NULL)
+    {
+        const T scale = _blockMax<T>(ms, buf);
+
+        if(active == true) t.msDerivCode[idx] = _stateCode<T>(ms, (scale > (T)0) ? (T)1 / scale : (T)0, (T)_stateDither(p.seed, idx));
+        if(threadIdx.x == 0) t.msDerivScale[blockIdx.x] = scale;
+    }
+
+    if(useMsDelta == true && t.msDeltaCode != NULL)
+    {
+        const T scale = _blockMax<T>(md, buf);
+
+        if(active == true) t.msDeltaCode[idx] = _stateCode<T>(md, (scale > (T)0) ? (T)1 / scale : (T)0, (T)_stateDither(p.seed, t.n + idx));
+        if(threadIdx.x == 0) t.msDeltaScale[blockIdx.x] = scale;
+    }
+}
+
+
+template<class T>
+static __global__ void Bf16EncodeKernel(const T *x, unsigned short *y, const unsigned long n)
+{
+    unsigned long idx;
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(idx >= n) return;
+
+    y[idx] = _toBf16((float) x[idx]);
+}
+
+
+template<class T>
+static __global__ void Bf16DecodeKernel(const unsigned short *x, T *y, const unsigned long n)
+{
+    unsigned long idx;
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(idx >= n) return;
+
+    y[idx] = (T) _fromBf16(x[idx]);
+}
+
+
+template<class T>
+static __global__ void StateQuantEncodeKernel(const T *x, unsigned char *codes, T *scales, const unsigned long n)
+{
+    /* One block per hostOpt::STATE_BLOCK elements */
+    __shared__ T buf[hostOpt::STATE_BLOCK];
+
+    const unsigned long idx = blockIdx.x * blockDim.x + threadIdx.x;
+    const T val = (idx < n) ? x[idx] : (T)0;
+    const T scale = _blockMax<T>(val, buf);
+
+    if(idx < n) codes[idx] = _stateCode<T>(val, (scale > (T)0) ? (T)1 / scale : (T)0, (T)_stateDither(0, idx));
+    if(threadIdx.x == 0) scales[blockIdx.x] = scale;
+}
+
+
+template<class T>
+static __global__ void StateQuantDecodeKernel(const unsigned char *codes, const T *scales, T *y, const unsigned long n)
+{
+    unsigned long idx;
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(idx >= n) return;
+
+    y[idx] = _stateValue<T>(codes[idx], scales[idx / hostOpt::STATE_BLOCK]);
+}
+
+
+template<class T>
+static __global__ void DequantKernel(const unsigned char *x, T *y, const unsigned long n, const T *table)
+{
+    /* The table is small enough to stay in the cache */
+    unsigned long idx;
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(idx >= n) return;
+
+    y[idx] = table[x[idx]];
+}
+
+
+template<class T>
+static __global__ void HalfToFloatKernel(const unsigned short *x, T *y, const unsigned long n)
+{
+    unsigned long idx;
+    idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if(idx >= n) return;
+
+    y[idx] = (T) _fromHalf(x[idx]);
+}
+
+
 template<class T>
 void MemSet(T *_x, const T val, const unsigned long n, const cudaStream_t stream)
 {
@@ -564,6 +1084,27 @@ void Add(const T *_x, const T *_y, T *_z, const unsigned long n, const cudaStrea
 }
 
 
+template<class T>
+void AddBias(const T *_x, const T *_b, T *_z, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream)
+{
+    const unsigned long n = nRows * nCols;
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    AddBiasKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _b, _z, nRows, n);
+}
+
+
+template<class T>
+void RowSum(const T *_x, T *_y, const T alpha, const T beta, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream)
+{
+    dim3 dimGrid((nRows + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    RowSumKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, alpha, beta, nRows, nCols);
+}
+
+
 /* IBM check start */
 /* Signal quantization kernel call for Sigmoid */
 template<class T>
@@ -627,6 +1168,64 @@ void FuncRectLinear(const T *_x, T *_y, T *_y_fixed,const unsigned long n, const
 /* IBM check end */
 
 
+template<class T>
+void ConvActPool(const T *_x, const T *_w, const T *_b, T *_y,
+        const unsigned long batchSize, const unsigned long inMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outMaps, const unsigned long kernelDimY, const unsigned long kernelDimX,
+        const unsigned long poolWindow, const unsigned long poolStride, const unsigned long poolDimY, const unsigned long poolDimX,
+        const cudaStream_t stream, FLOAT delta, int M, int relu_delta_final_decision)
+{
+    const unsigned long n = batchSize * outMaps * poolDimY * poolDimX;
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    ConvActPoolKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _w, _b, _y, inMaps, inDimY, inDimX,
+            outMaps, kernelDimY, kernelDimX, poolWindow, poolStride, poolDimY, poolDimX,
+            n, delta, M, relu_delta_final_decision);
+}
+
+
+template<class T>
+void FuncStepLookup(const T *_x, T *_y, const unsigned long n, const T *_thresholds, const T *_values, const int *_cells,
+        const long nCode, const long nCell, const T lo, const T invStep, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    FuncStepLookupKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, n, _thresholds, _values, _cells, nCode, nCell, lo, invStep);
+}
+
+
+template<class T>
+void MaxPoolArgmaxForward(const T *_x, T *_y, unsigned char *_argmax,
+        const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const cudaStream_t stream)
+{
+    const unsigned long n = batchSize * nMaps * outDimY * outDimX;
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    MaxPoolArgmaxForwardKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, _argmax,
+            inDimY, inDimX, outDimY, outDimX, window, stride, n);
+}
+
+
+template<class T>
+void MaxPoolArgmaxBackward(const T *_dy, const unsigned char *_argmax, T *_dx,
+        const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const cudaStream_t stream)
+{
+    const unsigned long n = batchSize * nMaps * inDimY * inDimX;
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    MaxPoolArgmaxBackwardKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_dy, _argmax, _dx,
+            inDimY, inDimX, outDimY, outDimX, window, stride, n);
+}
+
+
 template<class T>
 void FuncSoftmax(const T *_x, T *_y, const unsigned long layerSize, const unsigned long batchSize, const cudaStream_t stream)
 {
@@ -716,6 +1315,76 @@ void Adadelta(T *_deltas, const T *_derivs, T *_msDeriv, T *_msDelta, const T le
 }
 
 
+template<class T>
+void FusedUpdate(const hostOpt::UpdateTensor<T> &tensor, const cudaStream_t stream)
+{
+    dim3 dimGrid((tensor.n + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK);
+    dim3 dimBlock(hostOpt::STATE_BLOCK);
+
+    FusedUpdateKernel<T><<<dimGrid, dimBlock, 0, stream>>>(tensor);
+}
+
+
+template<class T>
+void Bf16Encode(const T *_x, unsigned short *_y, const unsigned long n, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    Bf16EncodeKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, n);
+}
+
+
+template<class T>
+void Bf16Decode(const unsigned short *_x, T *_y, const unsigned long n, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    Bf16DecodeKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, n);
+}
+
+
+template<class T>
+void StateQuantEncode(const T *_x, unsigned char *_codes, T *_scales, const unsigned long n, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK);
+    dim3 dimBlock(hostOpt::STATE_BLOCK);
+
+    StateQuantEncodeKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _codes, _scales, n);
+}
+
+
+template<class T>
+void StateQuantDecode(const unsigned char *_codes, const T *_scales, T *_y, const unsigned long n, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    StateQuantDecodeKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_codes, _scales, _y, n);
+}
+
+
+template<class T>
+void Dequant(const unsigned char *_x, T *_y, const unsigned long n, const T *_table, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    DequantKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, n, _table);
+}
+
+
+template<class T>
+void HalfToFloat(const unsigned short *_x, T *_y, const unsigned long n, const cudaStream_t stream)
+{
+    dim3 dimGrid((n + THREAD_PER_BLOCK - 1) / THREAD_PER_BLOCK);
+    dim3 dimBlock(THREAD_PER_BLOCK);
+
+    HalfToFloatKernel<T><<<dimGrid, dimBlock, 0, stream>>>(_x, _y, n);
+}
+
+
 template void MemSet<float>(float *_x, const float val, const unsigned long n, const cudaStream_t stream);
 template void MemSet<double>(double *_x, const double val, const unsigned long n, const cudaStream_t stream);
 
@@ -725,6 +1394,12 @@ template void ElemMult<double>(const double *_x, const double *_y, double *_z, c
 template void Add<float>(const float *_x, const float *_y, float *_z, const unsigned long n, const cudaStream_t stream);
 template void Add<double>(const double *_x, const double *_y, double *_z, const unsigned long n, const cudaStream_t stream);
 
+template void AddBias<float>(const float *_x, const float *_b, float *_z, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream);
+template void AddBias<double>(const double *_x, const double *_b, double *_z, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream);
+
+template void RowSum<float>(const float *_x, float *_y, const float alpha, const float beta, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream);
+template void RowSum<double>(const double *_x, double *_y, const double alpha, const double beta, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream);
+
 /* IBM check start */
 template void FuncSigmoid<float>(const float *_x, float *_y, float *_y_fixed,const unsigned long n, const cudaStream_t stream, FLOAT delta);
 template void FuncSigmoid<double>(const double *_x, double *_y, double *_y_fixed, const unsigned long n, const cudaStream_t stream, FLOAT delta);
@@ -743,6 +1418,40 @@ template void FuncSoftplus<float>(const float *_x, float *_y, const unsigned lon
 template void FuncSoftplus<double>(const double *_x, double *_y, const unsigned long n, const cudaStream_t stream);
 
 
+template void ConvActPool<float>(const float *_x, const float *_w, const float *_b, float *_y,
+        const unsigned long batchSize, const unsigned long inMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outMaps, const unsigned long kernelDimY, const unsigned long kernelDimX,
+        const unsigned long poolWindow, const unsigned long poolStride, const unsigned long poolDimY, const unsigned long poolDimX,
+        const cudaStream_t stream, FLOAT delta, int M, int relu_delta_final_decision);
+template void ConvActPool<double>(const double *_x, const double *_w, const double *_b, double *_y,
+        const unsigned long batchSize, const unsigned long inMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outMaps, const unsigned long kernelDimY, const unsigned long kernelDimX,
+        const unsigned long poolWindow, const unsigned long poolStride, const unsigned long poolDimY, const unsigned long poolDimX,
+        const cudaStream_t stream, FLOAT delta, int M, int relu_delta_final_decision);
+
+template void FuncStepLookup<float>(const float *_x, float *_y, const unsigned long n, const float *_thresholds, const float *_values, const int *_cells,
+        const long nCode, const long nCell, const float lo, const float invStep, const cudaStream_t stream);
+template void FuncStepLookup<double>(const double *_x, double *_y, const unsigned long n, const double *_thresholds, const double *_values, const int *_cells,
+        const long nCode, const long nCell, const double lo, const double invStep, const cudaStream_t stream);
+
+template void MaxPoolArgmaxForward<float>(const float *_x, float *_y, unsigned char *_argmax,
+        const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const cudaStream_t stream);
+template void MaxPoolArgmaxForward<double>(const double *_x, double *_y, unsigned char *_argmax,
+        const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const cudaStream_t stream);
+
+template void MaxPoolArgmaxBackward<float>(const float *_dy, const unsigned char *_argmax, float *_dx,
+        const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const cudaStream_t stream);
+template void MaxPoolArgmaxBackward<double>(const double *_dy, const unsigned char *_argmax, double *_dx,
+        const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+        const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+        const cudaStream_t stream);
+
 template void FuncSoftmax<float>(const float *_x, float *_y, const unsigned long layerSize, const unsigned long batchSize, const cudaStream_t stream);
 template void FuncSoftmax<double>(const double *_x, double *_y, const unsigned long layerSize, const unsigned long batchSize, const cudaStream_t stream);
 
@@ -770,6 +1479,27 @@ template void Rmsprop<double>(double *_newDerivs, const double *_derivs, double
 template void Adadelta<float>(float *_deltas, const float *_derivs, float *_msDeriv, float *_msDelta, const float learningRate, const float decayRate, const unsigned long n, const cudaStream_t stream);
 template void Adadelta<double>(double *_deltas, const double *_derivs, double *_msDeriv, double *_msDelta, const double learningRate, const double decayRate, const unsigned long n, const cudaStream_t stream);
 
+template void FusedUpdate<float>(const hostOpt::UpdateTensor<float> &tensor, const cudaStream_t stream);
+template void FusedUpdate<double>(const hostOpt::UpdateTensor<double> &tensor, const cudaStream_t stream);
+
+template void Bf16Encode<float>(const float *_x, unsigned short *_y, const unsigned long n, const cudaStream_t stream);
+template void Bf16Encode<double>(const double *_x, unsigned short *_y, const unsigned long n, const cudaStream_t stream);
+
+template void Bf16Decode<float>(const unsigned short *_x, float *_y, const unsigned long n, const cudaStream_t stream);
+template void Bf16Decode<double>(const unsigned short *_x, double *_y, const unsigned long n, const cudaStream_t stream);
+
+template void StateQuantEncode<float>(const float *_x, unsigned char *_codes, float *_scales, const unsigned long n, const cudaStream_t stream);
+template void StateQuantEncode<double>(const double *_x, unsigned char *_codes, double *_scales, const unsigned long n, const cudaStream_t stream);
+
+template void StateQuantDecode<float>(const unsigned char *_codes, const float *_scales, float *_y, const unsigned long n, const cudaStream_t stream);
+template void StateQuantDecode<double>(const unsigned char *_codes, const double *_scales, double *_y, const unsigned long n, const cudaStream_t stream);
+
+template void Dequant<float>(const unsigned char *_x, float *_y, const unsigned long n, const float *_table, const cudaStream_t stream);
+template void Dequant<double>(const unsigned char *_x, double *_y, const unsigned long n, const double *_table, const cudaStream_t stream);
+
+template void HalfToFloat<float>(const unsigned short *_x, float *_y, const unsigned long n, const cudaStream_t stream);
+template void HalfToFloat<double>(const unsigned short *_x, double *_y, const unsigned long n, const cudaStream_t stream);
+
 }
 
 }
@@ -20,6 +20,7 @@
 
 
 #include <cuda_runtime.h>
+#include "HostOpt.h"
 #include "FractalCommon.h"
 
 namespace fractal
@@ -38,6 +39,14 @@ namespace cudaKernels
     template<class T>
     void Add(const T *_x, const T *_y, T *_z, const unsigned long n, const cudaStream_t stream);
 
+    /* _z = _x + _b * ones(1, nCols) */
+    template<class T>
+    void AddBias(const T *_x, const T *_b, T *_z, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream);
+
+    /* _y = alpha * _x * ones(nCols, 1) + beta * _y */
+    template<class T>
+    void RowSum(const T *_x, T *_y, const T alpha, const T beta, const unsigned long nRows, const unsigned long nCols, const cudaStream_t stream);
+
     template<class T>
     void FuncSigmoid(const T *_x, T *_y,T *_y_fixed, const unsigned long n, const cudaStream_t stream, FLOAT delta);
 
@@ -53,6 +62,33 @@ namespace cudaKernels
     template<class T>
     void FuncRectLinear(const T *_x, T *_y, T *_y_fixed, const unsigned long n, const cudaStream_t stream, FLOAT delta, int M,int relu_delta_final_decision);
 
+    /* Inference block: _y = maxpool(rectlinear(conv(_x, _w) + _b)); _b may be NULL */
+    template<class T>
+    void ConvActPool(const T *_x, const T *_w, const T *_b, T *_y,
+            const unsigned long batchSize, const unsigned long inMaps, const unsigned long inDimY, const unsigned long inDimX,
+            const unsigned long outMaps, const unsigned long kernelDimY, const unsigned long kernelDimX,
+            const unsigned long poolWindow, const unsigned long poolStride, const unsigned long poolDimY, const unsigned long poolDimX,
+            const cudaStream_t stream, FLOAT delta, int M, int relu_delta_final_decision);
+
+    /* Quantized activation from a step table (see hostAct::StepTable) */
+    template<class T>
+    void FuncStepLookup(const T *_x, T *_y, const unsigned long n, const T *_thresholds, const T *_values, const int *_cells,
+            const long nCode, const long nCell, const T lo, const T invStep, const cudaStream_t stream);
+
+    /* Max pooling that stores the offset of the maximum within each window (row * window + col) */
+    template<class T>
+    void MaxPoolArgmaxForward(const T *_x, T *_y, unsigned char *_argmax,
+            const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+            const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+            const cudaStream_t stream);
+
+    /* Gradient of the max pooling from the stored offsets; the input of the pooling is not needed */
+    template<class T>
+    void MaxPoolArgmaxBackward(const T *_dy, const unsigned char *_argmax, T *_dx,
+            const unsigned long batchSize, const unsigned long nMaps, const unsigned long inDimY, const unsigned long inDimX,
+            const unsigned long outDimY, const unsigned long outDimX, const unsigned long window, const unsigned long stride,
+            const cudaStream_t stream);
+
     template<class T>
     void FuncSoftmax(const T *_x, T *_y, const unsigned long layerSize, const unsigned long batchSize, const cudaStream_t stream);
 
@@ -79,6 +115,30 @@ namespace cudaKernels
 
     template<class T>
     void Adadelta(T *_deltas, const T *_derivs, T *_msDeriv, T *_msDelta, const T learningRate, const T decayRate, const unsigned long n, const cudaStream_t stream);
+
+    /* Fused optimizer step of one tensor (see hostOpt::UpdateParam) */
+    template<class T>
+    void FusedUpdate(const hostOpt::UpdateTensor<T> &tensor, const cudaStream_t stream);
+
+    /* Compact optimizer state (see hostOpt::StateQuantEncode) */
+    template<class T>
+    void Bf16Encode(const T *_x, unsigned short *_y, const unsigned long n, const cudaStream_t stream);
+
+    template<class T>
+    void Bf16Decode(const unsigned short *_x, T *_y, const unsigned long n, const cudaStream_t stream);
+
+    template<class T>
+    void StateQuantEncode(const T *_x, unsigned char *_codes, T *_scales, const unsigned long n, const cudaStream_t stream);
+
+    template<class T>
+    void StateQuantDecode(const unsigned char *_codes, const T *_scales, T *_y, const unsigned long n, const cudaStream_t stream);
+
+    /* Compact input channels (see hostAct::Dequant) */
+    template<class T>
+    void Dequant(const unsigned char *_x, T *_y, const unsigned long n, const T *_table, const cudaStream_t stream);
+
+    template<class T>
+    void HalfToFloat(const unsigned short *_x, T *_y, const unsigned long n, const cudaStream_t stream);
 }
 
 }
@@ -191,6 +191,8 @@ void Engine::ConvForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLayer
     ptrweight = (FLOAT *)memweight->GetPtr(loc) + _weight.GetOffset();
     ptrnextState = (FLOAT *)memnextState->GetPtr(loc) + _nextLayerState.GetOffset();
 
+#ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     checkCUDNN(cudnnSetStream(cudnnHandle,stream.cudaStream));
     checkCUDNN(cudnnSetTensor4dDescriptor(srcTensorDesc,tensorFormat,dataType,curBatchSize,prevLayerNumMaps,prevLayerDimY,prevLayerDimX));
 
@@ -252,6 +254,120 @@ void Engine::ConvForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLayer
     //      checkCudaErrors(cudaFree(workSpace));
     //}
      */
+    mtxHandle.unlock();
+#else
+    hostConv::ConvShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.inMaps = prevLayerNumMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outMaps = nextLayerNumMaps;
+    shape.outDimX = nextLayerDimX;
+    shape.outDimY = nextLayerDimY;
+    shape.kernelDimX = kernelDimX;
+    shape.kernelDimY = kernelDimY;
+
+    /* Benchmarked only the first time the shape is seen */
+    const hostConv::ConvPlan &plan = hostConvPlanner.GetPlan<FLOAT>(shape);
+    const long workspaceSize = hostConv::GetWorkspaceSize(shape, plan.algo);
+
+    std::lock_guard<std::mutex> lock(mtxHostConv);
+
+    if((long) hostConvWorkspace.size() < workspaceSize)
+        hostConvWorkspace.resize(workspaceSize);
+
+    if(plan.algo == hostConv::CONV_ALGO_WINOGRAD)
+    {
+        /* The weights change only once per update, so the transformed filter is reused across the frames */
+        const FLOAT *U = hostFilterCache.GetWinogradFilter(ptrweight, memweight->GetVersion(), shape);
+
+        hostConv::WinogradConvForward<FLOAT>(ptrprevAct, U, ptrnextState, shape, hostConvWorkspace.data());
+    }
+    else
+    {
+        hostConv::ConvForward<FLOAT>(ptrprevAct, ptrweight, ptrnextState, shape, plan.algo, hostConvWorkspace.data());
+    }
+#endif /* FRACTAL_USE_CUDA */
+    memnextState->Push(loc);
+}
+
+
+/* Fused convolution + bias + rectlinear + max pooling for inference */
+void Engine::ConvActPoolForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_weight, Matrix<FLOAT> *_biases, Matrix<FLOAT> &_nextLayerState,
+        long kernelDimX, long kernelDimY, long prevLayerDimX, long prevLayerDimY, long prevLayerNumMaps,
+        long convLayerDimX, long convLayerDimY, long convLayerNumMaps, long nextLayerDimX, long nextLayerDimY,
+        long poolWindow, long poolStride, long curBatchSize, PStream &stream, FLOAT delta, int M, int relu_delta_final_decision)
+{
+    verify(_prevLayerAct.GetEngine() == this);
+    verify(_nextLayerState.GetEngine() == this);
+    verify(_weight.GetEngine() == this);
+    verify(convLayerDimX == prevLayerDimX - kernelDimX + 1 && convLayerDimY == prevLayerDimY - kernelDimY + 1);
+    verify(nextLayerDimX == (convLayerDimX - poolWindow) / poolStride + 1);
+    verify(nextLayerDimY == (convLayerDimY - poolWindow) / poolStride + 1);
+
+    Mem *memprevAct, *memnextState, *memweight, *membiases = NULL;
+    FLOAT *ptrprevAct, *ptrnextState, *ptrweight, *ptrbiases = NULL;
+    unsigned long loc;
+
+    verify((memprevAct = _prevLayerAct.GetMem()) != NULL);
+    verify((memnextState = _nextLayerState.GetMem()) != NULL);
+    verify((memweight = _weight.GetMem()) != NULL);
+
+    loc = stream.loc;
+
+    memprevAct->Pull(loc, stream);
+    memweight->Pull(loc, stream);
+
+    if(_biases != NULL)
+    {
+        verify(_biases->GetEngine() == this);
+        verify((membiases = _biases->GetMem()) != NULL);
+
+        membiases->Pull(loc, stream);
+        ptrbiases = (FLOAT *)membiases->GetPtr(loc) + _biases->GetOffset();
+    }
+
+    if(_nextLayerState.GetNumRows()*_nextLayerState.GetNumCols() * sizeof(FLOAT)<memnextState->GetSize())
+        memnextState->Pull(loc,stream);
+    else
+        MemAlloc(memnextState, loc);
+
+    ptrprevAct = (FLOAT *)memprevAct->GetPtr(loc) + _prevLayerAct.GetOffset();
+    ptrweight = (FLOAT *)memweight->GetPtr(loc) + _weight.GetOffset();
+    ptrnextState = (FLOAT *)memnextState->GetPtr(loc) + _nextLayerState.GetOffset();
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::ConvActPool<FLOAT>(ptrprevAct, ptrweight, ptrbiases, ptrnextState,
+            curBatchSize, prevLayerNumMaps, prevLayerDimY, prevLayerDimX,
+            convLayerNumMaps, kernelDimY, kernelDimX,
+            poolWindow, poolStride, nextLayerDimY, nextLayerDimX,
+            stream.cudaStream, delta, M, relu_delta_final_decision);
+#else
+    hostConv::ConvShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.inMaps = prevLayerNumMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outMaps = convLayerNumMaps;
+    shape.outDimX = convLayerDimX;
+    shape.outDimY = convLayerDimY;
+    shape.kernelDimX = kernelDimX;
+    shape.kernelDimY = kernelDimY;
+
+    /* Same activation as FuncRectLinear() */
+#if QUANT_RELU
+    const bool quantize = (relu_delta_final_decision == 1);
+#else
+    const bool quantize = false;
+#endif
+
+    hostConv::ConvActPoolForward<FLOAT>(ptrprevAct, ptrweight, ptrbiases, ptrnextState, shape,
+            poolWindow, poolStride, nextLayerDimX, nextLayerDimY,
+            (FLOAT) 0.01, quantize, delta, M);
+#endif /* FRACTAL_USE_CUDA */
+
     memnextState->Push(loc);
 }
 
@@ -325,6 +441,8 @@ void Engine::ConvBackward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_prevLaye
     //cudnnFilterDescriptor_t filterDesc_d = filterDesc;
     //cudnnConvolutionDescriptor_t convDesc_d = convDesc;
 
+#ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     float alpha = 1.f; 
     float beta = 0.f;
 
@@ -406,6 +524,31 @@ void Engine::ConvBackward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_prevLaye
     first_data = 1;
     fclose(fp_c);
     }*/
+    mtxHandle.unlock();
+#else
+    hostConv::ConvShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.inMaps = prevLayerNumMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outMaps = nextLayerNumMaps;
+    shape.outDimX = nextLayerDimX;
+    shape.outDimY = nextLayerDimY;
+    shape.kernelDimX = kernelDimX;
+    shape.kernelDimY = kernelDimY;
+
+    if(performBackwardProp == true)
+    {
+        hostConv::ConvBackwardData<FLOAT>(ptrnextErr, ptrweight, ptrprevErr, shape, hostConv::CONV_ALGO_AUTO);
+        memprevErr->Push(loc);
+    }
+    else
+    {
+        hostConv::ConvBackwardFilter<FLOAT>(ptrprevAct, ptrnextErr, ptrderiv, shape, hostConv::CONV_ALGO_AUTO);
+        memderiv->Push(loc);
+    }
+#endif /* FRACTAL_USE_CUDA */
 }
 
 /* IBM check */
@@ -439,12 +582,18 @@ void Engine::ConvBiasForward(Matrix<FLOAT> &_nextLayerState, Matrix<FLOAT> &_bia
     ptrbiases = (FLOAT *)membiases->GetPtr(loc) + _biases.GetOffset();
     //add cudnn code   
      
+#ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     checkCUDNN(cudnnSetStream(cudnnHandle,stream.cudaStream));
     //checkCUDNN(cudnnSetTensor4dDescriptor(biasTensorDesc,tensorFormat,dataType,curBatchSize,prevLayerNumMaps,prevLayerDimY,prevLayerDimX));
     checkCUDNN(cudnnSetTensor4dDescriptor(biasTensorDesc,tensorFormat,dataType,1,nextLayerNumMaps,1,1));
     checkCUDNN(cudnnSetTensor4dDescriptor(dstTensorDesc,tensorFormat,dataType,curBatchSize,nextLayerNumMaps,nextLayerDimY,nextLayerDimX));
 
     checkCUDNN(cudnnAddTensor_v2(cudnnHandle,CUDNN_ADD_SAME_C,&alpha,biasTensorDesc,ptrbiases,&beta,dstTensorDesc, ptrnextState));
+    mtxHandle.unlock();
+#else
+    hostConv::ConvBiasForward<FLOAT>(ptrbiases, ptrnextState, curBatchSize, nextLayerNumMaps, nextLayerDimX * nextLayerDimY);
+#endif /* FRACTAL_USE_CUDA */
 
 
     memnextState->Push(loc);
@@ -483,11 +632,17 @@ void Engine::ConvBiasBackward(Matrix<FLOAT> &_nextLayerErr, Matrix<FLOAT> &_deri
     //MatSet(_deriv, (FLOAT) 0, stream);
     
     
+#ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     checkCUDNN(cudnnSetStream(cudnnHandle,stream.cudaStream));
     checkCUDNN(cudnnSetTensor4dDescriptor(srcTensorDesc,tensorFormat,dataType,curBatchSize,nextLayerNumMaps,nextLayerDimY,nextLayerDimX));
     checkCUDNN(cudnnSetTensor4dDescriptor(dstTensorDesc,tensorFormat,dataType,1,nextLayerNumMaps,1,1));
 
     checkCUDNN(cudnnConvolutionBackwardBias(cudnnHandle,&alpha,srcTensorDesc,ptrnextErr,&beta,dstTensorDesc, ptrderiv));
+    mtxHandle.unlock();
+#else
+    hostConv::ConvBiasBackward<FLOAT>(ptrnextErr, ptrderiv, curBatchSize, nextLayerNumMaps, nextLayerDimX * nextLayerDimY);
+#endif /* FRACTAL_USE_CUDA */
 
     memderiv->Push(loc);
 }
@@ -601,23 +756,25 @@ void Engine::MaxPoolForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLa
     ptrnextState = (FLOAT *)memnextState->GetPtr(loc) + _nextLayerState.GetOffset();
 
     
+#ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     checkCUDNN(cudnnSetStream(cudnnHandle,stream.cudaStream));
     if(max_avg == 0)//max pooling
     {
         checkCUDNN( cudnnSetPooling2dDescriptor(poolingDesc,
                     CUDNN_POOLING_MAX,
-                    3, 3, // window
+                    POOL_WINDOW, POOL_WINDOW, // window
                     0, 0, // padding
-                    2, 2  // stride
+                    POOL_STRIDE, POOL_STRIDE  // stride
                     ) );
     }
     else // average pooling
     {
         checkCUDNN( cudnnSetPooling2dDescriptor(poolingDesc,
                     CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING,
-                    3, 3, // window
+                    POOL_WINDOW, POOL_WINDOW, // window
                     0, 0, // padding
-                    2, 2  // stride
+                    POOL_STRIDE, POOL_STRIDE  // stride
                     ) );
 
     }
@@ -643,6 +800,21 @@ void Engine::MaxPoolForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLa
                 &beta,
                 dstTensorDesc,
                 ptrnextState));
+    mtxHandle.unlock();
+#else
+    hostConv::PoolShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.nMaps = nextLayerNumMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outDimX = nextLayerDimX;
+    shape.outDimY = nextLayerDimY;
+    shape.window = POOL_WINDOW;
+    shape.stride = POOL_STRIDE;
+
+    hostConv::PoolForward<FLOAT>(ptrprevAct, ptrnextState, NULL, shape, max_avg == 0);
+#endif /* FRACTAL_USE_CUDA */
 
 
     memnextState->Push(loc);
@@ -691,23 +863,25 @@ void Engine::MaxPoolBackward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextL
     float alpha = 1.f;
     float beta = 0.f;
    
+#ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     checkCUDNN(cudnnSetStream(cudnnHandle,stream.cudaStream));
     if(max_avg == 0) //maxpooling
     {
     checkCUDNN( cudnnSetPooling2dDescriptor(poolingDesc,
                 CUDNN_POOLING_MAX,
-                3, 3, // window
+                POOL_WINDOW, POOL_WINDOW, // window
                 0, 0, // padding
-                2, 2  // stride
+                POOL_STRIDE, POOL_STRIDE  // stride
                 ) );
     }
     else // average pooling
     {
     checkCUDNN( cudnnSetPooling2dDescriptor(poolingDesc,
                 CUDNN_POOLING_AVERAGE_COUNT_EXCLUDE_PADDING,
-                3, 3, // window
+                POOL_WINDOW, POOL_WINDOW, // window
                 0, 0, // padding
-                2, 2  // stride
+                POOL_STRIDE, POOL_STRIDE  // stride
                 ) );
     
     }
@@ -751,11 +925,137 @@ void Engine::MaxPoolBackward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextL
                 &beta,
                 dstpoolTensorDesc,
                 ptrprevErr));
+    mtxHandle.unlock();
+#else
+    hostConv::PoolShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.nMaps = prevLayerNumMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outDimX = nextLayerDimX;
+    shape.outDimY = nextLayerDimY;
+    shape.window = POOL_WINDOW;
+    shape.stride = POOL_STRIDE;
+
+    hostConv::PoolBackward<FLOAT>(ptrprevAct, ptrnextState, ptrnextErr, ptrprevErr, shape, max_avg == 0);
+#endif /* FRACTAL_USE_CUDA */
     
     memprevErr->Push(loc);
 }
 
 
+void Engine::MaxPoolArgmaxForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLayerState, Matrix<unsigned char> &_argmax,
+        long prevLayerDimX, long prevLayerDimY, long nextLayerDimX, long nextLayerDimY, long numMaps,
+        long poolWindow, long poolStride, long curBatchSize, PStream &stream)
+{
+    verify(_prevLayerAct.GetEngine() == this);
+    verify(_nextLayerState.GetEngine() == this);
+    verify(_argmax.GetEngine() == this);
+    verify(poolWindow * poolWindow <= 256);
+    verify(nextLayerDimX == (prevLayerDimX - poolWindow) / poolStride + 1);
+    verify(nextLayerDimY == (prevLayerDimY - poolWindow) / poolStride + 1);
+
+    Mem *memprevAct, *memnextState, *memargmax;
+    FLOAT *ptrprevAct, *ptrnextState;
+    unsigned char *ptrargmax;
+    unsigned long loc;
+
+    verify((memprevAct = _prevLayerAct.GetMem()) != NULL);
+    verify((memnextState = _nextLayerState.GetMem()) != NULL);
+    verify((memargmax = _argmax.GetMem()) != NULL);
+
+    loc = stream.loc;
+
+    memprevAct->Pull(loc, stream);
+
+    MemAlloc(memnextState, loc);
+
+    /* The other columns hold the indices of the other time steps */
+    if(_argmax.GetNumRows() * _argmax.GetNumCols() < memargmax->GetSize())
+        memargmax->Pull(loc, stream);
+    else
+        MemAlloc(memargmax, loc);
+
+    ptrprevAct = (FLOAT *)memprevAct->GetPtr(loc) + _prevLayerAct.GetOffset();
+    ptrnextState = (FLOAT *)memnextState->GetPtr(loc) + _nextLayerState.GetOffset();
+    ptrargmax = (unsigned char *)memargmax->GetPtr(loc) + _argmax.GetOffset();
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::MaxPoolArgmaxForward<FLOAT>(ptrprevAct, ptrnextState, ptrargmax,
+            curBatchSize, numMaps, prevLayerDimY, prevLayerDimX, nextLayerDimY, nextLayerDimX,
+            poolWindow, poolStride, stream.cudaStream);
+#else
+    hostConv::PoolShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.nMaps = numMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outDimX = nextLayerDimX;
+    shape.outDimY = nextLayerDimY;
+    shape.window = poolWindow;
+    shape.stride = poolStride;
+
+    hostConv::PoolForward<FLOAT>(ptrprevAct, ptrnextState, ptrargmax, shape, true);
+#endif /* FRACTAL_USE_CUDA */
+
+    memnextState->Push(loc);
+    memargmax->Push(loc);
+}
+
+
+void Engine::MaxPoolArgmaxBackward(Matrix<FLOAT> &_nextLayerErr, Matrix<unsigned char> &_argmax, Matrix<FLOAT> &_prevLayerErr,
+        long prevLayerDimX, long prevLayerDimY, long nextLayerDimX, long nextLayerDimY, long numMaps,
+        long poolWindow, long poolStride, long curBatchSize, PStream &stream)
+{
+    verify(_nextLayerErr.GetEngine() == this);
+    verify(_argmax.GetEngine() == this);
+    verify(_prevLayerErr.GetEngine() == this);
+
+    Mem *memnextErr, *memargmax, *memprevErr;
+    FLOAT *ptrnextErr, *ptrprevErr;
+    unsigned char *ptrargmax;
+    unsigned long loc;
+
+    verify((memnextErr = _nextLayerErr.GetMem()) != NULL);
+    verify((memargmax = _argmax.GetMem()) != NULL);
+    verify((memprevErr = _prevLayerErr.GetMem()) != NULL);
+
+    loc = stream.loc;
+
+    memnextErr->Pull(loc, stream);
+    memargmax->Pull(loc, stream);
+
+    MemAlloc(memprevErr, loc);
+
+    ptrnextErr = (FLOAT *)memnextErr->GetPtr(loc) + _nextLayerErr.GetOffset();
+    ptrargmax = (unsigned char *)memargmax->GetPtr(loc) + _argmax.GetOffset();
+    ptrprevErr = (FLOAT *)memprevErr->GetPtr(loc) + _prevLayerErr.GetOffset();
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::MaxPoolArgmaxBackward<FLOAT>(ptrnextErr, ptrargmax, ptrprevErr,
+            curBatchSize, numMaps, prevLayerDimY, prevLayerDimX, nextLayerDimY, nextLayerDimX,
+            poolWindow, poolStride, stream.cudaStream);
+#else
+    hostConv::PoolShape shape;
+
+    shape.batchSize = curBatchSize;
+    shape.nMaps = numMaps;
+    shape.inDimX = prevLayerDimX;
+    shape.inDimY = prevLayerDimY;
+    shape.outDimX = nextLayerDimX;
+    shape.outDimY = nextLayerDimY;
+    shape.window = poolWindow;
+    shape.stride = poolStride;
+
+    hostConv::MaxPoolArgmaxBackward<FLOAT>(ptrnextErr, ptrargmax, ptrprevErr, shape);
+#endif /* FRACTAL_USE_CUDA */
+
+    memprevErr->Push(loc);
+}
+
+
 void Engine::MemAdd(Mem *mem)
 {
     mtxMem.lock();
@@ -1015,6 +1315,7 @@ void Engine::MatMult(Matrix<FLOAT> &A, const bool transA, Matrix<FLOAT> &B, cons
     /* TODO: check if loc is host or not */
 
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     verify(cublasSetStream(cublasHandle, stream.cudaStream) == CUBLAS_STATUS_SUCCESS);
 
     if(C.GetNumCols() == 1) /* If C is a vector */
@@ -1051,6 +1352,7 @@ void Engine::MatMult(Matrix<FLOAT> &A, const bool transA, Matrix<FLOAT> &B, cons
                     C.GetNumRows())
                 == CUBLAS_STATUS_SUCCESS);
     }
+    mtxHandle.unlock();
 #else
     verify(false); /* CPU computation is not supported */
 #endif /* FRACTAL_USE_CUDA */
@@ -1098,6 +1400,7 @@ void Engine::MatAdd(Matrix<FLOAT> &A, Matrix<FLOAT> &B, const FLOAT alpha, PStre
     ptrB = B.GetPtrForReadWrite(stream);
 
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     verify(cublasSetStream(cublasHandle, stream.cudaStream) == CUBLAS_STATUS_SUCCESS);
 
     verify(AXPY(cublasHandle,
@@ -1108,6 +1411,7 @@ void Engine::MatAdd(Matrix<FLOAT> &A, Matrix<FLOAT> &B, const FLOAT alpha, PStre
                 ptrB,
                 1)
             == CUBLAS_STATUS_SUCCESS);
+    mtxHandle.unlock();
 #else
     verify(false); /* CPU computation is not supported */
 #endif /* FRACTAL_USE_CUDA */
@@ -1142,6 +1446,52 @@ void Engine::MatAdd(Matrix<FLOAT> &A, Matrix<FLOAT> &B, Matrix<FLOAT> &C, PStrea
 }
 
 
+void Engine::MatAddBias(Matrix<FLOAT> &A, Matrix<FLOAT> &b, Matrix<FLOAT> &C, PStream &stream)
+{
+    verify(A.GetEngine() == this);
+    verify(b.GetEngine() == this);
+    verify(C.GetEngine() == this);
+    verify(A.GetNumRows() == b.GetNumRows() * b.GetNumCols());
+    verify(A.GetNumRows() == C.GetNumRows());
+    verify(A.GetNumCols() == C.GetNumCols());
+
+    FLOAT *ptrA, *ptrB, *ptrC;
+
+    ptrA = A.GetPtrForReadWrite(stream);
+    ptrB = b.GetPtrForReadWrite(stream);
+    ptrC = C.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::AddBias<FLOAT>(ptrA, ptrB, ptrC, A.GetNumRows(), A.GetNumCols(), stream.cudaStream);
+#else
+    verify(false); /* CPU computation is not supported */
+#endif /* FRACTAL_USE_CUDA */
+
+    C.FinishWrite(stream);
+}
+
+
+void Engine::MatRowSum(Matrix<FLOAT> &A, Matrix<FLOAT> &y, const FLOAT alpha, const FLOAT beta, PStream &stream)
+{
+    verify(A.GetEngine() == this);
+    verify(y.GetEngine() == this);
+    verify(A.GetNumRows() == y.GetNumRows() * y.GetNumCols());
+
+    FLOAT *ptrA, *ptrY;
+
+    ptrA = A.GetPtrForReadWrite(stream);
+    ptrY = y.GetPtrForReadWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::RowSum<FLOAT>(ptrA, ptrY, alpha, beta, A.GetNumRows(), A.GetNumCols(), stream.cudaStream);
+#else
+    verify(false); /* CPU computation is not supported */
+#endif /* FRACTAL_USE_CUDA */
+
+    y.FinishWrite(stream);
+}
+
+
 void Engine::MatSet(Matrix<FLOAT> &mat, const FLOAT val, PStream &stream)
 {
     verify(mat.GetEngine() == this);
@@ -1170,6 +1520,7 @@ void Engine::MatRandN(Matrix<FLOAT> &mat, const FLOAT mean, const FLOAT stdev, P
     ptr = mat.GetPtrForWrite(stream);
 
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     /* curandGenerateNormal requires even number of elements */
     unsigned long n;
     verify(CUDA_CHUNK_SIZE >= 2 * sizeof(FLOAT));
@@ -1178,6 +1529,7 @@ void Engine::MatRandN(Matrix<FLOAT> &mat, const FLOAT mean, const FLOAT stdev, P
 
     verify(curandSetStream(curandGen, stream.cudaStream) == CURAND_STATUS_SUCCESS);
     verify(RANDN(curandGen, ptr, n, mean, stdev) == CURAND_STATUS_SUCCESS);
+    mtxHandle.unlock();
 #else
     verify(false); /* CPU computation is not supported */
 #endif /* FRACTAL_USE_CUDA */
@@ -1199,6 +1551,7 @@ void Engine::MatCopy(Matrix<FLOAT> &A, Matrix<FLOAT> &B, PStream &stream)
     ptrB = B.GetPtrForWrite(stream);
 
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     cublasSetStream(cublasHandle, stream.cudaStream);
     verify(COPY(cublasHandle,
                 A.GetNumRows() * A.GetNumCols(),
@@ -1207,6 +1560,7 @@ void Engine::MatCopy(Matrix<FLOAT> &A, Matrix<FLOAT> &B, PStream &stream)
                 ptrB,
                 1)
             == CUBLAS_STATUS_SUCCESS);
+    mtxHandle.unlock();
 #else
     verify(false); /* CPU computation is not supported */
 #endif /* FRACTAL_USE_CUDA */
@@ -1228,6 +1582,7 @@ void Engine::MatTranspose(Matrix<FLOAT> &A, Matrix<FLOAT> &B, PStream &stream)
     ptrB = B.GetPtrForWrite(stream);
 
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     FLOAT alpha = (FLOAT) 1;
     FLOAT beta = (FLOAT) 0;
 
@@ -1246,6 +1601,7 @@ void Engine::MatTranspose(Matrix<FLOAT> &A, Matrix<FLOAT> &B, PStream &stream)
                 ptrB,
                 B.GetNumRows())
             == CUBLAS_STATUS_SUCCESS);
+    mtxHandle.unlock();
 #else
     verify(false); /* CPU computation is not supported */
 #endif /* FRACTAL_USE_CUDA */
@@ -1256,7 +1612,8 @@ void Engine::MatTranspose(Matrix<FLOAT> &A, Matrix<FLOAT> &B, PStream &stream)
 
 /* IBM check start */
 /* Signal quantization for Sigmoid */
-void Engine::FuncSigmoid(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed, PStream &stream, FLOAT delta)
+void Engine::FuncSigmoid(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed, PStream &stream, FLOAT delta,
+        FLOAT *actMin, FLOAT *actMax)
 {
     verify(X.GetEngine() == this);
     verify(Y.GetEngine() == this);
@@ -1272,7 +1629,14 @@ void Engine::FuncSigmoid(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fi
 #ifdef FRACTAL_USE_CUDA
     cudaKernels::FuncSigmoid(ptrX, ptrY, ptrY_fixed, Y.GetNumRows() * Y.GetNumCols(), stream.cudaStream, delta);
 #else
-    verify(false); /* CPU computation is not supported */
+    /* Same condition as FuncSigmoidKernel */
+#if QUANT_RELU
+    const bool quantize = (delta < 101.0 && delta > 99.0) == false;
+#else
+    const bool quantize = false;
+#endif
+
+    hostAct::Sigmoid<FLOAT>(ptrX, ptrY, ptrY_fixed, Y.GetNumRows() * Y.GetNumCols(), quantize, delta, actMin, actMax);
 #endif /* FRACTAL_USE_CUDA */
 	Y.FinishWrite(stream);
 	Y_fixed.FinishWrite(stream);
@@ -1298,7 +1662,8 @@ void Engine::FuncSigmoid(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fi
 
 /* IBM check start */
 /* Signal quantization for Tanh */
-void Engine::FuncTanh(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream,FLOAT delta)
+void Engine::FuncTanh(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream,FLOAT delta,
+        FLOAT *actMin, FLOAT *actMax)
 {
     verify(X.GetEngine() == this);
     verify(Y.GetEngine() == this);
@@ -1313,7 +1678,13 @@ void Engine::FuncTanh(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream,FLOAT
 #ifdef FRACTAL_USE_CUDA
     cudaKernels::FuncTanh(ptrX, ptrY, Y.GetNumRows() * Y.GetNumCols(), stream.cudaStream, delta);
 #else
-    verify(false); /* CPU computation is not supported */
+#if QUANT_RELU
+    const bool quantize = (delta < 101.0 && delta > 99.0) == false;
+#else
+    const bool quantize = false;
+#endif
+
+    hostAct::Tanh<FLOAT>(ptrX, ptrY, Y.GetNumRows() * Y.GetNumCols(), quantize, delta, actMin, actMax);
 #endif /* FRACTAL_USE_CUDA */
 
     Y.FinishWrite(stream);
@@ -1369,7 +1740,8 @@ void Engine::FuncSoftplus(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream)
 
 /* IBM check start */
 /* Signal quantization for RectLinear */
-void Engine::FuncRectLinear(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed,PStream &stream, FLOAT delta, int M,int relu_delta_final_decision)
+void Engine::FuncRectLinear(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed,PStream &stream, FLOAT delta, int M,int relu_delta_final_decision,
+        FLOAT *actMin, FLOAT *actMax)
 {
     verify(X.GetEngine() == this);
     verify(Y.GetEngine() == this);
@@ -1386,7 +1758,13 @@ void Engine::FuncRectLinear(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y
 #ifdef FRACTAL_USE_CUDA
     cudaKernels::FuncRectLinear(ptrX, ptrY, ptrY_fixed, Y.GetNumRows() * Y.GetNumCols(), stream.cudaStream, delta, M,relu_delta_final_decision);
 #else
-    verify(false); /* CPU computation is not supported */
+#if QUANT_RELU
+    const bool quantize = (relu_delta_final_decision == 1);
+#else
+    const bool quantize = false;
+#endif
+
+    hostAct::RectLinear<FLOAT>(ptrX, ptrY, ptrY_fixed, Y.GetNumRows() * Y.GetNumCols(), quantize, delta, M, actMin, actMax);
 #endif /* FRACTAL_USE_CUDA */
 
     Y.FinishWrite(stream);
@@ -1412,6 +1790,40 @@ void Engine::FuncRectLinear(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y
 /* IBM check end */
 
 
+void Engine::FuncStepLookup(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &_thresholds, Matrix<FLOAT> &_values,
+        Matrix<int> &_cells, const FLOAT lo, const FLOAT invStep, PStream &stream)
+{
+    verify(X.GetEngine() == this);
+    verify(Y.GetEngine() == this);
+    verify(_thresholds.GetEngine() == this);
+    verify(_values.GetEngine() == this);
+    verify(_cells.GetEngine() == this);
+    verify(X.GetNumRows() == Y.GetNumRows());
+    verify(X.GetNumCols() == Y.GetNumCols());
+    verify(_thresholds.GetNumRows() + 1 == _values.GetNumRows());
+    verify(_cells.GetNumRows() > 0);
+
+    FLOAT *ptrX, *ptrY, *ptrThresholds, *ptrValues;
+    int *ptrCells;
+
+    ptrX = X.GetPtrForReadWrite(stream);
+    ptrY = Y.GetPtrForWrite(stream);
+    ptrThresholds = _thresholds.GetPtrForReadWrite(stream);
+    ptrValues = _values.GetPtrForReadWrite(stream);
+    ptrCells = _cells.GetPtrForReadWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::FuncStepLookup(ptrX, ptrY, Y.GetNumRows() * Y.GetNumCols(), ptrThresholds, ptrValues, ptrCells,
+            _values.GetNumRows(), _cells.GetNumRows(), lo, invStep, stream.cudaStream);
+#else
+    hostAct::StepLookup<FLOAT>(ptrX, ptrY, Y.GetNumRows() * Y.GetNumCols(), ptrThresholds, ptrValues, ptrCells,
+            _values.GetNumRows(), _cells.GetNumRows(), lo, invStep);
+#endif /* FRACTAL_USE_CUDA */
+
+    Y.FinishWrite(stream);
+}
+
+
 void Engine::FuncSoftmax(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream)
 {
     verify(X.GetEngine() == this);
@@ -1553,12 +1965,14 @@ void Engine::GenerateDropoutMask(Matrix<FLOAT> &dropoutMask, const FLOAT dropout
     ptrMask = dropoutMask.GetPtrForWrite(stream);
 
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     unsigned long n;
     n = dropoutMask.GetNumRows() * dropoutMask.GetNumCols();
 
     verify(curandSetStream(curandGen, stream.cudaStream) == CURAND_STATUS_SUCCESS);
     verify(RANDU(curandGen, ptrMask, n) == CURAND_STATUS_SUCCESS);
     cudaKernels::GenerateDropoutMask<FLOAT>(ptrMask, ptrMask, n, dropoutRate, stream.cudaStream);
+    mtxHandle.unlock();
 #else
     verify(false); /* CPU computation is not supported */
 #endif /* FRACTAL_USE_CUDA */
@@ -1627,6 +2041,278 @@ void Engine::Rmsprop(Matrix<FLOAT> &newDerivs, Matrix<FLOAT> &derivs, Matrix<FLO
 }
 
 
+void Engine::FusedUpdate(std::vector<OptTensor> &tensors, PStream &stream)
+{
+    std::vector<hostOpt::UpdateTensor<FLOAT>> ptrs(tensors.size());
+    std::vector<OptTensor>::iterator iter, iter_end;
+    std::vector<hostOpt::UpdateTensor<FLOAT>>::iterator ptrIter;
+
+    ptrIter = ptrs.begin();
+    iter_end = tensors.end();
+    for(iter = tensors.begin(); iter != iter_end; ++iter, ++ptrIter)
+    {
+        const hostOpt::UpdateParam<FLOAT> &param = iter->param;
+        const unsigned long n = iter->weights->GetNumRows() * iter->weights->GetNumCols();
+        const unsigned long nBlock = (n + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK;
+
+        verify(iter->weights->GetEngine() == this);
+        verify(iter->derivs->GetEngine() == this);
+        verify(iter->derivs->GetNumRows() * iter->derivs->GetNumCols() == n);
+
+        ptrIter->n = n;
+        ptrIter->param = param;
+        ptrIter->weights = iter->weights->GetPtrForReadWrite(stream);
+        ptrIter->derivs = iter->derivs->GetPtrForReadWrite(stream);
+
+        if(iter->velsBf16 != NULL)
+        {
+            verify(iter->velsBf16->GetEngine() == this);
+            verify(iter->velsBf16->GetNumRows() * iter->velsBf16->GetNumCols() == n);
+            ptrIter->velsBf16 = iter->velsBf16->GetPtrForReadWrite(stream);
+        }
+        else
+        {
+            verify(iter->vels->GetEngine() == this);
+            verify(iter->vels->GetNumRows() * iter->vels->GetNumCols() == n);
+            ptrIter->vels = iter->vels->GetPtrForReadWrite(stream);
+        }
+
+        if(param.rule != hostOpt::UPDATE_NESTEROV)
+        {
+            if(iter->msDerivCode != NULL)
+            {
+                verify(iter->msDerivCode->GetEngine() == this && iter->msDerivScale->GetEngine() == this);
+                verify(iter->msDerivCode->GetNumRows() * iter->msDerivCode->GetNumCols() == n);
+                verify(iter->msDerivScale->GetNumRows() * iter->msDerivScale->GetNumCols() == nBlock);
+                ptrIter->msDerivCode = iter->msDerivCode->GetPtrForReadWrite(stream);
+                ptrIter->msDerivScale = iter->msDerivScale->GetPtrForReadWrite(stream);
+            }
+            else
+            {
+                verify(iter->msDeriv != NULL && iter->msDeriv->GetEngine() == this);
+                verify(iter->msDeriv->GetNumRows() * iter->msDeriv->GetNumCols() == n);
+                ptrIter->msDeriv = iter->msDeriv->GetPtrForReadWrite(stream);
+            }
+        }
+
+        if(param.rule == hostOpt::UPDATE_ADADELTA)
+        {
+            if(iter->msDeltaCode != NULL)
+            {
+                verify(iter->msDeltaCode->GetEngine() == this && iter->msDeltaScale->GetEngine() == this);
+                verify(iter->msDeltaCode->GetNumRows() * iter->msDeltaCode->GetNumCols() == n);
+                verify(iter->msDeltaScale->GetNumRows() * iter->msDeltaScale->GetNumCols() == nBlock);
+                ptrIter->msDeltaCode = iter->msDeltaCode->GetPtrForReadWrite(stream);
+                ptrIter->msDeltaScale = iter->msDeltaScale->GetPtrForReadWrite(stream);
+            }
+            else
+            {
+                verify(iter->msDelta != NULL && iter->msDelta->GetEngine() == this);
+                verify(iter->msDelta->GetNumRows() * iter->msDelta->GetNumCols() == n);
+                ptrIter->msDelta = iter->msDelta->GetPtrForReadWrite(stream);
+            }
+        }
+
+        if(param.quantM > 0)
+        {
+            verify(iter->weightsFixed != NULL && iter->weightsFixed->GetEngine() == this);
+            verify(iter->weightsFixed->GetNumRows() * iter->weightsFixed->GetNumCols() == n);
+            ptrIter->weightsFixed = iter->weightsFixed->GetPtrForWrite(stream);
+        }
+    }
+
+#ifdef FRACTAL_USE_CUDA
+    std::vector<hostOpt::UpdateTensor<FLOAT>>::const_iterator cudaIter, cudaIter_end;
+
+    cudaIter_end = ptrs.end();
+    for(cudaIter = ptrs.begin(); cudaIter != cudaIter_end; ++cudaIter)
+    {
+        if(cudaIter->n == 0) continue;
+
+        cudaKernels::FusedUpdate<FLOAT>(*cudaIter, stream.cudaStream);
+    }
+#else
+    hostOpt::FusedUpdate<FLOAT>(ptrs);
+#endif /* FRACTAL_USE_CUDA */
+
+    for(iter = tensors.begin(); iter != iter_end; ++iter)
+    {
+        iter->weights->FinishWrite(stream);
+
+        if(iter->velsBf16 != NULL)
+            iter->velsBf16->FinishWrite(stream);
+        else
+            iter->vels->FinishWrite(stream);
+
+        if(iter->param.rule != hostOpt::UPDATE_NESTEROV)
+        {
+            if(iter->msDerivCode != NULL)
+            {
+                iter->msDerivCode->FinishWrite(stream);
+                iter->msDerivScale->FinishWrite(stream);
+            }
+            else
+                iter->msDeriv->FinishWrite(stream);
+        }
+
+        if(iter->param.rule == hostOpt::UPDATE_ADADELTA)
+        {
+            if(iter->msDeltaCode != NULL)
+            {
+                iter->msDeltaCode->FinishWrite(stream);
+                iter->msDeltaScale->FinishWrite(stream);
+            }
+            else
+                iter->msDelta->FinishWrite(stream);
+        }
+
+        if(iter->param.quantM > 0)
+            iter->weightsFixed->FinishWrite(stream);
+    }
+}
+
+
+void Engine::Bf16Encode(Matrix<FLOAT> &X, Matrix<unsigned short> &Y, PStream &stream)
+{
+    verify(X.GetEngine() == this && Y.GetEngine() == this);
+    verify(X.GetNumRows() * X.GetNumCols() == Y.GetNumRows() * Y.GetNumCols());
+
+    const unsigned long n = X.GetNumRows() * X.GetNumCols();
+
+    if(n == 0) return;
+
+    FLOAT *_X = X.GetPtrForReadWrite(stream);
+    unsigned short *_Y = Y.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::Bf16Encode<FLOAT>(_X, _Y, n, stream.cudaStream);
+#else
+    hostOpt::Bf16Encode<FLOAT>(_X, _Y, n);
+#endif /* FRACTAL_USE_CUDA */
+
+    Y.FinishWrite(stream);
+}
+
+
+void Engine::Bf16Decode(Matrix<unsigned short> &X, Matrix<FLOAT> &Y, PStream &stream)
+{
+    verify(X.GetEngine() == this && Y.GetEngine() == this);
+    verify(X.GetNumRows() * X.GetNumCols() == Y.GetNumRows() * Y.GetNumCols());
+
+    const unsigned long n = X.GetNumRows() * X.GetNumCols();
+
+    if(n == 0) return;
+
+    unsigned short *_X = X.GetPtrForReadWrite(stream);
+    FLOAT *_Y = Y.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::Bf16Decode<FLOAT>(_X, _Y, n, stream.cudaStream);
+#else
+    hostOpt::Bf16Decode<FLOAT>(_X, _Y, n);
+#endif /* FRACTAL_USE_CUDA */
+
+    Y.FinishWrite(stream);
+}
+
+
+void Engine::StateQuantEncode(Matrix<FLOAT> &X, Matrix<unsigned char> &codes, Matrix<FLOAT> &scales, PStream &stream)
+{
+    verify(X.GetEngine() == this && codes.GetEngine() == this && scales.GetEngine() == this);
+
+    const unsigned long n = X.GetNumRows() * X.GetNumCols();
+
+    verify(codes.GetNumRows() * codes.GetNumCols() == n);
+    verify(scales.GetNumRows() * scales.GetNumCols() == (n + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK);
+
+    if(n == 0) return;
+
+    FLOAT *_X = X.GetPtrForReadWrite(stream);
+    unsigned char *_codes = codes.GetPtrForWrite(stream);
+    FLOAT *_scales = scales.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::StateQuantEncode<FLOAT>(_X, _codes, _scales, n, stream.cudaStream);
+#else
+    hostOpt::StateQuantEncode<FLOAT>(_X, _codes, _scales, n);
+#endif /* FRACTAL_USE_CUDA */
+
+    codes.FinishWrite(stream);
+    scales.FinishWrite(stream);
+}
+
+
+void Engine::StateQuantDecode(Matrix<unsigned char> &codes, Matrix<FLOAT> &scales, Matrix<FLOAT> &Y, PStream &stream)
+{
+    verify(codes.GetEngine() == this && scales.GetEngine() == this && Y.GetEngine() == this);
+
+    const unsigned long n = Y.GetNumRows() * Y.GetNumCols();
+
+    verify(codes.GetNumRows() * codes.GetNumCols() == n);
+    verify(scales.GetNumRows() * scales.GetNumCols() == (n + hostOpt::STATE_BLOCK - 1) / hostOpt::STATE_BLOCK);
+
+    if(n == 0) return;
+
+    unsigned char *_codes = codes.GetPtrForReadWrite(stream);
+    FLOAT *_scales = scales.GetPtrForReadWrite(stream);
+    FLOAT *_Y = Y.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::StateQuantDecode<FLOAT>(_codes, _scales, _Y, n, stream.cudaStream);
+#else
+    hostOpt::StateQuantDecode<FLOAT>(_codes, _scales, _Y, n);
+#endif /* FRACTAL_USE_CUDA */
+
+    Y.FinishWrite(stream);
+}
+
+
+void Engine::Dequant(Matrix<unsigned char> &X, Matrix<FLOAT> &table, Matrix<FLOAT> &Y, PStream &stream)
+{
+    verify(X.GetEngine() == this && table.GetEngine() == this && Y.GetEngine() == this);
+    verify(X.GetNumRows() == Y.GetNumRows() && X.GetNumCols() == Y.GetNumCols());
+    verify(table.GetNumRows() * table.GetNumCols() == 256);
+
+    const unsigned long n = Y.GetNumRows() * Y.GetNumCols();
+
+    if(n == 0) return;
+
+    unsigned char *_X = X.GetPtrForReadWrite(stream);
+    FLOAT *_table = table.GetPtrForReadWrite(stream);
+    FLOAT *_Y = Y.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::Dequant<FLOAT>(_X, _Y, n, _table, stream.cudaStream);
+#else
+    hostAct::Dequant<FLOAT>(_X, _Y, n, _table);
+#endif /* FRACTAL_USE_CUDA */
+
+    Y.FinishWrite(stream);
+}
+
+
+void Engine::HalfToFloat(Matrix<unsigned short> &X, Matrix<FLOAT> &Y, PStream &stream)
+{
+    verify(X.GetEngine() == this && Y.GetEngine() == this);
+    verify(X.GetNumRows() == Y.GetNumRows() && X.GetNumCols() == Y.GetNumCols());
+
+    const unsigned long n = Y.GetNumRows() * Y.GetNumCols();
+
+    if(n == 0) return;
+
+    unsigned short *_X = X.GetPtrForReadWrite(stream);
+    FLOAT *_Y = Y.GetPtrForWrite(stream);
+
+#ifdef FRACTAL_USE_CUDA
+    cudaKernels::HalfToFloat<FLOAT>(_X, _Y, n, stream.cudaStream);
+#else
+    hostAct::HalfToFloat<FLOAT>(_X, _Y, n);
+#endif /* FRACTAL_USE_CUDA */
+
+    Y.FinishWrite(stream);
+}
+
+
 void Engine::EventCreate(PEvent &event, const unsigned long loc)
 {
     mtxEvent.lock();
@@ -1778,11 +2464,23 @@ void Engine::StreamSynchronize(PStream &stream)
 void Engine::SetRandomSeed(unsigned long long seed)
 {
 #ifdef FRACTAL_USE_CUDA
+    mtxHandle.lock();
     verify(curandSetPseudoRandomGeneratorSeed(curandGen, seed) == CURAND_STATUS_SUCCESS);
+    mtxHandle.unlock();
 #else
     verify(false);
 #endif /* FRACTAL_USE_CUDA */
 }
 
+
+void Engine::SetConvPlanCache(const std::string &filename)
+{
+#ifdef FRACTAL_USE_CUDA
+    /* cuDNN selects the algorithm by itself */
+#else
+    hostConvPlanner.SetCacheFile(filename);
+#endif /* FRACTAL_USE_CUDA */
+}
+
 }
 
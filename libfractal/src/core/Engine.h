@@ -21,6 +21,8 @@
 #define FRACTAL_USE_CUDA /* For now, always use CUDA */
 
 #include <mutex>
+#include <string>
+#include <vector>
 
 #ifdef FRACTAL_USE_CUDA
 
@@ -29,10 +31,16 @@
 #include <curand.h>
 #include <cudnn.h>
 
+#else /* FRACTAL_USE_CUDA */
+
+#include "ConvPlanner.h"
+#include "HostAct.h"
+
 #endif /* FRACTAL_USE_CUDA */
 
 #include "Matrix.h"
 #include "Mem.h"
+#include "HostOpt.h"
 #include "FractalCommon.h"
 
 
@@ -41,6 +49,10 @@
 namespace fractal
 {
 
+/* Window and stride of CONN_POOL and CONN_POOL_AVG (see Engine::MaxPoolForward) */
+const long POOL_WINDOW = 3;
+const long POOL_STRIDE = 2;
+
 
 class PEvent
 {
@@ -78,6 +90,25 @@ public:
 };
 
 
+/* One tensor of Engine::FusedUpdate(); msDeriv, msDelta and weightsFixed are NULL when unused.
+ * The compact state (velsBf16, msDerivCode + msDerivScale, msDeltaCode + msDeltaScale) replaces
+ * vels, msDeriv and msDelta when not NULL. */
+class OptTensor
+{
+public:
+    OptTensor() : weights(NULL), vels(NULL), derivs(NULL), msDeriv(NULL), msDelta(NULL), weightsFixed(NULL),
+        velsBf16(NULL), msDerivCode(NULL), msDeltaCode(NULL), msDerivScale(NULL), msDeltaScale(NULL) {}
+
+    Matrix<FLOAT> *weights, *vels, *derivs;
+    Matrix<FLOAT> *msDeriv, *msDelta;
+    Matrix<FLOAT> *weightsFixed;
+    Matrix<unsigned short> *velsBf16;
+    Matrix<unsigned char> *msDerivCode, *msDeltaCode;
+    Matrix<FLOAT> *msDerivScale, *msDeltaScale;
+    hostOpt::UpdateParam<FLOAT> param;
+};
+
+
 class Engine
 {
 public:
@@ -114,6 +145,12 @@ public:
     /* C = A + B */
     void MatAdd(Matrix<FLOAT> &A, Matrix<FLOAT> &B, Matrix<FLOAT> &C, PStream &stream);
 
+    /* C = A + b * ones(1, n) (b is a column vector broadcast over the columns) */
+    void MatAddBias(Matrix<FLOAT> &A, Matrix<FLOAT> &b, Matrix<FLOAT> &C, PStream &stream);
+
+    /* y = alpha * A * ones(n, 1) + beta * y */
+    void MatRowSum(Matrix<FLOAT> &A, Matrix<FLOAT> &y, const FLOAT alpha, const FLOAT beta, PStream &stream);
+
     void MatSet(Matrix<FLOAT> &mat, const FLOAT val, PStream &stream);
     void MatRandN(Matrix<FLOAT> &mat, const FLOAT mean, const FLOAT stdev, PStream &stream);
 
@@ -123,13 +160,22 @@ public:
     /* B = tr(A) */
     void MatTranspose(Matrix<FLOAT> &A, Matrix<FLOAT> &B, PStream &stream);
 
-    /* Y = f(X) */
-    void FuncSigmoid(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed, PStream &stream,FLOAT delta);
-    void FuncTanh(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream,FLOAT delta);
+    /* Y = f(X); without CUDA, [*actMin, *actMax] (if not NULL) is widened to the range of the
+       unquantized activation in the same pass */
+    void FuncSigmoid(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed, PStream &stream,FLOAT delta,
+            FLOAT *actMin = NULL, FLOAT *actMax = NULL);
+    void FuncTanh(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream,FLOAT delta,
+            FLOAT *actMin = NULL, FLOAT *actMax = NULL);
     void WeightQuant(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream,FLOAT delta,int M);
     void FuncSoftplus(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream);
-    void FuncRectLinear(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed, PStream &stream, FLOAT delta, int M,int relu_delta_final_decision);
+    void FuncRectLinear(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &Y_fixed, PStream &stream, FLOAT delta, int M,int relu_delta_final_decision,
+            FLOAT *actMin = NULL, FLOAT *actMax = NULL);
     void FuncSoftmax(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, PStream &stream);
+
+    /* Y = quantized activation of X from a step table (see hostAct::StepTable): one row per code of
+       _values, one row per code boundary of _thresholds and one row per cell of _cells */
+    void FuncStepLookup(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, Matrix<FLOAT> &_thresholds, Matrix<FLOAT> &_values,
+            Matrix<int> &_cells, const FLOAT lo, const FLOAT invStep, PStream &stream);
     void FuncBoundRange(Matrix<FLOAT> &X, Matrix<FLOAT> &Y, const FLOAT min, const FLOAT max, PStream &stream);
 
     /* Y = f'(Z) where X = f(Z) */
@@ -143,6 +189,20 @@ public:
 
     void Adadelta(Matrix<FLOAT> &deltas, Matrix<FLOAT> &derivs, Matrix<FLOAT> &msDeriv, Matrix<FLOAT> &msDelta, const FLOAT learningRate, const FLOAT decayRate, PStream &stream);
 
+    /* Nesterov momentum (+ Rmsprop or Adadelta) + weight requantization of all tensors in one pass
+       (see hostOpt::UpdateParam); one kernel per tensor with CUDA, one parallel sweep without */
+    void FusedUpdate(std::vector<OptTensor> &tensors, PStream &stream);
+
+    /* Compact optimizer state: Y = bfloat16 of X; codes and one scale per hostOpt::STATE_BLOCK elements of X >= 0 */
+    void Bf16Encode(Matrix<FLOAT> &X, Matrix<unsigned short> &Y, PStream &stream);
+    void Bf16Decode(Matrix<unsigned short> &X, Matrix<FLOAT> &Y, PStream &stream);
+    void StateQuantEncode(Matrix<FLOAT> &X, Matrix<unsigned char> &codes, Matrix<FLOAT> &scales, PStream &stream);
+    void StateQuantDecode(Matrix<unsigned char> &codes, Matrix<FLOAT> &scales, Matrix<FLOAT> &Y, PStream &stream);
+
+    /* Compact input channels: Y = table[X] (256 x 1 table); Y = X in IEEE half precision */
+    void Dequant(Matrix<unsigned char> &X, Matrix<FLOAT> &table, Matrix<FLOAT> &Y, PStream &stream);
+    void HalfToFloat(Matrix<unsigned short> &X, Matrix<FLOAT> &Y, PStream &stream);
+
     void EventCreate(PEvent &event, const unsigned long loc);
     void EventDestroy(PEvent &event);
     void EventRecord(PEvent &event, PStream &stream);
@@ -154,8 +214,19 @@ public:
     void StreamSynchronize(PStream &stream);
 
     void SetRandomSeed(unsigned long long seed);
+
+    /* File of the host convolution plans (kept per CPU model); unused with CUDA */
+    void SetConvPlanCache(const std::string &filename);
+
     void ConvForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLayerState, Matrix<FLOAT> &_weight, long kernelDimX, long kernelDimY, long prevLayerDimX, long prevLayerDimY, long prevLayerNumMaps, long nextLayerDimX, long nextLayerDimY, long nextLayerNumMaps, long curBatchSize,PStream &stream);
 
+    /* Inference: _nextLayerState = maxpool(rectlinear(conv(_prevLayerAct, _weight) + _biases)) without storing the
+       convolution output; _biases can be NULL. The activation matches FuncRectLinear(). */
+    void ConvActPoolForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_weight, Matrix<FLOAT> *_biases, Matrix<FLOAT> &_nextLayerState,
+            long kernelDimX, long kernelDimY, long prevLayerDimX, long prevLayerDimY, long prevLayerNumMaps,
+            long convLayerDimX, long convLayerDimY, long convLayerNumMaps, long nextLayerDimX, long nextLayerDimY,
+            long poolWindow, long poolStride, long curBatchSize, PStream &stream, FLOAT delta, int M, int relu_delta_final_decision);
+
     void ConvBackward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_prevLayerErr, Matrix<FLOAT> &_nextLayerErr, Matrix<FLOAT> &_weight, Matrix<FLOAT> &_deriv, long kernelDimX, long kernelDimY, long prevLayerDimX, long prevLayerDimY, long  prevLayerNumMaps, long nextLayerDimX, long nextLayerDimY, long nextLayerNumMaps, bool performBackwardProp, long curBatchSize,PStream &stream );
 
     void ConvBiasForward(Matrix<FLOAT> &_nextLayerState, Matrix<FLOAT> &_biases, long nextLayerDimY, long nextLayerDimX, long nextLayerNumMaps, long curBatchSize, PStream &stream);
@@ -171,6 +242,16 @@ public:
             long prevLayerDimX, long prevLayerDimY, long prevLayerNumMaps,
             long nextLayerDimX, long nextLayerDimY, long nextLayerNumMaps,
             long curBatchSize, PStream &stream, long max_avg);
+
+    /* Max pooling that records the offset of the maximum within each window in _argmax (one byte per output),
+       so that the backward pass is a scatter that needs neither the pooling input nor its output */
+    void MaxPoolArgmaxForward(Matrix<FLOAT> &_prevLayerAct, Matrix<FLOAT> &_nextLayerState, Matrix<unsigned char> &_argmax,
+            long prevLayerDimX, long prevLayerDimY, long nextLayerDimX, long nextLayerDimY, long numMaps,
+            long poolWindow, long poolStride, long curBatchSize, PStream &stream);
+
+    void MaxPoolArgmaxBackward(Matrix<FLOAT> &_nextLayerErr, Matrix<unsigned char> &_argmax, Matrix<FLOAT> &_prevLayerErr,
+            long prevLayerDimX, long prevLayerDimY, long nextLayerDimX, long nextLayerDimY, long numMaps,
+            long poolWindow, long poolStride, long curBatchSize, PStream &stream);
 #if QUANT_RETRAIN
 	FLOAT delta_relu; 
 	FLOAT delta_relu_pre;
@@ -195,6 +276,7 @@ protected:
     std::recursive_mutex mtxMem;
     std::mutex mtxStream;
     std::mutex mtxEvent;
+    std::mutex mtxHandle; /* cuBLAS/cuDNN/cuRAND handles and cuDNN descriptors, shared by all PStreams */
 
     int first_data;
 #ifdef FRACTAL_USE_CUDA
@@ -211,6 +293,14 @@ protected:
 
     void createHandles();
     void destroyHandles();
+#else
+    /* Winograd-transformed weights of the host convolution */
+    hostConv::FilterCache<FLOAT> hostFilterCache;
+
+    /* Forward algorithm of each convolution shape, and the workspace reused across the calls */
+    hostConv::ConvPlanner hostConvPlanner;
+    std::vector<FLOAT> hostConvWorkspace;
+    std::mutex mtxHostConv;
 #endif /* FRACTAL_USE_CUDA */
 };
 
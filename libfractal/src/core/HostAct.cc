@@ -0,0 +1,524 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "HostAct.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+
+/* Elements per block; the intermediate exp() values of a block stay in L1 */
+#define ACT_BLOCK 512
+
+/* Smaller inputs are not worth the threads */
+#define ACT_PARALLEL_MIN 65536
+
+/* Upper bound of the cells of a step table; beyond it, a lookup may take more comparisons */
+#define STEP_MAX_CELLS 65536
+
+
+namespace fractal
+{
+
+namespace hostAct
+{
+
+/* expf(x) = 2^k * exp(r), where k = round(x / ln(2)) and |r| <= ln(2) / 2 (Cephes coefficients) */
+#define EXP_MIN -87.0f
+#define EXP_MAX 87.0f
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_LN2_HI 0.693359375f
+#define EXP_LN2_LO -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+
+static inline float ExpScalar(float x)
+{
+	float k, r, p;
+
+	x = std::min(std::max(x, EXP_MIN), EXP_MAX);
+	k = std::floor(x * EXP_LOG2E + 0.5f);
+	r = x - k * EXP_LN2_HI - k * EXP_LN2_LO;
+
+	p = EXP_P0;
+	p = p * r + EXP_P1;
+	p = p * r + EXP_P2;
+	p = p * r + EXP_P3;
+	p = p * r + EXP_P4;
+	p = p * r + EXP_P5;
+
+	return std::ldexp(p * r * r + r + 1.0f, (int) k);
+}
+
+
+#if defined(__AVX512F__)
+/* The maskz forms with a full mask are used because the plain min, max,
+   roundscale, cvtps and slli intrinsics pass an undefined source vector,
+   which GCC reports under -Wmaybe-uninitialized once they are inlined */
+#define EXP_MASK ((__mmask16) 0xFFFF)
+
+static inline __m512 Exp16(__m512 x)
+{
+	__m512 k, r, p;
+	__m512i e;
+
+	x = _mm512_maskz_min_ps(EXP_MASK, _mm512_maskz_max_ps(EXP_MASK, x, _mm512_set1_ps(EXP_MIN)), _mm512_set1_ps(EXP_MAX));
+	k = _mm512_maskz_roundscale_ps(EXP_MASK, _mm512_mul_ps(x, _mm512_set1_ps(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	r = _mm512_fnmadd_ps(k, _mm512_set1_ps(EXP_LN2_HI), x);
+	r = _mm512_fnmadd_ps(k, _mm512_set1_ps(EXP_LN2_LO), r);
+
+	p = _mm512_set1_ps(EXP_P0);
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P1));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P3));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P4));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P5));
+	p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+
+	/* 2^k from the exponent bits; k is in [-126, 126] after the clamp */
+	e = _mm512_maskz_slli_epi32(EXP_MASK, _mm512_add_epi32(_mm512_maskz_cvtps_epi32(EXP_MASK, k), _mm512_set1_epi32(127)), 23);
+
+	return _mm512_mul_ps(p, _mm512_castsi512_ps(e));
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+static inline __m256 Exp8(__m256 x)
+{
+	__m256 k, r, p;
+	__m256i e;
+
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)), _mm256_set1_ps(EXP_MAX));
+	k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	r = _mm256_fnmadd_ps(k, _mm256_set1_ps(EXP_LN2_HI), x);
+	r = _mm256_fnmadd_ps(k, _mm256_set1_ps(EXP_LN2_LO), r);
+
+	p = _mm256_set1_ps(EXP_P0);
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P1));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P3));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P4));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P5));
+	p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+	e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+#endif
+
+
+/* y = exp(scale * x) for one block */
+static inline void ExpBlock(const float *x, float *y, const long n, const float scale)
+{
+	long i = 0;
+
+#if defined(__AVX512F__)
+	for(; i + 16 <= n; i += 16)
+	{
+		_mm512_storeu_ps(y + i, Exp16(_mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_set1_ps(scale))));
+	}
+#elif defined(__AVX2__) && defined(__FMA__)
+	for(; i + 8 <= n; i += 8)
+	{
+		_mm256_storeu_ps(y + i, Exp8(_mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_set1_ps(scale))));
+	}
+#endif
+
+	for(; i < n; i++)
+	{
+		y[i] = ExpScalar(scale * x[i]);
+	}
+}
+
+
+static inline void ExpBlock(const double *x, double *y, const long n, const double scale)
+{
+	long i;
+
+	for(i = 0; i < n; i++)
+	{
+		y[i] = std::exp(scale * x[i]);
+	}
+}
+
+
+/* Widen [*actMin, *actMax] to [lo, hi] */
+template<class T>
+static inline void UpdateRange(const T lo, const T hi, T *actMin, T *actMax)
+{
+	if(actMin != NULL) *actMin = std::min(*actMin, lo);
+	if(actMax != NULL) *actMax = std::max(*actMax, hi);
+}
+
+
+template<class T>
+void Exp(const T *x, T *y, const unsigned long n)
+{
+	const long nBlock = ((long) n + ACT_BLOCK - 1) / ACT_BLOCK;
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long b = 0; b < nBlock; b++)
+	{
+		const long from = b * ACT_BLOCK;
+
+		ExpBlock(x + from, y + from, std::min((long) n - from, (long) ACT_BLOCK), (T) 1);
+	}
+}
+
+
+template<class T>
+void Sigmoid(const T *x, T *y, T *yFixed, const unsigned long n,
+		const bool quantize, const T delta, T *actMin, T *actMax)
+{
+	const long nBlock = ((long) n + ACT_BLOCK - 1) / ACT_BLOCK;
+	T lo = std::numeric_limits<T>::max();
+	T hi = -std::numeric_limits<T>::max();
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for reduction(min:lo) reduction(max:hi) if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long b = 0; b < nBlock; b++)
+	{
+		const long from = b * ACT_BLOCK;
+		const long len = std::min((long) n - from, (long) ACT_BLOCK);
+		T e[ACT_BLOCK];
+		long i;
+
+		ExpBlock(x + from, e, len, (T) -1);
+
+		for(i = 0; i < len; i++)
+		{
+			const T a = (T) 1 / ((T) 1 + e[i]);
+
+			yFixed[from + i] = a;
+			y[from + i] = quantize == true ? (T) std::floor(std::fabs(a) / delta + (T) 0.5) * delta : a;
+
+			lo = std::min(lo, a);
+			hi = std::max(hi, a);
+		}
+	}
+
+	if(n > 0) UpdateRange(lo, hi, actMin, actMax);
+}
+
+
+template<class T>
+void Tanh(const T *x, T *y, const unsigned long n,
+		const bool quantize, const T delta, T *actMin, T *actMax)
+{
+	const long nBlock = ((long) n + ACT_BLOCK - 1) / ACT_BLOCK;
+	T lo = std::numeric_limits<T>::max();
+	T hi = -std::numeric_limits<T>::max();
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for reduction(min:lo) reduction(max:hi) if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long b = 0; b < nBlock; b++)
+	{
+		const long from = b * ACT_BLOCK;
+		const long len = std::min((long) n - from, (long) ACT_BLOCK);
+		T e[ACT_BLOCK];
+		long i;
+
+		ExpBlock(x + from, e, len, (T) -2);
+
+		for(i = 0; i < len; i++)
+		{
+			const T a = (T) 2 / ((T) 1 + e[i]) - (T) 1;
+			T q = a;
+
+			/* Symmetric quantization, bounded by 1 (as FuncTanhKernel) */
+			if(quantize == true)
+			{
+				q = std::min((T) std::floor(std::fabs(a) / delta + (T) 0.5), (T) 1 / delta) * delta;
+				if(std::signbit(a)) q = -q;
+			}
+
+			y[from + i] = q;
+
+			lo = std::min(lo, a);
+			hi = std::max(hi, a);
+		}
+	}
+
+	if(n > 0) UpdateRange(lo, hi, actMin, actMax);
+}
+
+
+template<class T>
+void RectLinear(const T *x, T *y, T *yFixed, const unsigned long n,
+		const bool quantize, const T delta, const long M, T *actMin, T *actMax)
+{
+	const long nBlock = ((long) n + ACT_BLOCK - 1) / ACT_BLOCK;
+	T lo = std::numeric_limits<T>::max();
+	T hi = -std::numeric_limits<T>::max();
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for reduction(min:lo) reduction(max:hi) if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long b = 0; b < nBlock; b++)
+	{
+		const long from = b * ACT_BLOCK;
+		const long len = std::min((long) n - from, (long) ACT_BLOCK);
+		long i;
+
+		for(i = 0; i < len; i++)
+		{
+			/* Leaky */
+			const T a = std::max((T) 0.01 * x[from + i], x[from + i]);
+
+			yFixed[from + i] = a;
+			y[from + i] = quantize == true ? std::min((T) std::floor(a / delta + (T) 0.5), (T) (M - 1)) * delta : a;
+
+			lo = std::min(lo, a);
+			hi = std::max(hi, a);
+		}
+	}
+
+	if(n > 0) UpdateRange(lo, hi, actMin, actMax);
+}
+
+
+template<class T>
+void StepTable<T>::BuildSigmoid(const T delta)
+{
+	verify(delta > (T) 0 && delta <= (T) 1);
+
+	Clear();
+
+	/* code k = floor(sigmoid(x) / delta + 0.5) from sigmoid(x) >= (k - 0.5) * delta */
+	values.push_back((T) 0);
+	for(long k = 1; ; k++)
+	{
+		const double p = ((double) k - 0.5) * delta;
+
+		if(p >= 1.0) break;
+
+		thresholds.push_back((T) std::log(p / (1.0 - p)));
+		values.push_back((T) k * delta);
+	}
+
+	this->delta = delta;
+
+	BuildCells();
+}
+
+
+template<class T>
+void StepTable<T>::BuildTanh(const T delta)
+{
+	verify(delta > (T) 0 && delta <= (T) 1);
+
+	std::vector<T> thr, val;
+
+	Clear();
+
+	/* Magnitude m = min(floor(|tanh(x)| / delta + 0.5), 1 / delta) from |tanh(x)| >= (m - 0.5) * delta */
+	for(long m = 1; ; m++)
+	{
+		const double p = ((double) m - 0.5) * delta;
+
+		if(p >= 1.0) break;
+
+		thr.push_back((T) (0.5 * std::log((1.0 + p) / (1.0 - p))));
+		val.push_back(std::min((T) m, (T) 1 / delta) * delta);
+	}
+
+	/* Odd function: the negative codes mirror the positive ones */
+	for(long i = (long) thr.size() - 1; i >= 0; i--)
+	{
+		thresholds.push_back(-thr[i]);
+		values.push_back(-val[i]);
+	}
+
+	values.push_back((T) 0);
+
+	for(long i = 0; i < (long) thr.size(); i++)
+	{
+		thresholds.push_back(thr[i]);
+		values.push_back(val[i]);
+	}
+
+	this->delta = delta;
+
+	BuildCells();
+}
+
+
+template<class T>
+void StepTable<T>::Clear()
+{
+	delta = lo = invStep = (T) 0;
+
+	thresholds.clear();
+	values.clear();
+	cells.clear();
+}
+
+
+template<class T>
+void StepTable<T>::BuildCells()
+{
+	verify(thresholds.empty() == false);
+	verify(values.size() == thresholds.size() + 1);
+
+	const T hi = thresholds.back();
+	T step = (T) 1;
+	long nCell, i;
+
+	lo = thresholds.front();
+
+	for(i = 1; i < (long) thresholds.size(); i++)
+	{
+		step = std::min(step, thresholds[i] - thresholds[i - 1]);
+	}
+
+	nCell = (long) std::ceil((hi - lo) / step) + 1;
+
+	if(nCell > STEP_MAX_CELLS)
+	{
+		nCell = STEP_MAX_CELLS;
+		step = (hi - lo) / (T) (nCell - 1);
+	}
+
+	invStep = (T) 1 / step;
+
+	/* Number of thresholds not greater than the start of the cell */
+	cells.resize(nCell);
+	for(i = 0; i < nCell; i++)
+	{
+		cells[i] = (int) (std::upper_bound(thresholds.begin(), thresholds.end(), lo + (T) i * step) - thresholds.begin());
+	}
+}
+
+
+template<class T>
+void StepLookup(const T *x, T *y, const unsigned long n, const T *thresholds, const T *values, const int *cells,
+		const long nCode, const long nCell, const T lo, const T invStep)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long i = 0; i < (long) n; i++)
+	{
+		const T v = x[i];
+		long code = 0;
+
+		/* Also catches NaN */
+		if(v >= lo)
+		{
+			code = cells[std::min((long) ((v - lo) * invStep), nCell - 1)];
+
+			/* The cell index is rounded, so the code can be off by one in either direction */
+			while(code < nCode - 1 && v >= thresholds[code]) code++;
+			while(code > 0 && v < thresholds[code - 1]) code--;
+		}
+
+		y[i] = values[code];
+	}
+}
+
+
+template<class T>
+void Dequant(const unsigned char *x, T *y, const unsigned long n, const T *table)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long i = 0; i < (long) n; i++)
+		y[i] = table[x[i]];
+}
+
+
+template<class T>
+void HalfToFloat(const unsigned short *x, T *y, const unsigned long n)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= ACT_PARALLEL_MIN)
+#endif
+	for(long i = 0; i < (long) n; i++)
+	{
+		const uint32_t sign = (uint32_t) (x[i] & 0x8000) << 16;
+		const uint32_t exponent = (x[i] >> 10) & 0x1f;
+		const uint32_t mantissa = x[i] & 0x3ff;
+		uint32_t u;
+		float f;
+
+		if(exponent == 0)
+		{
+			/* Zero or subnormal: mantissa * 2^-24 is exact */
+			f = (float) mantissa * 5.9604644775390625e-8f;
+			y[i] = (T) ((sign != 0) ? -f : f);
+			continue;
+		}
+
+		u = sign | (mantissa << 13) | ((exponent == 31) ? 0x7f800000u : (exponent + 112) << 23);
+		memcpy(&f, &u, sizeof(float));
+		y[i] = (T) f;
+	}
+}
+
+
+template void Exp<float>(const float *x, float *y, const unsigned long n);
+template void Exp<double>(const double *x, double *y, const unsigned long n);
+
+template void Sigmoid<float>(const float *x, float *y, float *yFixed, const unsigned long n,
+		const bool quantize, const float delta, float *actMin, float *actMax);
+template void Sigmoid<double>(const double *x, double *y, double *yFixed, const unsigned long n,
+		const bool quantize, const double delta, double *actMin, double *actMax);
+
+template void Tanh<float>(const float *x, float *y, const unsigned long n,
+		const bool quantize, const float delta, float *actMin, float *actMax);
+template void Tanh<double>(const double *x, double *y, const unsigned long n,
+		const bool quantize, const double delta, double *actMin, double *actMax);
+
+template void RectLinear<float>(const float *x, float *y, float *yFixed, const unsigned long n,
+		const bool quantize, const float delta, const long M, float *actMin, float *actMax);
+template void RectLinear<double>(const double *x, double *y, double *yFixed, const unsigned long n,
+		const bool quantize, const double delta, const long M, double *actMin, double *actMax);
+
+template class StepTable<float>;
+template class StepTable<double>;
+
+template void StepLookup<float>(const float *x, float *y, const unsigned long n, const float *thresholds, const float *values, const int *cells,
+		const long nCode, const long nCell, const float lo, const float invStep);
+template void StepLookup<double>(const double *x, double *y, const unsigned long n, const double *thresholds, const double *values, const int *cells,
+		const long nCode, const long nCell, const double lo, const double invStep);
+
+template void Dequant<float>(const unsigned char *x, float *y, const unsigned long n, const float *table);
+template void Dequant<double>(const unsigned char *x, double *y, const unsigned long n, const double *table);
+
+template void HalfToFloat<float>(const unsigned short *x, float *y, const unsigned long n);
+template void HalfToFloat<double>(const unsigned short *x, double *y, const unsigned long n);
+
+}
+
+}
+
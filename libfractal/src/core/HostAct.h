@@ -0,0 +1,111 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_HOSTACT_H_
+#define FRACTAL_HOSTACT_H_
+
+#include <vector>
+
+#include "FractalCommon.h"
+
+
+namespace fractal
+{
+
+namespace hostAct
+{
+
+/* Host implementation of the activation kernels of CudaKernels.cu. Each function writes the
+ * activation and its quantized version in one pass, and widens [*actMin, *actMax] to the range
+ * of the unquantized activation (calibration of the quantization step); actMin and actMax may
+ * be NULL.
+ *
+ * In single precision, exp() is a degree-5 polynomial after the reduction by ln(2), evaluated
+ * with AVX-512 or AVX2 + FMA when the compiler targets them. Its relative error is below 2e-7
+ * for inputs in [-87, 87] (the input is clamped to this range). Double precision uses std::exp(). */
+
+/* y = exp(x) */
+template<class T>
+void Exp(const T *x, T *y, const unsigned long n);
+
+/* yFixed = sigmoid(x); y = quantized yFixed if quantize is true, yFixed otherwise */
+template<class T>
+void Sigmoid(const T *x, T *y, T *yFixed, const unsigned long n,
+		const bool quantize, const T delta, T *actMin, T *actMax);
+
+/* y = tanh(x), quantized in place if quantize is true */
+template<class T>
+void Tanh(const T *x, T *y, const unsigned long n,
+		const bool quantize, const T delta, T *actMin, T *actMax);
+
+/* yFixed = leaky rectifier of x; y = min(round(yFixed / delta), M - 1) * delta if quantize is true */
+template<class T>
+void RectLinear(const T *x, T *y, T *yFixed, const unsigned long n,
+		const bool quantize, const T delta, const long M, T *actMin, T *actMax);
+
+
+/* Quantized activation as a step function of the state (inference with signal quantization).
+ * Code k covers [thresholds[k - 1], thresholds[k]) and produces values[k]. A uniform grid of
+ * cells over the thresholds, no wider than the smallest step, gives the code of the start of
+ * the cell, so that a lookup is a gather and one or two comparisons. */
+template<class T>
+class StepTable
+{
+public:
+	StepTable() : delta((T) 0), lo((T) 0), invStep((T) 0) {}
+
+	/* Same quantization as Sigmoid() and Tanh() */
+	void BuildSigmoid(const T delta);
+	void BuildTanh(const T delta);
+	void Clear();
+
+	inline const bool IsEmpty() const { return values.empty(); }
+	inline const T GetDelta() const { return delta; }
+	inline const T GetLo() const { return lo; }
+	inline const T GetInvStep() const { return invStep; }
+	inline const std::vector<T> &GetThresholds() const { return thresholds; }
+	inline const std::vector<T> &GetValues() const { return values; }
+	inline const std::vector<int> &GetCells() const { return cells; }
+
+protected:
+	void BuildCells();
+
+	T delta;
+	T lo, invStep;
+	std::vector<T> thresholds, values;
+	std::vector<int> cells;
+};
+
+/* y = values[code of x]; nCode = number of values, nCell = number of cells */
+template<class T>
+void StepLookup(const T *x, T *y, const unsigned long n, const T *thresholds, const T *values, const int *cells,
+		const long nCode, const long nCell, const T lo, const T invStep);
+
+
+/* Compact input channels: y = table[x] with 256 entries; y = x in IEEE half precision */
+template<class T>
+void Dequant(const unsigned char *x, T *y, const unsigned long n, const T *table);
+
+template<class T>
+void HalfToFloat(const unsigned short *x, T *y, const unsigned long n);
+
+}
+
+}
+
+#endif /* FRACTAL_HOSTACT_H_ */
+
@@ -0,0 +1,1459 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "HostConv.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <complex>
+
+#ifdef FRACTAL_USE_OMP
+#include <omp.h>
+#endif
+
+
+/* Cache blocking of the host GEMM */
+#define GEMM_BLOCK_K 128
+#define GEMM_BLOCK_N 512
+
+/* Use the direct path when the reduction per output is small */
+#define DIRECT_MAX_REDUCTION 128
+
+/* The Winograd transforms are amortized over the input and output maps */
+#define WINOGRAD_MIN_MAPS 4
+
+
+namespace fractal
+{
+
+namespace hostConv
+{
+
+/* The workspace is split into one slice per thread */
+static inline const long GetMaxThreads()
+{
+#ifdef FRACTAL_USE_OMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+
+static inline const long GetThreadIdx()
+{
+#ifdef FRACTAL_USE_OMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+
+static inline const long GetWinogradTileCount(const ConvShape &shape)
+{
+	const long m = WINOGRAD_TILE - shape.kernelDimX + 1;
+
+	return ((shape.outDimX + m - 1) / m) * ((shape.outDimY + m - 1) / m);
+}
+
+
+/* Smallest power of two that is not less than n */
+static inline const long GetFftDim(const long n)
+{
+	long dim = 1;
+
+	while(dim < n) dim <<= 1;
+
+	return dim;
+}
+
+
+static const ConvAlgo SelectBackwardAlgo(const ConvShape &shape)
+{
+	/* Small kernels on few input maps (e.g. the first layer) do not amortize the im2col copy */
+	if(shape.kernelDimX <= DIRECT_MAX_KERNEL && shape.GetKernelSize() <= DIRECT_MAX_REDUCTION)
+		return CONV_ALGO_DIRECT;
+
+	return CONV_ALGO_IM2COL;
+}
+
+
+const bool ConvShape::IsValid() const
+{
+	return batchSize > 0 && inMaps > 0 && outMaps > 0
+		&& kernelDimX > 0 && kernelDimY > 0
+		&& outDimX == inDimX - kernelDimX + 1
+		&& outDimY == inDimY - kernelDimY + 1;
+}
+
+
+const bool PoolShape::IsValid() const
+{
+	/* The argmax offsets are stored in 8 bits */
+	return batchSize > 0 && nMaps > 0 && window > 0 && stride > 0 && window * window <= 256
+		&& outDimX == (inDimX - window) / stride + 1
+		&& outDimY == (inDimY - window) / stride + 1;
+}
+
+
+const ConvAlgo SelectAlgo(const ConvShape &shape)
+{
+	if(IsWinogradSupported(shape) == true
+			&& shape.inMaps >= WINOGRAD_MIN_MAPS && shape.outMaps >= WINOGRAD_MIN_MAPS)
+		return CONV_ALGO_WINOGRAD;
+
+	return SelectBackwardAlgo(shape);
+}
+
+
+template<class T>
+void Gemm(const bool transA, const bool transB, const long m, const long n, const long k,
+		const T alpha, const T *A, const T *B, const T beta, T *C)
+{
+	long i, j, p, p0, j0, pEnd, jEnd;
+
+	/* C = beta * C */
+	for(i = 0; i < m * n; i++)
+	{
+		C[i] = beta == (T) 0 ? (T) 0 : beta * C[i];
+	}
+
+	if(transB == false)
+	{
+		/* Rows of B are contiguous: C(i, :) += A(i, p) * B(p, :) */
+		for(p0 = 0; p0 < k; p0 += GEMM_BLOCK_K)
+		{
+			pEnd = std::min(p0 + GEMM_BLOCK_K, k);
+
+			for(j0 = 0; j0 < n; j0 += GEMM_BLOCK_N)
+			{
+				jEnd = std::min(j0 + GEMM_BLOCK_N, n);
+
+				for(i = 0; i < m; i++)
+				{
+					T *c = C + i * n;
+
+					for(p = p0; p < pEnd; p++)
+					{
+						const T a = alpha * (transA == false ? A[i * k + p] : A[p * m + i]);
+						const T *b = B + p * n;
+
+						for(j = j0; j < jEnd; j++)
+						{
+							c[j] += a * b[j];
+						}
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		/* Columns of op(B) are contiguous: C(i, j) += dot(A(i, :), B(j, :)) */
+		std::vector<T> a(k);
+
+		for(i = 0; i < m; i++)
+		{
+			for(p = 0; p < k; p++)
+			{
+				a[p] = transA == false ? A[i * k + p] : A[p * m + i];
+			}
+
+			for(j = 0; j < n; j++)
+			{
+				const T *b = B + j * k;
+				T sum = (T) 0;
+
+				for(p = 0; p < k; p++)
+				{
+					sum += a[p] * b[p];
+				}
+
+				C[i * n + j] += alpha * sum;
+			}
+		}
+	}
+}
+
+
+template<class T>
+void Im2col(const T *x, T *col, const ConvShape &shape)
+{
+	/* col((c, r, s), (oy, ox)) = x(c, oy + R - 1 - r, ox + S - 1 - s) (flipped kernel) */
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	long c, r, s, oy, ox;
+
+	for(c = 0; c < shape.inMaps; c++)
+	{
+		for(r = 0; r < R; r++)
+		{
+			for(s = 0; s < S; s++)
+			{
+				T *dst = col + ((c * R + r) * S + s) * OH * OW;
+				const T *src = x + c * H * W + (R - 1 - r) * W + (S - 1 - s);
+
+				for(oy = 0; oy < OH; oy++)
+				{
+					for(ox = 0; ox < OW; ox++)
+					{
+						dst[oy * OW + ox] = src[oy * W + ox];
+					}
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+void Col2im(const T *col, T *x, const ConvShape &shape)
+{
+	/* Scatter-add version of Im2col; x must be initialized */
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	long c, r, s, oy, ox;
+
+	for(c = 0; c < shape.inMaps; c++)
+	{
+		for(r = 0; r < R; r++)
+		{
+			for(s = 0; s < S; s++)
+			{
+				const T *src = col + ((c * R + r) * S + s) * OH * OW;
+				T *dst = x + c * H * W + (R - 1 - r) * W + (S - 1 - s);
+
+				for(oy = 0; oy < OH; oy++)
+				{
+					for(ox = 0; ox < OW; ox++)
+					{
+						dst[oy * W + ox] += src[oy * OW + ox];
+					}
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+static void ConvForwardIm2col(const T *x, const T *w, T *y, const ConvShape &shape, T *workspace)
+{
+	const long P = shape.outDimY * shape.outDimX;
+	const long CRS = shape.GetKernelSize();
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel
+#endif
+	{
+		T *col = workspace + GetThreadIdx() * CRS * P;
+
+#ifdef FRACTAL_USE_OMP
+		#pragma omp for
+#endif
+		for(long n = 0; n < shape.batchSize; n++)
+		{
+			Im2col(x + n * shape.GetInSize(), col, shape);
+
+			/* y_n (K x P) = w (K x CRS) * col (CRS x P) */
+			Gemm(false, false, shape.outMaps, P, CRS, (T) 1, w, col, (T) 0, y + n * shape.GetOutSize());
+		}
+	}
+}
+
+
+template<class T>
+static void ConvBackwardDataIm2col(const T *dy, const T *w, T *dx, const ConvShape &shape)
+{
+	const long P = shape.outDimY * shape.outDimX;
+	const long CRS = shape.GetKernelSize();
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel
+#endif
+	{
+		std::vector<T> col(CRS * P);
+
+#ifdef FRACTAL_USE_OMP
+		#pragma omp for
+#endif
+		for(long n = 0; n < shape.batchSize; n++)
+		{
+			T *dxn = dx + n * shape.GetInSize();
+
+			/* col (CRS x P) = w^T (CRS x K) * dy_n (K x P) */
+			Gemm(true, false, CRS, P, shape.outMaps, (T) 1, w, dy + n * shape.GetOutSize(), (T) 0, col.data());
+
+			std::fill(dxn, dxn + shape.GetInSize(), (T) 0);
+			Col2im(col.data(), dxn, shape);
+		}
+	}
+}
+
+
+template<class T>
+static void ConvBackwardFilterIm2col(const T *x, const T *dy, T *dw, const ConvShape &shape)
+{
+	const long P = shape.outDimY * shape.outDimX;
+	const long CRS = shape.GetKernelSize();
+	const long K = shape.outMaps;
+
+	std::fill(dw, dw + K * CRS, (T) 0);
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel
+#endif
+	{
+		std::vector<T> col(CRS * P);
+		std::vector<T> partial(K * CRS, (T) 0);
+
+#ifdef FRACTAL_USE_OMP
+		#pragma omp for
+#endif
+		for(long n = 0; n < shape.batchSize; n++)
+		{
+			Im2col(x + n * shape.GetInSize(), col.data(), shape);
+
+			/* partial (K x CRS) += dy_n (K x P) * col^T (P x CRS) */
+			Gemm(false, true, K, CRS, P, (T) 1, dy + n * shape.GetOutSize(), col.data(), (T) 1, partial.data());
+		}
+
+#ifdef FRACTAL_USE_OMP
+		#pragma omp critical
+#endif
+		{
+			for(long i = 0; i < K * CRS; i++)
+			{
+				dw[i] += partial[i];
+			}
+		}
+	}
+}
+
+
+template<class T>
+static void ConvForwardDirect(const T *x, const T *w, T *y, const ConvShape &shape)
+{
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long C = shape.inMaps, K = shape.outMaps;
+
+	/* One output map of one sample per task */
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < shape.batchSize * K; idx++)
+	{
+		const long n = idx / K, k = idx % K;
+		T *out = y + idx * OH * OW;
+		T wr[DIRECT_MAX_KERNEL];
+		long c, r, s, oy, ox;
+
+		std::fill(out, out + OH * OW, (T) 0);
+
+		for(c = 0; c < C; c++)
+		{
+			const T *in = x + (n * C + c) * H * W;
+			const T *wk = w + (k * C + c) * R * S;
+
+			for(r = 0; r < R; r++)
+			{
+				/* Kernel row (flipped) kept in registers */
+				for(s = 0; s < S; s++)
+				{
+					wr[s] = wk[(R - 1 - r) * S + (S - 1 - s)];
+				}
+
+				for(oy = 0; oy < OH; oy++)
+				{
+					const T *inRow = in + (oy + r) * W;
+					T *outRow = out + oy * OW;
+
+					for(ox = 0; ox < OW; ox++)
+					{
+						T acc = outRow[ox];
+
+						for(s = 0; s < S; s++)
+						{
+							acc += wr[s] * inRow[ox + s];
+						}
+
+						outRow[ox] = acc;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+static void ConvBackwardDataDirect(const T *dy, const T *w, T *dx, const ConvShape &shape)
+{
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long C = shape.inMaps, K = shape.outMaps;
+
+	/* One input map of one sample per task */
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < shape.batchSize * C; idx++)
+	{
+		const long n = idx / C, c = idx % C;
+		T *in = dx + idx * H * W;
+		long k, r, s, oy, ox;
+
+		std::fill(in, in + H * W, (T) 0);
+
+		for(k = 0; k < K; k++)
+		{
+			const T *out = dy + (n * K + k) * OH * OW;
+			const T *wk = w + (k * C + c) * R * S;
+
+			for(r = 0; r < R; r++)
+			{
+				for(s = 0; s < S; s++)
+				{
+					const T wv = wk[(R - 1 - r) * S + (S - 1 - s)];
+
+					for(oy = 0; oy < OH; oy++)
+					{
+						const T *outRow = out + oy * OW;
+						T *inRow = in + (oy + r) * W + s;
+
+						for(ox = 0; ox < OW; ox++)
+						{
+							inRow[ox] += wv * outRow[ox];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+static void ConvBackwardFilterDirect(const T *x, const T *dy, T *dw, const ConvShape &shape)
+{
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long C = shape.inMaps, K = shape.outMaps;
+
+	/* One (output map, input map) kernel per task */
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < K * C; idx++)
+	{
+		const long k = idx / C, c = idx % C;
+		T *wk = dw + idx * R * S;
+		long n, r, s, oy, ox;
+
+		for(r = 0; r < R; r++)
+		{
+			for(s = 0; s < S; s++)
+			{
+				T acc = (T) 0;
+
+				for(n = 0; n < shape.batchSize; n++)
+				{
+					const T *in = x + (n * C + c) * H * W;
+					const T *out = dy + (n * K + k) * OH * OW;
+
+					for(oy = 0; oy < OH; oy++)
+					{
+						const T *inRow = in + (oy + r) * W + s;
+						const T *outRow = out + oy * OW;
+
+						for(ox = 0; ox < OW; ox++)
+						{
+							acc += inRow[ox] * outRow[ox];
+						}
+					}
+				}
+
+				wk[(R - 1 - r) * S + (S - 1 - s)] = acc;
+			}
+		}
+	}
+}
+
+
+/* In-place radix-2 FFT of n (a power of two) elements that are stride apart */
+template<class T>
+static void Fft(std::complex<T> *a, const long n, const long stride, const bool inverse)
+{
+	long i, j, k, len;
+
+	for(i = 1, j = 0; i < n; i++)
+	{
+		long bit = n >> 1;
+
+		for(; (j & bit) != 0; bit >>= 1) j ^= bit;
+		j ^= bit;
+
+		if(i < j) std::swap(a[i * stride], a[j * stride]);
+	}
+
+	for(len = 2; len <= n; len <<= 1)
+	{
+		const double angle = (inverse == true ? 2.0 : -2.0) * M_PI / (double) len;
+		const std::complex<double> wLen(std::cos(angle), std::sin(angle));
+
+		for(i = 0; i < n; i += len)
+		{
+			/* Twiddles are accumulated in double to keep the single precision error small */
+			std::complex<double> w(1.0, 0.0);
+
+			for(k = 0; k < len / 2; k++)
+			{
+				std::complex<T> &u = a[(i + k) * stride];
+				std::complex<T> &v = a[(i + k + len / 2) * stride];
+				const std::complex<T> t = v * std::complex<T>((T) w.real(), (T) w.imag());
+
+				v = u - t;
+				u = u + t;
+				w *= wLen;
+			}
+		}
+	}
+}
+
+
+/* 2-D FFT of a dimY x dimX row-major array */
+template<class T>
+static void Fft2(std::complex<T> *a, const long dimY, const long dimX, const bool inverse)
+{
+	long i;
+
+	for(i = 0; i < dimY; i++) Fft(a + i * dimX, dimX, 1, inverse);
+	for(i = 0; i < dimX; i++) Fft(a + i, dimY, dimX, inverse);
+}
+
+
+/* Zero-padded copy of a dimY x dimX map into an fftDimY x fftDimX complex array */
+template<class T>
+static void FftLoad(const T *src, const long dimY, const long dimX,
+		std::complex<T> *dst, const long fftDimY, const long fftDimX)
+{
+	std::fill(dst, dst + fftDimY * fftDimX, std::complex<T>((T) 0, (T) 0));
+
+	for(long i = 0; i < dimY; i++)
+	{
+		for(long j = 0; j < dimX; j++)
+		{
+			dst[i * fftDimX + j] = std::complex<T>(src[i * dimX + j], (T) 0);
+		}
+	}
+}
+
+
+template<class T>
+static void ConvForwardFft(const T *x, const T *w, T *y, const ConvShape &shape, T *workspace)
+{
+	/* The circular convolution of size >= the input does not alias the valid outputs */
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long C = shape.inMaps, K = shape.outMaps;
+	const long FY = GetFftDim(H), FX = GetFftDim(W);
+	const long F = FY * FX;
+	const T scale = (T) 1 / (T) F;
+
+	std::complex<T> *wf = reinterpret_cast<std::complex<T> *>(workspace);
+
+	/* Spectra of the kernels (CUDNN_CONVOLUTION is a true convolution, so no flip is needed) */
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < K * C; idx++)
+	{
+		FftLoad(w + idx * R * S, R, S, wf + idx * F, FY, FX);
+		Fft2(wf + idx * F, FY, FX, false);
+	}
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel
+#endif
+	{
+		std::complex<T> *xf = wf + K * C * F + GetThreadIdx() * (C + 1) * F;
+		std::complex<T> *yf = xf + C * F;
+
+#ifdef FRACTAL_USE_OMP
+		#pragma omp for
+#endif
+		for(long n = 0; n < shape.batchSize; n++)
+		{
+			long c, k, i, oy, ox;
+
+			for(c = 0; c < C; c++)
+			{
+				FftLoad(x + (n * C + c) * H * W, H, W, xf + c * F, FY, FX);
+				Fft2(xf + c * F, FY, FX, false);
+			}
+
+			for(k = 0; k < K; k++)
+			{
+				T *out = y + (n * K + k) * OH * OW;
+
+				std::fill(yf, yf + F, std::complex<T>((T) 0, (T) 0));
+
+				for(c = 0; c < C; c++)
+				{
+					const std::complex<T> *xc = xf + c * F;
+					const std::complex<T> *wkc = wf + (k * C + c) * F;
+
+					for(i = 0; i < F; i++)
+					{
+						yf[i] += xc[i] * wkc[i];
+					}
+				}
+
+				Fft2(yf, FY, FX, true);
+
+				for(oy = 0; oy < OH; oy++)
+				{
+					for(ox = 0; ox < OW; ox++)
+					{
+						out[oy * OW + ox] = yf[(oy + R - 1) * FX + ox + S - 1].real() * scale;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+const long GetWorkspaceSize(const ConvShape &shape, ConvAlgo algo)
+{
+	if(algo == CONV_ALGO_AUTO) algo = SelectAlgo(shape);
+
+	switch(algo)
+	{
+		case CONV_ALGO_DIRECT:
+			return 0;
+		case CONV_ALGO_IM2COL:
+			return GetMaxThreads() * shape.GetKernelSize() * shape.outDimY * shape.outDimX;
+		case CONV_ALGO_WINOGRAD:
+			return GetWinogradFilterSize(shape) + GetWinogradThreadWorkspaceSize(shape) * GetMaxThreads();
+		case CONV_ALGO_FFT:
+		{
+			const long F = GetFftDim(shape.inDimY) * GetFftDim(shape.inDimX);
+
+			/* Complex numbers take two elements */
+			return 2 * F * (shape.outMaps * shape.inMaps + GetMaxThreads() * (shape.inMaps + 1));
+		}
+		default:
+			verify(false);
+	}
+
+	return 0;
+}
+
+
+template<class T>
+void PoolForward(const T *x, T *y, unsigned char *argmax, const PoolShape &shape, const bool isMax)
+{
+	verify(shape.IsValid() == true);
+	verify(argmax == NULL || isMax == true);
+
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long window = shape.window, stride = shape.stride;
+	const T scale = (T) 1 / (T) (window * window);
+
+	/* One map of one sample per task */
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < shape.batchSize * shape.nMaps; idx++)
+	{
+		const T *in = x + idx * H * W;
+		T *out = y + idx * OH * OW;
+		unsigned char *outIdx = argmax == NULL ? NULL : argmax + idx * OH * OW;
+		long oy, ox, i, j;
+
+		for(oy = 0; oy < OH; oy++)
+		{
+			for(ox = 0; ox < OW; ox++)
+			{
+				const T *win = in + oy * stride * W + ox * stride;
+
+				if(isMax == true)
+				{
+					T maxVal = win[0];
+					long maxIdx = 0;
+
+					for(i = 0; i < window; i++)
+					{
+						for(j = 0; j < window; j++)
+						{
+							if(win[i * W + j] > maxVal)
+							{
+								maxVal = win[i * W + j];
+								maxIdx = i * window + j;
+							}
+						}
+					}
+
+					out[oy * OW + ox] = maxVal;
+					if(outIdx != NULL) outIdx[oy * OW + ox] = (unsigned char) maxIdx;
+				}
+				else
+				{
+					T sum = (T) 0;
+
+					for(i = 0; i < window; i++)
+					{
+						for(j = 0; j < window; j++)
+						{
+							sum += win[i * W + j];
+						}
+					}
+
+					out[oy * OW + ox] = sum * scale;
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+void PoolBackward(const T *x, const T *y, const T *dy, T *dx, const PoolShape &shape, const bool isMax)
+{
+	verify(shape.IsValid() == true);
+
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long window = shape.window, stride = shape.stride;
+	const T scale = (T) 1 / (T) (window * window);
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < shape.batchSize * shape.nMaps; idx++)
+	{
+		const T *in = x + idx * H * W;
+		const T *out = y + idx * OH * OW;
+		const T *outErr = dy + idx * OH * OW;
+		T *inErr = dx + idx * H * W;
+		long oy, ox, i, j;
+
+		std::fill(inErr, inErr + H * W, (T) 0);
+
+		for(oy = 0; oy < OH; oy++)
+		{
+			for(ox = 0; ox < OW; ox++)
+			{
+				const long offset = oy * stride * W + ox * stride;
+				const T err = outErr[oy * OW + ox];
+
+				if(isMax == true)
+				{
+					/* First element of the window that equals the maximum */
+					for(i = 0; i < window * window; i++)
+					{
+						if(in[offset + (i / window) * W + i % window] == out[oy * OW + ox]) break;
+					}
+					if(i == window * window) i = 0;
+
+					inErr[offset + (i / window) * W + i % window] += err;
+				}
+				else
+				{
+					for(i = 0; i < window; i++)
+					{
+						for(j = 0; j < window; j++)
+						{
+							inErr[offset + i * W + j] += err * scale;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+void MaxPoolArgmaxBackward(const T *dy, const unsigned char *argmax, T *dx, const PoolShape &shape)
+{
+	verify(shape.IsValid() == true);
+
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long window = shape.window, stride = shape.stride;
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < shape.batchSize * shape.nMaps; idx++)
+	{
+		const T *outErr = dy + idx * OH * OW;
+		const unsigned char *outIdx = argmax + idx * OH * OW;
+		T *inErr = dx + idx * H * W;
+		long oy, ox;
+
+		std::fill(inErr, inErr + H * W, (T) 0);
+
+		for(oy = 0; oy < OH; oy++)
+		{
+			for(ox = 0; ox < OW; ox++)
+			{
+				const long i = outIdx[oy * OW + ox];
+
+				inErr[(oy * stride + i / window) * W + ox * stride + i % window] += outErr[oy * OW + ox];
+			}
+		}
+	}
+}
+
+
+template<class T>
+void ConvActPoolForward(const T *x, const T *w, const T *b, T *y, const ConvShape &shape,
+		const long poolWindow, const long poolStride, const long poolDimX, const long poolDimY,
+		const T leak, const bool quantize, const T delta, const long M)
+{
+	verify(shape.IsValid() == true);
+	verify(poolWindow > 0 && poolStride > 0 && poolStride <= poolWindow);
+	verify((poolDimX - 1) * poolStride + poolWindow <= shape.outDimX);
+	verify((poolDimY - 1) * poolStride + poolWindow <= shape.outDimY);
+
+	const long R = shape.kernelDimY, S = shape.kernelDimX;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX;
+	const long C = shape.inMaps, K = shape.outMaps;
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel
+#endif
+	{
+		/* Rows of the convolution output of one map (row oy is kept in slot oy % poolWindow) */
+		std::vector<T> ring(poolWindow * OW);
+
+		/* One output map of one sample per task */
+#ifdef FRACTAL_USE_OMP
+		#pragma omp for
+#endif
+		for(long idx = 0; idx < shape.batchSize * K; idx++)
+		{
+			const long n = idx / K, k = idx % K;
+			const T bias = b == NULL ? (T) 0 : b[k];
+			T *out = y + idx * poolDimY * poolDimX;
+			long nextRow = 0;
+			long py, px, oy, ox, c, r, s, i, j;
+
+			for(py = 0; py < poolDimY; py++)
+			{
+				const long rowFrom = py * poolStride, rowTo = rowFrom + poolWindow;
+
+				for(oy = std::max(nextRow, rowFrom); oy < rowTo; oy++)
+				{
+					T *row = ring.data() + (oy % poolWindow) * OW;
+
+					std::fill(row, row + OW, bias);
+
+					for(c = 0; c < C; c++)
+					{
+						const T *in = x + (n * C + c) * H * W;
+						const T *wk = w + (k * C + c) * R * S;
+
+						for(r = 0; r < R; r++)
+						{
+							const T *inRow = in + (oy + r) * W;
+
+							for(s = 0; s < S; s++)
+							{
+								const T wv = wk[(R - 1 - r) * S + (S - 1 - s)];
+
+								for(ox = 0; ox < OW; ox++)
+								{
+									row[ox] += wv * inRow[ox + s];
+								}
+							}
+						}
+					}
+				}
+				nextRow = rowTo;
+
+				for(px = 0; px < poolDimX; px++)
+				{
+					T z = ring[(rowFrom % poolWindow) * OW + px * poolStride];
+
+					for(i = rowFrom; i < rowTo; i++)
+					{
+						const T *row = ring.data() + (i % poolWindow) * OW + px * poolStride;
+
+						for(j = 0; j < poolWindow; j++)
+						{
+							z = std::max(z, row[j]);
+						}
+					}
+
+					T a = std::max(leak * z, z);
+
+					if(quantize == true)
+						a = std::min((T) std::floor(a / delta + (T) 0.5), (T) (M - 1)) * delta;
+
+					out[py * poolDimX + px] = a;
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+void ConvForward(const T *x, const T *w, T *y, const ConvShape &shape, ConvAlgo algo, T *workspace)
+{
+	verify(shape.IsValid() == true);
+
+	if(algo == CONV_ALGO_AUTO) algo = SelectAlgo(shape);
+
+	std::vector<T> tmpWorkspace;
+
+	if(workspace == NULL)
+	{
+		tmpWorkspace.resize(GetWorkspaceSize(shape, algo));
+		workspace = tmpWorkspace.data();
+	}
+
+	switch(algo)
+	{
+		case CONV_ALGO_DIRECT:
+			verify(shape.kernelDimX <= DIRECT_MAX_KERNEL);
+			ConvForwardDirect(x, w, y, shape);
+			break;
+		case CONV_ALGO_IM2COL:
+			ConvForwardIm2col(x, w, y, shape, workspace);
+			break;
+		case CONV_ALGO_WINOGRAD:
+			WinogradTransformFilter(w, workspace, shape);
+			WinogradConvForward(x, workspace, y, shape, workspace + GetWinogradFilterSize(shape));
+			break;
+		case CONV_ALGO_FFT:
+			ConvForwardFft(x, w, y, shape, workspace);
+			break;
+		default:
+			verify(false);
+	}
+}
+
+
+template<class T>
+void ConvBackwardData(const T *dy, const T *w, T *dx, const ConvShape &shape, ConvAlgo algo)
+{
+	verify(shape.IsValid() == true);
+
+	if(algo == CONV_ALGO_AUTO || algo == CONV_ALGO_WINOGRAD || algo == CONV_ALGO_FFT) algo = SelectBackwardAlgo(shape);
+
+	switch(algo)
+	{
+		case CONV_ALGO_DIRECT:
+			ConvBackwardDataDirect(dy, w, dx, shape);
+			break;
+		case CONV_ALGO_IM2COL:
+			ConvBackwardDataIm2col(dy, w, dx, shape);
+			break;
+		default:
+			verify(false);
+	}
+}
+
+
+template<class T>
+void ConvBackwardFilter(const T *x, const T *dy, T *dw, const ConvShape &shape, ConvAlgo algo)
+{
+	verify(shape.IsValid() == true);
+
+	if(algo == CONV_ALGO_AUTO || algo == CONV_ALGO_WINOGRAD || algo == CONV_ALGO_FFT) algo = SelectBackwardAlgo(shape);
+
+	switch(algo)
+	{
+		case CONV_ALGO_DIRECT:
+			ConvBackwardFilterDirect(x, dy, dw, shape);
+			break;
+		case CONV_ALGO_IM2COL:
+			ConvBackwardFilterIm2col(x, dy, dw, shape);
+			break;
+		default:
+			verify(false);
+	}
+}
+
+
+template<class T>
+void ConvBiasForward(const T *b, T *y, const long batchSize, const long nMaps, const long mapSize)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < batchSize * nMaps; idx++)
+	{
+		std::fill(y + idx * mapSize, y + (idx + 1) * mapSize, b[idx % nMaps]);
+	}
+}
+
+
+template<class T>
+void ConvBiasBackward(const T *dy, T *db, const long batchSize, const long nMaps, const long mapSize)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long k = 0; k < nMaps; k++)
+	{
+		T sum = (T) 0;
+
+		for(long n = 0; n < batchSize; n++)
+		{
+			const T *map = dy + (n * nMaps + k) * mapSize;
+
+			for(long i = 0; i < mapSize; i++)
+			{
+				sum += map[i];
+			}
+		}
+
+		db[k] = sum;
+	}
+}
+
+
+/* Winograd minimal filtering F(m, r) with alpha = m + r - 1 = 6, built by the Cook-Toom
+ * construction on the points (0, 1, -1, 2, -2, inf): Y = AT [(G g GT) .* (BT d B)] A */
+class WinogradTransform
+{
+public:
+	WinogradTransform(const long r)
+	{
+		const double a[WINOGRAD_TILE - 1] = {0.0, 1.0, -1.0, 2.0, -2.0};
+		const long nPoint = WINOGRAD_TILE - 1;
+		double f[WINOGRAD_TILE - 1];
+		double poly[WINOGRAD_TILE];
+		long i, j, k;
+
+		this->r = r;
+		this->m = WINOGRAD_TILE - r + 1;
+
+		for(i = 0; i < WINOGRAD_TILE; i++)
+		{
+			for(j = 0; j < WINOGRAD_TILE; j++)
+			{
+				AT[i][j] = G[i][j] = BT[i][j] = 0.0;
+			}
+		}
+
+		for(i = 0; i < nPoint; i++)
+		{
+			f[i] = 1.0;
+			for(k = 0; k < nPoint; k++)
+			{
+				if(k != i) f[i] *= a[i] - a[k];
+			}
+		}
+
+		/* AT(i, j) = a_j^i */
+		for(i = 0; i < m; i++)
+		{
+			for(j = 0; j < nPoint; j++)
+			{
+				AT[i][j] = std::pow(a[j], (double) i);
+			}
+		}
+		AT[m - 1][nPoint] = 1.0;
+
+		/* G(j, k) = a_j^k / f_j */
+		for(j = 0; j < nPoint; j++)
+		{
+			for(k = 0; k < r; k++)
+			{
+				G[j][k] = std::pow(a[j], (double) k) / f[j];
+			}
+		}
+		G[nPoint][r - 1] = 1.0;
+
+		/* BT(i, :) = coefficients of prod_{k != i} (x - a_k); the last row uses all the points */
+		for(i = 0; i <= nPoint; i++)
+		{
+			poly[0] = 1.0;
+			for(j = 1; j < WINOGRAD_TILE; j++) poly[j] = 0.0;
+
+			for(k = 0; k < nPoint; k++)
+			{
+				if(k == i) continue;
+
+				for(j = WINOGRAD_TILE - 1; j > 0; j--)
+				{
+					poly[j] = poly[j - 1] - a[k] * poly[j];
+				}
+				poly[0] = -a[k] * poly[0];
+			}
+
+			for(j = 0; j < WINOGRAD_TILE; j++)
+			{
+				BT[i][j] = poly[j];
+			}
+		}
+	}
+
+	long m, r;
+	double AT[WINOGRAD_TILE][WINOGRAD_TILE];	/* m x alpha */
+	double G[WINOGRAD_TILE][WINOGRAD_TILE];		/* alpha x r */
+	double BT[WINOGRAD_TILE][WINOGRAD_TILE];	/* alpha x alpha */
+};
+
+
+static const WinogradTransform &GetWinogradTransform(const long r)
+{
+	static const WinogradTransform f43(3), f25(5);
+
+	verify(r == 3 || r == 5);
+
+	return r == 3 ? f43 : f25;
+}
+
+
+const bool IsWinogradSupported(const ConvShape &shape)
+{
+	return shape.kernelDimX == shape.kernelDimY
+		&& (shape.kernelDimX == 3 || shape.kernelDimX == 5);
+}
+
+
+const long GetWinogradFilterSize(const ConvShape &shape)
+{
+	return WINOGRAD_TILE * WINOGRAD_TILE * shape.outMaps * shape.inMaps;
+}
+
+
+const long GetWinogradThreadWorkspaceSize(const ConvShape &shape)
+{
+	/* Transformed inputs and products of one sample */
+	return WINOGRAD_TILE * WINOGRAD_TILE * (shape.inMaps + shape.outMaps) * GetWinogradTileCount(shape);
+}
+
+
+template<class T>
+void WinogradTransformFilter(const T *w, T *U, const ConvShape &shape)
+{
+	verify(IsWinogradSupported(shape) == true);
+
+	const WinogradTransform &t = GetWinogradTransform(shape.kernelDimX);
+	const long r = t.r;
+	const long KC = shape.outMaps * shape.inMaps;
+
+	/* U(e, k, c) = (G g GT)(e), where g is the flipped kernel of (k, c) */
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for
+#endif
+	for(long idx = 0; idx < KC; idx++)
+	{
+		const T *wk = w + idx * r * r;
+		double tmp[WINOGRAD_TILE][WINOGRAD_TILE];
+		long i, j, k;
+
+		/* tmp = G g */
+		for(i = 0; i < WINOGRAD_TILE; i++)
+		{
+			for(j = 0; j < r; j++)
+			{
+				double sum = 0.0;
+				for(k = 0; k < r; k++)
+				{
+					sum += t.G[i][k] * wk[(r - 1 - k) * r + (r - 1 - j)];
+				}
+				tmp[i][j] = sum;
+			}
+		}
+
+		/* U = tmp GT */
+		for(i = 0; i < WINOGRAD_TILE; i++)
+		{
+			for(j = 0; j < WINOGRAD_TILE; j++)
+			{
+				double sum = 0.0;
+				for(k = 0; k < r; k++)
+				{
+					sum += tmp[i][k] * t.G[j][k];
+				}
+				U[(i * WINOGRAD_TILE + j) * KC + idx] = (T) sum;
+			}
+		}
+	}
+}
+
+
+template<class T>
+void WinogradConvForward(const T *x, const T *U, T *y, const ConvShape &shape, T *workspace)
+{
+	verify(shape.IsValid() == true);
+	verify(IsWinogradSupported(shape) == true);
+
+	const WinogradTransform &t = GetWinogradTransform(shape.kernelDimX);
+	const long m = t.m;
+	const long C = shape.inMaps, K = shape.outMaps;
+	const long W = shape.inDimX, H = shape.inDimY;
+	const long OW = shape.outDimX, OH = shape.outDimY;
+	const long nTileX = (OW + m - 1) / m, nTileY = (OH + m - 1) / m;
+	const long nTile = nTileX * nTileY;
+	const long E = WINOGRAD_TILE * WINOGRAD_TILE;
+
+	std::vector<T> tmpWorkspace;
+
+	if(workspace == NULL)
+	{
+		tmpWorkspace.resize(GetWinogradThreadWorkspaceSize(shape) * GetMaxThreads());
+		workspace = tmpWorkspace.data();
+	}
+
+	T BT[WINOGRAD_TILE][WINOGRAD_TILE], AT[WINOGRAD_TILE][WINOGRAD_TILE];
+
+	for(long i = 0; i < WINOGRAD_TILE; i++)
+	{
+		for(long j = 0; j < WINOGRAD_TILE; j++)
+		{
+			BT[i][j] = (T) t.BT[i][j];
+			AT[i][j] = (T) t.AT[i][j];
+		}
+	}
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel
+#endif
+	{
+		T *V = workspace + GetThreadIdx() * GetWinogradThreadWorkspaceSize(shape);
+		T *M = V + E * C * nTile;
+
+#ifdef FRACTAL_USE_OMP
+		#pragma omp for
+#endif
+		for(long n = 0; n < shape.batchSize; n++)
+		{
+			T d[WINOGRAD_TILE][WINOGRAD_TILE], tmp[WINOGRAD_TILE][WINOGRAD_TILE];
+			long c, k, e, tile, i, j, l;
+
+			/* Input transform: V(e, c, tile) = (BT d B)(e) */
+			for(c = 0; c < C; c++)
+			{
+				const T *in = x + (n * C + c) * H * W;
+
+				for(tile = 0; tile < nTile; tile++)
+				{
+					const long y0 = (tile / nTileX) * m, x0 = (tile % nTileX) * m;
+
+					for(i = 0; i < WINOGRAD_TILE; i++)
+					{
+						for(j = 0; j < WINOGRAD_TILE; j++)
+						{
+							d[i][j] = (y0 + i < H && x0 + j < W) ? in[(y0 + i) * W + x0 + j] : (T) 0;
+						}
+					}
+
+					for(i = 0; i < WINOGRAD_TILE; i++)
+					{
+						for(j = 0; j < WINOGRAD_TILE; j++)
+						{
+							T sum = (T) 0;
+							for(l = 0; l < WINOGRAD_TILE; l++) sum += BT[i][l] * d[l][j];
+							tmp[i][j] = sum;
+						}
+					}
+
+					for(i = 0; i < WINOGRAD_TILE; i++)
+					{
+						for(j = 0; j < WINOGRAD_TILE; j++)
+						{
+							T sum = (T) 0;
+							for(l = 0; l < WINOGRAD_TILE; l++) sum += tmp[i][l] * BT[j][l];
+							V[((i * WINOGRAD_TILE + j) * C + c) * nTile + tile] = sum;
+						}
+					}
+				}
+			}
+
+			/* Element-wise products summed over the input maps: M(e) (K x nTile) = U(e) (K x C) * V(e) (C x nTile) */
+			for(e = 0; e < E; e++)
+			{
+				Gemm(false, false, K, nTile, C, (T) 1, U + e * K * C, V + e * C * nTile, (T) 0, M + e * K * nTile);
+			}
+
+			/* Output transform: y = AT M A */
+			for(k = 0; k < K; k++)
+			{
+				T *out = y + (n * K + k) * OH * OW;
+
+				for(tile = 0; tile < nTile; tile++)
+				{
+					const long y0 = (tile / nTileX) * m, x0 = (tile % nTileX) * m;
+
+					for(i = 0; i < m; i++)
+					{
+						for(j = 0; j < WINOGRAD_TILE; j++)
+						{
+							T sum = (T) 0;
+							for(l = 0; l < WINOGRAD_TILE; l++) sum += AT[i][l] * M[((l * WINOGRAD_TILE + j) * K + k) * nTile + tile];
+							tmp[i][j] = sum;
+						}
+					}
+
+					for(i = 0; i < m && y0 + i < OH; i++)
+					{
+						for(j = 0; j < m && x0 + j < OW; j++)
+						{
+							T sum = (T) 0;
+							for(l = 0; l < WINOGRAD_TILE; l++) sum += tmp[i][l] * AT[j][l];
+							out[(y0 + i) * OW + x0 + j] = sum;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+template<class T>
+const T CompareAlgo(const ConvShape &shape, const ConvAlgo algo, const ConvAlgo reference)
+{
+	verify(shape.IsValid() == true);
+
+	std::vector<T> x(shape.batchSize * shape.GetInSize());
+	std::vector<T> w(shape.outMaps * shape.GetKernelSize());
+	std::vector<T> y(shape.batchSize * shape.GetOutSize());
+	std::vector<T> yRef(shape.batchSize * shape.GetOutSize());
+	unsigned int seed = 1;
+	T maxErr = (T) 0, maxRef = (T) 0;
+
+	for(size_t i = 0; i < x.size(); i++)
+		x[i] = (T) 2 * (T) rand_r(&seed) / (T) RAND_MAX - (T) 1;
+	for(size_t i = 0; i < w.size(); i++)
+		w[i] = (T) 2 * (T) rand_r(&seed) / (T) RAND_MAX - (T) 1;
+
+	ConvForward(x.data(), w.data(), y.data(), shape, algo);
+	ConvForward(x.data(), w.data(), yRef.data(), shape, reference);
+
+	for(size_t i = 0; i < y.size(); i++)
+	{
+		maxErr = std::max(maxErr, (T) std::fabs(y[i] - yRef[i]));
+		maxRef = std::max(maxRef, (T) std::fabs(yRef[i]));
+	}
+
+	return maxRef > (T) 0 ? maxErr / maxRef : maxErr;
+}
+
+
+template<class T>
+const T *FilterCache<T>::GetWinogradFilter(const T *w, const unsigned long version, const ConvShape &shape)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+
+	Entry &entry = entries[w];
+
+	if(entry.U.empty() == true || entry.version != version
+			|| entry.shape.inMaps != shape.inMaps || entry.shape.outMaps != shape.outMaps
+			|| entry.shape.kernelDimX != shape.kernelDimX || entry.shape.kernelDimY != shape.kernelDimY)
+	{
+		entry.version = version;
+		entry.shape = shape;
+		entry.U.resize(GetWinogradFilterSize(shape));
+
+		WinogradTransformFilter(w, entry.U.data(), shape);
+	}
+
+	return entry.U.data();
+}
+
+
+template<class T>
+void FilterCache<T>::Clear()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+
+	entries.clear();
+}
+
+
+template void ConvForward<float>(const float *x, const float *w, float *y, const ConvShape &shape, ConvAlgo algo, float *workspace);
+template void ConvForward<double>(const double *x, const double *w, double *y, const ConvShape &shape, ConvAlgo algo, double *workspace);
+
+template void ConvBackwardData<float>(const float *dy, const float *w, float *dx, const ConvShape &shape, ConvAlgo algo);
+template void ConvBackwardData<double>(const double *dy, const double *w, double *dx, const ConvShape &shape, ConvAlgo algo);
+
+template void ConvBackwardFilter<float>(const float *x, const float *dy, float *dw, const ConvShape &shape, ConvAlgo algo);
+template void ConvBackwardFilter<double>(const double *x, const double *dy, double *dw, const ConvShape &shape, ConvAlgo algo);
+
+template void ConvBiasForward<float>(const float *b, float *y, const long batchSize, const long nMaps, const long mapSize);
+template void ConvBiasForward<double>(const double *b, double *y, const long batchSize, const long nMaps, const long mapSize);
+
+template void ConvBiasBackward<float>(const float *dy, float *db, const long batchSize, const long nMaps, const long mapSize);
+template void ConvBiasBackward<double>(const double *dy, double *db, const long batchSize, const long nMaps, const long mapSize);
+
+template void PoolForward<float>(const float *x, float *y, unsigned char *argmax, const PoolShape &shape, const bool isMax);
+template void PoolForward<double>(const double *x, double *y, unsigned char *argmax, const PoolShape &shape, const bool isMax);
+
+template void PoolBackward<float>(const float *x, const float *y, const float *dy, float *dx, const PoolShape &shape, const bool isMax);
+template void PoolBackward<double>(const double *x, const double *y, const double *dy, double *dx, const PoolShape &shape, const bool isMax);
+
+template void MaxPoolArgmaxBackward<float>(const float *dy, const unsigned char *argmax, float *dx, const PoolShape &shape);
+template void MaxPoolArgmaxBackward<double>(const double *dy, const unsigned char *argmax, double *dx, const PoolShape &shape);
+
+template void ConvActPoolForward<float>(const float *x, const float *w, const float *b, float *y, const ConvShape &shape,
+		const long poolWindow, const long poolStride, const long poolDimX, const long poolDimY,
+		const float leak, const bool quantize, const float delta, const long M);
+template void ConvActPoolForward<double>(const double *x, const double *w, const double *b, double *y, const ConvShape &shape,
+		const long poolWindow, const long poolStride, const long poolDimX, const long poolDimY,
+		const double leak, const bool quantize, const double delta, const long M);
+
+template void Im2col<float>(const float *x, float *col, const ConvShape &shape);
+template void Im2col<double>(const double *x, double *col, const ConvShape &shape);
+
+template void Col2im<float>(const float *col, float *x, const ConvShape &shape);
+template void Col2im<double>(const double *col, double *x, const ConvShape &shape);
+
+template void WinogradTransformFilter<float>(const float *w, float *U, const ConvShape &shape);
+template void WinogradTransformFilter<double>(const double *w, double *U, const ConvShape &shape);
+
+template void WinogradConvForward<float>(const float *x, const float *U, float *y, const ConvShape &shape, float *workspace);
+template void WinogradConvForward<double>(const double *x, const double *U, double *y, const ConvShape &shape, double *workspace);
+
+template const float CompareAlgo<float>(const ConvShape &shape, const ConvAlgo algo, const ConvAlgo reference);
+template const double CompareAlgo<double>(const ConvShape &shape, const ConvAlgo algo, const ConvAlgo reference);
+
+template class FilterCache<float>;
+template class FilterCache<double>;
+
+template void Gemm<float>(const bool transA, const bool transB, const long m, const long n, const long k,
+		const float alpha, const float *A, const float *B, const float beta, float *C);
+template void Gemm<double>(const bool transA, const bool transB, const long m, const long n, const long k,
+		const double alpha, const double *A, const double *B, const double beta, double *C);
+
+}
+
+}
+
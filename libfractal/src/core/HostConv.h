@@ -0,0 +1,184 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_HOSTCONV_H_
+#define FRACTAL_HOSTCONV_H_
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "FractalCommon.h"
+
+
+namespace fractal
+{
+
+namespace hostConv
+{
+
+/* Host implementation of the convolutions used by CONN_CONV and CONN_CONVBIAS.
+ * Same semantics as the cuDNN path of the engine: no padding, stride 1 and
+ * CUDNN_CONVOLUTION mode (the kernel is flipped). Tensors are NCHW, and each
+ * sample is a column of the column-major matrix. */
+
+enum ConvAlgo {CONV_ALGO_AUTO, CONV_ALGO_DIRECT, CONV_ALGO_IM2COL, CONV_ALGO_WINOGRAD, CONV_ALGO_FFT};
+
+/* The direct path keeps one kernel row in registers */
+const long DIRECT_MAX_KERNEL = 16;
+
+/* Winograd F(4x4, 3x3) and F(2x2, 5x5) both work on 6x6 tiles */
+const long WINOGRAD_TILE = 6;
+
+class ConvShape
+{
+public:
+	ConvShape() : batchSize(0), inMaps(0), inDimX(0), inDimY(0),
+		outMaps(0), outDimX(0), outDimY(0), kernelDimX(0), kernelDimY(0) {}
+
+	inline const long GetInSize() const { return inMaps * inDimY * inDimX; }
+	inline const long GetOutSize() const { return outMaps * outDimY * outDimX; }
+	inline const long GetKernelSize() const { return inMaps * kernelDimY * kernelDimX; }
+
+	const bool IsValid() const;
+
+	long batchSize;
+	long inMaps, inDimX, inDimY;
+	long outMaps, outDimX, outDimY;
+	long kernelDimX, kernelDimY;
+};
+
+/* Pooling without padding; avg divides by the window size (no padding to exclude) */
+class PoolShape
+{
+public:
+	PoolShape() : batchSize(0), nMaps(0), inDimX(0), inDimY(0),
+		outDimX(0), outDimY(0), window(0), stride(0) {}
+
+	inline const long GetInSize() const { return nMaps * inDimY * inDimX; }
+	inline const long GetOutSize() const { return nMaps * outDimY * outDimX; }
+
+	const bool IsValid() const;
+
+	long batchSize, nMaps;
+	long inDimX, inDimY;
+	long outDimX, outDimY;
+	long window, stride;
+};
+
+const ConvAlgo SelectAlgo(const ConvShape &shape);
+const bool IsWinogradSupported(const ConvShape &shape);
+
+/* Number of elements of the forward workspace of the algorithm (all threads) */
+const long GetWorkspaceSize(const ConvShape &shape, ConvAlgo algo);
+
+/* y = conv(x, w); the workspace is allocated internally if it is NULL */
+template<class T>
+void ConvForward(const T *x, const T *w, T *y, const ConvShape &shape, ConvAlgo algo, T *workspace = NULL);
+
+/* dx = gradient of the input */
+template<class T>
+void ConvBackwardData(const T *dy, const T *w, T *dx, const ConvShape &shape, ConvAlgo algo);
+
+/* dw = gradient of the kernel, summed over the batch */
+template<class T>
+void ConvBackwardFilter(const T *x, const T *dy, T *dw, const ConvShape &shape, ConvAlgo algo);
+
+/* y[n][k][*] = b[k] */
+template<class T>
+void ConvBiasForward(const T *b, T *y, const long batchSize, const long nMaps, const long mapSize);
+
+/* db[k] = sum of dy[n][k][*] */
+template<class T>
+void ConvBiasBackward(const T *dy, T *db, const long batchSize, const long nMaps, const long mapSize);
+
+/* y = pool(x); for max pooling, argmax (if not NULL) receives the offset of the maximum within
+ * each window (row * window + col), so that the backward pass does not need x and y */
+template<class T>
+void PoolForward(const T *x, T *y, unsigned char *argmax, const PoolShape &shape, const bool isMax);
+
+/* dx = gradient of the input, found by rescanning the windows of x for y */
+template<class T>
+void PoolBackward(const T *x, const T *y, const T *dy, T *dx, const PoolShape &shape, const bool isMax);
+
+/* dx = gradient of the input, scattered through the argmax of PoolForward() */
+template<class T>
+void MaxPoolArgmaxBackward(const T *dy, const unsigned char *argmax, T *dx, const PoolShape &shape);
+
+/* Inference block: y = maxpool(act(conv(x, w) + b)), where act is the leaky rectifier followed by
+ * the optional signal quantization min(round(a / delta), M - 1) * delta. The pooling is done on the
+ * pre-activation (act is monotonic) and the convolution output is kept in a ring of poolWindow rows.
+ * b may be NULL. */
+template<class T>
+void ConvActPoolForward(const T *x, const T *w, const T *b, T *y, const ConvShape &shape,
+		const long poolWindow, const long poolStride, const long poolDimX, const long poolDimY,
+		const T leak, const bool quantize, const T delta, const long M);
+
+/* Winograd path (forward only; the backward passes use the direct or im2col path).
+ * The filter is transformed separately so that it can be reused until the weights change. */
+const long GetWinogradFilterSize(const ConvShape &shape);
+const long GetWinogradThreadWorkspaceSize(const ConvShape &shape);
+
+template<class T>
+void WinogradTransformFilter(const T *w, T *U, const ConvShape &shape);
+
+template<class T>
+void WinogradConvForward(const T *x, const T *U, T *y, const ConvShape &shape, T *workspace = NULL);
+
+/* Maximum forward error of algo relative to reference, normalized by the largest output (random data) */
+template<class T>
+const T CompareAlgo(const ConvShape &shape, const ConvAlgo algo, const ConvAlgo reference);
+
+/* Building blocks of the im2col path (one sample) */
+template<class T>
+void Im2col(const T *x, T *col, const ConvShape &shape);
+
+template<class T>
+void Col2im(const T *col, T *x, const ConvShape &shape);
+
+/* Row-major C = alpha * op(A) * op(B) + beta * C, where op(A) is m x k and op(B) is k x n */
+template<class T>
+void Gemm(const bool transA, const bool transB, const long m, const long n, const long k,
+		const T alpha, const T *A, const T *B, const T beta, T *C);
+
+
+/* Transformed filters, keyed by the weight pointer and invalidated by the version of its memory */
+template<class T>
+class FilterCache
+{
+public:
+	const T *GetWinogradFilter(const T *w, const unsigned long version, const ConvShape &shape);
+	void Clear();
+
+protected:
+	struct Entry
+	{
+		unsigned long version;
+		ConvShape shape;
+		std::vector<T> U;
+	};
+
+	std::unordered_map<const T *, Entry> entries;
+	std::mutex mtx;
+};
+
+}
+
+}
+
+#endif /* FRACTAL_HOSTCONV_H_ */
+
@@ -0,0 +1,414 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "HostOpt.h"
+
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+
+/* Elements per chunk of the parallel sweep (a multiple of STATE_BLOCK) */
+#define UPDATE_CHUNK 16384
+
+
+namespace fractal
+{
+
+namespace hostOpt
+{
+
+template<class T>
+static inline const T QuantWeight(const T w, const T delta, const long M)
+{
+	/* Same as WeightQuantKernel */
+	if(std::signbit(w))
+		return -std::min(std::floor(std::fabs(w) / delta + (T) 0.5), (T) (M - 1) / 2) * delta;
+	else
+		return std::min(std::floor(std::fabs(w) / delta + (T) 0.5), (T) ((M - 1) / 2)) * delta;
+}
+
+
+static inline unsigned short ToBf16(const float x)
+{
+	uint32_t u;
+
+	memcpy(&u, &x, sizeof(u));
+	u += 0x7fff + ((u >> 16) & 1);
+
+	return (unsigned short) (u >> 16);
+}
+
+
+static inline float FromBf16(const unsigned short x)
+{
+	uint32_t u = (uint32_t) x << 16;
+	float y;
+
+	memcpy(&y, &u, sizeof(y));
+
+	return y;
+}
+
+
+/* Value of each code relative to the scale of its block */
+template<class T>
+static const T *StateCodeTable()
+{
+	static const std::vector<T> table = []()
+	{
+		std::vector<T> t(256);
+
+		t[0] = (T) 0;
+		for(long c = 1; c < 256; c++)
+			t[c] = std::exp2((T) (c - 255) / (T) STATE_CODES_PER_OCTAVE);
+
+		return t;
+	}();
+
+	return table.data();
+}
+
+
+/* Number in [0, 1) for the stochastic rounding of element i at update seed: a hash of i plus seed times
+ * the golden ratio, so that the successive roundings of an element are spread evenly over [0, 1) rather
+ * than drawn independently (less noise in a slowly decaying mean square). Same as _stateDither() of the
+ * CUDA kernels. */
+static inline float StateDither(const unsigned long seed, const unsigned long i)
+{
+	uint32_t h = (uint32_t) i;
+
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	h += (uint32_t) seed * 0x9e3779b9u;
+
+	return (float) (h >> 8) * (1.0f / 16777216.0f);
+}
+
+
+template<class T>
+static inline unsigned char StateCode(const T x, const T invScale, const T *table, const T u)
+{
+	const T r = x * invScale;
+	long c;
+
+	if(r <= (T) 0) return 0;
+	if(r >= (T) 1) return 255;
+
+	/* A positive value below the range is kept at the smallest code, not zero: a zero mean square
+	 * would give the largest step (and make msDelta of Adadelta grow) */
+	if(r <= table[1]) return 1;
+
+	/* table[c] <= r < table[c + 1] */
+	c = std::max(1L, (long) std::floor((T) 255 + (T) STATE_CODES_PER_OCTAVE * std::log2(r)));
+	if(c > 1 && r < table[c]) c--;
+	else if(c < 255 && r >= table[c + 1]) c++;
+
+	/* Round up with probability (r - table[c]) / (table[c + 1] - table[c]) */
+	if(c < 255 && u * (table[c + 1] - table[c]) < r - table[c]) c++;
+
+	return (unsigned char) c;
+}
+
+
+/* Decode and encode one block of a compact mean square; the block starts at element from of the tensor */
+template<class T>
+static void LoadStateBlock(const unsigned char *codes, const T scale, T *x, const unsigned long n)
+{
+	const T *table = StateCodeTable<T>();
+
+	for(unsigned long i = 0; i < n; i++)
+		x[i] = scale * table[codes[i]];
+}
+
+
+template<class T>
+static void StoreStateBlock(const T *x, unsigned char *codes, T *scale, const unsigned long n,
+		const unsigned long seed, const unsigned long from)
+{
+	const T *table = StateCodeTable<T>();
+	T maxVal = (T) 0;
+
+	for(unsigned long i = 0; i < n; i++)
+		maxVal = std::max(maxVal, x[i]);
+
+	const T invScale = (maxVal > (T) 0) ? (T) 1 / maxVal : (T) 0;
+
+	for(unsigned long i = 0; i < n; i++)
+		codes[i] = StateCode(x[i], invScale, table, (T) StateDither(seed, from + i));
+
+	*scale = maxVal;
+}
+
+
+template<class T, UpdateRule rule>
+static void UpdateBlock(const UpdateParam<T> &p, T *weights, T *vels, const T *derivs,
+		T *msDeriv, T *msDelta, T *weightsFixed, const unsigned long n)
+{
+	const T rmspropBound = std::sqrt((T) 1 / ((T) 1 - p.decayRate));
+	const T adadeltaBound = (T) 10;
+
+	for(unsigned long i = 0; i < n; i++)
+	{
+		T w, v, step;
+
+		v = vels[i];
+		w = weights[i] - p.momentum * v;
+		step = derivs[i];
+
+		if(rule == UPDATE_RMSPROP)
+		{
+			T ms = p.decayRate * msDeriv[i] + ((T) 1 - p.decayRate) * step * step;
+			T rms = std::sqrt(ms) + (T) 1e-20;
+
+			step = std::min(rmspropBound, std::max(-rmspropBound, step / rms));
+			msDeriv[i] = ms;
+		}
+		else if(rule == UPDATE_ADADELTA)
+		{
+			T ms = p.decayRate * msDeriv[i] + ((T) 1 - p.decayRate) * step * step;
+			T rmsDeriv = std::sqrt(ms) + (T) 1e-20;
+			T rmsDelta = std::sqrt(msDelta[i] + p.rate * p.rate);
+
+			step = rmsDelta * std::min(adadeltaBound, std::max(-adadeltaBound, step / rmsDeriv));
+			msDeriv[i] = ms;
+			msDelta[i] = p.decayRate * msDelta[i] + ((T) 1 - p.decayRate) * step * step;
+		}
+
+		v = p.velDecay * v + p.velScale * step;
+		w += ((T) 1 + p.momentum) * v;
+
+		vels[i] = v;
+		weights[i] = w;
+
+		if(weightsFixed != NULL)
+			weightsFixed[i] = QuantWeight(w, p.quantDelta, p.quantM);
+	}
+}
+
+
+template<class T, UpdateRule rule>
+static void UpdateRange(const UpdateTensor<T> &tensor, const unsigned long from, const unsigned long n)
+{
+	const UpdateParam<T> &p = tensor.param;
+	const bool compactMsDeriv = (rule != UPDATE_NESTEROV && tensor.msDerivCode != NULL);
+	const bool compactMsDelta = (rule == UPDATE_ADADELTA && tensor.msDeltaCode != NULL);
+
+	/* Decoded compact state of a block */
+	T v[STATE_BLOCK], ms[STATE_BLOCK], md[STATE_BLOCK];
+
+	for(unsigned long b = from; b < from + n; b += STATE_BLOCK)
+	{
+		const unsigned long len = std::min((unsigned long) STATE_BLOCK, from + n - b);
+		T *vels, *msDeriv, *msDelta;
+
+		vels = NULL;
+		msDeriv = msDelta = NULL;
+
+		if(tensor.velsBf16 != NULL)
+		{
+			for(unsigned long i = 0; i < len; i++)
+				v[i] = (T) FromBf16(tensor.velsBf16[b + i]);
+			vels = v;
+		}
+		else
+		{
+			vels = tensor.vels + b;
+		}
+
+		if(compactMsDeriv == true)
+		{
+			LoadStateBlock(tensor.msDerivCode + b, tensor.msDerivScale[b / STATE_BLOCK], ms, len);
+			msDeriv = ms;
+		}
+		else if(rule != UPDATE_NESTEROV)
+		{
+			msDeriv = tensor.msDeriv + b;
+		}
+
+		if(compactMsDelta == true)
+		{
+			LoadStateBlock(tensor.msDeltaCode + b, tensor.msDeltaScale[b / STATE_BLOCK], md, len);
+			msDelta = md;
+		}
+		else if(rule == UPDATE_ADADELTA)
+		{
+			msDelta = tensor.msDelta + b;
+		}
+
+		UpdateBlock<T, rule>(p, tensor.weights + b, vels, tensor.derivs + b, msDeriv, msDelta,
+				(p.quantM > 0) ? tensor.weightsFixed + b : NULL, len);
+
+		if(tensor.velsBf16 != NULL)
+		{
+			for(unsigned long i = 0; i < len; i++)
+				tensor.velsBf16[b + i] = ToBf16((float) v[i]);
+		}
+
+		/* msDelta is dithered as the elements after those of msDeriv */
+		if(compactMsDeriv == true)
+			StoreStateBlock(ms, tensor.msDerivCode + b, tensor.msDerivScale + b / STATE_BLOCK, len, p.seed, b);
+
+		if(compactMsDelta == true)
+			StoreStateBlock(md, tensor.msDeltaCode + b, tensor.msDeltaScale + b / STATE_BLOCK, len, p.seed, tensor.n + b);
+	}
+}
+
+
+template<class T>
+void Update(const UpdateTensor<T> &tensor, const unsigned long from, const unsigned long n)
+{
+	verify(from + n <= tensor.n);
+	verify(tensor.vels != NULL || tensor.velsBf16 != NULL);
+	verify(tensor.param.rule == UPDATE_NESTEROV || tensor.msDeriv != NULL || tensor.msDerivCode != NULL);
+	verify(tensor.param.rule != UPDATE_ADADELTA || tensor.msDelta != NULL || tensor.msDeltaCode != NULL);
+	verify(tensor.param.quantM == 0 || tensor.weightsFixed != NULL);
+	verify((tensor.msDerivCode == NULL && tensor.msDeltaCode == NULL) || from % STATE_BLOCK == 0);
+
+	switch(tensor.param.rule)
+	{
+		case UPDATE_NESTEROV:
+			UpdateRange<T, UPDATE_NESTEROV>(tensor, from, n);
+			break;
+		case UPDATE_RMSPROP:
+			UpdateRange<T, UPDATE_RMSPROP>(tensor, from, n);
+			break;
+		case UPDATE_ADADELTA:
+			UpdateRange<T, UPDATE_ADADELTA>(tensor, from, n);
+			break;
+	}
+}
+
+
+template<class T>
+void FusedUpdate(const std::vector<UpdateTensor<T>> &tensors)
+{
+	/* Chunks never cross a tensor boundary */
+	std::vector<std::pair<long, unsigned long>> chunks;
+	typename std::vector<UpdateTensor<T>>::const_iterator iter, iter_end;
+	long idx;
+
+	idx = 0;
+	iter_end = tensors.end();
+	for(iter = tensors.begin(); iter != iter_end; ++iter, idx++)
+	{
+		for(unsigned long from = 0; from < iter->n; from += UPDATE_CHUNK)
+			chunks.push_back(std::make_pair(idx, from));
+	}
+
+	const long nChunk = (long) chunks.size();
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for schedule(dynamic) if(nChunk > 1)
+#endif
+	for(long c = 0; c < nChunk; c++)
+	{
+		const UpdateTensor<T> &tensor = tensors[chunks[c].first];
+		const unsigned long from = chunks[c].second;
+
+		Update<T>(tensor, from, std::min(tensor.n - from, (unsigned long) UPDATE_CHUNK));
+	}
+}
+
+
+template<class T>
+void Bf16Encode(const T *x, unsigned short *y, const unsigned long n)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= UPDATE_CHUNK)
+#endif
+	for(long i = 0; i < (long) n; i++)
+	{
+		y[i] = ToBf16((float) x[i]);
+	}
+}
+
+
+template<class T>
+void Bf16Decode(const unsigned short *x, T *y, const unsigned long n)
+{
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= UPDATE_CHUNK)
+#endif
+	for(long i = 0; i < (long) n; i++)
+	{
+		y[i] = (T) FromBf16(x[i]);
+	}
+}
+
+
+template<class T>
+void StateQuantEncode(const T *x, unsigned char *codes, T *scales, const unsigned long n)
+{
+	const long nBlock = ((long) n + STATE_BLOCK - 1) / STATE_BLOCK;
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= UPDATE_CHUNK)
+#endif
+	for(long b = 0; b < nBlock; b++)
+	{
+		const long from = b * STATE_BLOCK;
+
+		StoreStateBlock(x + from, codes + from, scales + b, std::min((long) n - from, STATE_BLOCK), 0UL, (unsigned long) from);
+	}
+}
+
+
+template<class T>
+void StateQuantDecode(const unsigned char *codes, const T *scales, T *y, const unsigned long n)
+{
+	const long nBlock = ((long) n + STATE_BLOCK - 1) / STATE_BLOCK;
+
+#ifdef FRACTAL_USE_OMP
+	#pragma omp parallel for if(n >= UPDATE_CHUNK)
+#endif
+	for(long b = 0; b < nBlock; b++)
+	{
+		const long from = b * STATE_BLOCK;
+
+		LoadStateBlock(codes + from, scales[b], y + from, std::min((long) n - from, STATE_BLOCK));
+	}
+}
+
+
+template void Update<float>(const UpdateTensor<float> &tensor, const unsigned long from, const unsigned long n);
+template void Update<double>(const UpdateTensor<double> &tensor, const unsigned long from, const unsigned long n);
+
+template void FusedUpdate<float>(const std::vector<UpdateTensor<float>> &tensors);
+template void FusedUpdate<double>(const std::vector<UpdateTensor<double>> &tensors);
+
+template void Bf16Encode<float>(const float *x, unsigned short *y, const unsigned long n);
+template void Bf16Encode<double>(const double *x, unsigned short *y, const unsigned long n);
+
+template void Bf16Decode<float>(const unsigned short *x, float *y, const unsigned long n);
+template void Bf16Decode<double>(const unsigned short *x, double *y, const unsigned long n);
+
+template void StateQuantEncode<float>(const float *x, unsigned char *codes, float *scales, const unsigned long n);
+template void StateQuantEncode<double>(const double *x, unsigned char *codes, double *scales, const unsigned long n);
+
+template void StateQuantDecode<float>(const unsigned char *codes, const float *scales, float *y, const unsigned long n);
+template void StateQuantDecode<double>(const unsigned char *codes, const double *scales, double *y, const unsigned long n);
+
+}
+
+}
+
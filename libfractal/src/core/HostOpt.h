@@ -0,0 +1,122 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_HOSTOPT_H_
+#define FRACTAL_HOSTOPT_H_
+
+#include <vector>
+
+#include "FractalCommon.h"
+
+
+namespace fractal
+{
+
+namespace hostOpt
+{
+
+/* Fused optimizer step of Connection::UpdateWeights(). For each element, with m = momentum:
+ *
+ *   weights -= m * vels                              (simplified Nesterov momentum)
+ *   step = derivs                                    (UPDATE_NESTEROV)
+ *        = Rmsprop of derivs                         (UPDATE_RMSPROP, updates msDeriv)
+ *        = Adadelta of derivs                        (UPDATE_ADADELTA, updates msDeriv and msDelta)
+ *   vels = velDecay * vels + velScale * step
+ *   weights += (1 + m) * vels
+ *   weightsFixed = quantized weights                 (if quantM > 0, same as Engine::WeightQuant)
+ *
+ * which is the sequence of engine calls of the unfused update in one read and one write of each array.
+ *
+ * The state can be compact: vels in bfloat16 (the upper half of a float, rounded to nearest even), and
+ * msDeriv and msDelta, which are non-negative, in 8 bits with one scale (the maximum) per block of
+ * STATE_BLOCK elements. Code c > 0 stands for scale * 2^((c - 255) / STATE_CODES_PER_OCTAVE) and code 0
+ * for zero, a relative step of 9% over the 32 octaves below the maximum of the block. The update
+ * decodes and re-encodes a block at a time, rounding each value stochastically to one of its two
+ * neighbouring codes so that the rounding is unbiased: a mean square that decays by less than a code
+ * step per update (decayRate close to 1) still decays, where rounding to nearest would keep it at its
+ * code. A positive value below the range is stored as the smallest code, never as zero. */
+
+enum UpdateRule {UPDATE_NESTEROV, UPDATE_RMSPROP, UPDATE_ADADELTA};
+
+const long STATE_BLOCK = 256;
+const long STATE_CODES_PER_OCTAVE = 8;
+
+template<class T>
+class UpdateParam
+{
+public:
+	UpdateParam() : rule(UPDATE_NESTEROV), momentum((T) 0), velDecay((T) 0), velScale((T) 0),
+		rate((T) 0), decayRate((T) 0), quantDelta((T) 0), quantM(0), seed(0) {}
+
+	UpdateRule rule;
+	T momentum;
+	T velDecay, velScale;
+	T rate; /* Adadelta: learning rate (floor of the rms of the deltas) */
+	T decayRate; /* Rmsprop, Adadelta: decay of the mean squares */
+	T quantDelta;
+	long quantM; /* 0: no requantization */
+	unsigned long seed; /* stochastic rounding of the compact state; a new value for each update */
+};
+
+/* Arrays of one tensor; msDeriv, msDelta and weightsFixed are unused (may be NULL) unless needed by the param.
+ * If velsBf16 (msDerivCode, msDeltaCode) is not NULL, it replaces vels (msDeriv, msDelta). */
+template<class T>
+class UpdateTensor
+{
+public:
+	UpdateTensor() : weights(NULL), vels(NULL), derivs(NULL), msDeriv(NULL), msDelta(NULL), weightsFixed(NULL),
+		velsBf16(NULL), msDerivCode(NULL), msDeltaCode(NULL), msDerivScale(NULL), msDeltaScale(NULL), n(0) {}
+
+	T *weights, *vels;
+	const T *derivs;
+	T *msDeriv, *msDelta;
+	T *weightsFixed;
+	unsigned short *velsBf16;
+	unsigned char *msDerivCode, *msDeltaCode;
+	T *msDerivScale, *msDeltaScale; /* one per STATE_BLOCK elements */
+	unsigned long n;
+	UpdateParam<T> param;
+};
+
+/* Update the range [from, from + n) of a tensor; with a compact mean square, from is a multiple of STATE_BLOCK */
+template<class T>
+void Update(const UpdateTensor<T> &tensor, const unsigned long from, const unsigned long n);
+
+/* Update all tensors in one parallel sweep over fixed-size chunks, so that small tensors
+ * (biases, convolution kernels) share the threads with large ones */
+template<class T>
+void FusedUpdate(const std::vector<UpdateTensor<T>> &tensors);
+
+/* Conversion of the compact state; there are (n + STATE_BLOCK - 1) / STATE_BLOCK scales */
+template<class T>
+void Bf16Encode(const T *x, unsigned short *y, const unsigned long n);
+
+template<class T>
+void Bf16Decode(const unsigned short *x, T *y, const unsigned long n);
+
+template<class T>
+void StateQuantEncode(const T *x, unsigned char *codes, T *scales, const unsigned long n);
+
+template<class T>
+void StateQuantDecode(const unsigned char *codes, const T *scales, T *y, const unsigned long n);
+
+}
+
+}
+
+#endif /* FRACTAL_HOSTOPT_H_ */
+
@@ -67,6 +67,8 @@ this->param = param;
         statePenalty = NO_STATE_PENALTY;
 
 	linkedProbe = NULL;
+	fused = false;
+	actLut = false;
 
 	engine = NULL;
 	stream = NULL;
@@ -95,7 +97,13 @@ void Layer::SetEngine(Engine *const engine, PStream *const stream)
         state.SetEngine(engine);
 	srcErr.SetEngine(engine);
 	dstErr.SetEngine(engine);
+	actCheckpoint.SetEngine(engine);
+	dropoutMaskHistory.SetEngine(engine);
         dropoutMask.SetEngine(engine);
+	actTableThresholds.SetEngine(engine);
+	actTableValues.SetEngine(engine);
+	actTableCells.SetEngine(engine);
+	actTable.Clear();
 	if(this->engine != NULL)
 	{
 		this->engine->EventDestroy(event);
@@ -193,6 +201,78 @@ void Layer::InitAct(const unsigned long batchFrom, const unsigned long batchTo)
 }
 
 
+void Layer::SetCheckpointSize(const unsigned long nCol)
+{
+	actCheckpoint.Resize(size, nCol);
+}
+
+
+void Layer::SaveCheckpoint(const unsigned long ckptFrom, const unsigned long batchFrom, const unsigned long batchTo)
+{
+	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+	verify(ckptFrom + batchTo - batchFrom < actCheckpoint.GetNumCols());
+	verify(engine != NULL);
+
+	Matrix<FLOAT> actSub(act, batchFrom, batchTo);
+	Matrix<FLOAT> ckptSub(actCheckpoint, ckptFrom, ckptFrom + batchTo - batchFrom);
+
+	engine->MatCopy(actSub, ckptSub, *stream);
+}
+
+
+void Layer::LoadCheckpoint(const unsigned long ckptFrom, const unsigned long batchFrom, const unsigned long batchTo)
+{
+	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+	verify(ckptFrom + batchTo - batchFrom < actCheckpoint.GetNumCols());
+	verify(engine != NULL);
+
+	Matrix<FLOAT> actSub(act, batchFrom, batchTo);
+	Matrix<FLOAT> ckptSub(actCheckpoint, ckptFrom, ckptFrom + batchTo - batchFrom);
+
+	engine->MatCopy(ckptSub, actSub, *stream);
+}
+
+
+void Layer::SetDropoutHistorySize(const unsigned long nCol)
+{
+	if(actType != ACT_DROPOUT) return;
+
+	dropoutMaskHistory.Resize(size, nCol);
+}
+
+
+void Layer::SaveDropoutMask(const unsigned long histFrom, const unsigned long batchFrom, const unsigned long batchTo)
+{
+	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+	verify(engine != NULL);
+
+	if(dropoutEnabled == false) return;
+
+	verify(histFrom + batchTo - batchFrom < dropoutMaskHistory.GetNumCols());
+
+	Matrix<FLOAT> maskSub(dropoutMask, batchFrom, batchTo);
+	Matrix<FLOAT> histSub(dropoutMaskHistory, histFrom, histFrom + batchTo - batchFrom);
+
+	engine->MatCopy(maskSub, histSub, *stream);
+}
+
+
+void Layer::LoadDropoutMask(const unsigned long histFrom, const unsigned long batchFrom, const unsigned long batchTo)
+{
+	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+	verify(engine != NULL);
+
+	if(dropoutEnabled == false) return;
+
+	verify(histFrom + batchTo - batchFrom < dropoutMaskHistory.GetNumCols());
+
+	Matrix<FLOAT> maskSub(dropoutMask, batchFrom, batchTo);
+	Matrix<FLOAT> histSub(dropoutMaskHistory, histFrom, histFrom + batchTo - batchFrom);
+
+	engine->MatCopy(histSub, maskSub, *stream);
+}
+
+
 void Layer::InitErr(const unsigned long batchFrom, const unsigned long batchTo)
 {
 	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
@@ -214,6 +294,9 @@ void Layer::Forward(const unsigned long batchFrom, const unsigned long batchTo)
 			GetName().c_str(), batchFrom, batchTo);
 #endif /* FRACTAL_VERBOSE */
 
+	/* The activation is never materialized; the pooling connection computes its output directly */
+	if(IsFused() == true) return;
+
 	if(IsLinked() == true && linkedProbe->IsInput() == true)
 	{
 		//linkedProbe->StreamWaitEvent(*stream);
@@ -436,6 +519,35 @@ void Layer::ReluQuant()
 	}
 
 }
+const bool Layer::UpdateActTable(const FLOAT delta)
+{
+#if QUANT_RELU
+	/* Same condition as FuncSigmoidKernel and FuncTanhKernel; 100 means no quantization */
+	if(delta > (FLOAT) 99.0 && delta < (FLOAT) 101.0) return false;
+	if(delta <= (FLOAT) 0 || delta > (FLOAT) 1) return false;
+
+	if(actTable.IsEmpty() == false && actTable.GetDelta() == delta) return true;
+
+	if(actType == ACT_SIGMOID)
+		actTable.BuildSigmoid(delta);
+	else
+		actTable.BuildTanh(delta);
+
+	actTableThresholds.Resize(actTable.GetThresholds().size(), 1);
+	actTableValues.Resize(actTable.GetValues().size(), 1);
+	actTableCells.Resize(actTable.GetCells().size(), 1);
+
+	actTableThresholds.Import(actTable.GetThresholds(), *stream);
+	actTableValues.Import(actTable.GetValues(), *stream);
+	actTableCells.Import(actTable.GetCells(), *stream);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
 void Layer::Activation(const unsigned long batchFrom, const unsigned long batchTo)
 {
 	verify(engine != NULL);
@@ -460,10 +572,22 @@ void Layer::Activation(const unsigned long batchFrom, const unsigned long batchT
                         break;
 
 		case ACT_SIGMOID:
+			if(actLut == true && UpdateActTable(sig_delta) == true)
+			{
+				engine->FuncStepLookup(stateSub, actSub, actTableThresholds, actTableValues, actTableCells,
+						actTable.GetLo(), actTable.GetInvStep(), *stream);
+				break;
+			}
 			engine->FuncSigmoid(stateSub, actSub, actSub_fixed, *stream, sig_delta);
 			break;
 
 		case ACT_TANH:
+			if(actLut == true && UpdateActTable(tanh_delta) == true)
+			{
+				engine->FuncStepLookup(stateSub, actSub, actTableThresholds, actTableValues, actTableCells,
+						actTable.GetLo(), actTable.GetInvStep(), *stream);
+				break;
+			}
 			engine->FuncTanh(stateSub, actSub, *stream, tanh_delta);
 			break;
 
@@ -479,7 +603,11 @@ void Layer::Activation(const unsigned long batchFrom, const unsigned long batchT
 			}
 			else
 			{
-				engine->FuncRectLinear(stateSub, actSub, actSub_fixed, *stream, 100.0, M_relu,relu_delta_final_decision);
+				/* The calibration range comes with the activation (host engine) */
+				const bool calibrating = (relu_delta_decision == 0 && M_relu != 100);
+
+				engine->FuncRectLinear(stateSub, actSub, actSub_fixed, *stream, 100.0, M_relu,relu_delta_final_decision,
+						calibrating == true ? &min_act : NULL, calibrating == true ? &max_act : NULL);
 					
 			}
 			if(relu_delta_decision == 0 && M_relu != 100)
@@ -678,6 +806,7 @@ void Layer::UpdateState(const unsigned long batchFrom, const unsigned long batch
 	ConnList::const_iterator iter, iter_end;
 	Matrix<FLOAT> stateSub(state, batchFrom, batchTo);
 	Connection *firstConn = NULL;
+	Connection *biasConn = NULL;
 	bool isFirst = true;
 
 	verify((stateType == AGG_DONTCARE) == srcList.empty());
@@ -688,6 +817,13 @@ void Layer::UpdateState(const unsigned long batchFrom, const unsigned long batch
 	{
 		//(*iter)->StreamWaitEvent(*stream);
 
+		if((*iter)->IsFoldedBias() == true)
+		{
+			verify(biasConn == NULL && stateType == AGG_SUM);
+			biasConn = (*iter);
+			continue;
+		}
+
 		if(isFirst == true)
 		{
 			firstConn = (*iter);
@@ -731,7 +867,22 @@ void Layer::UpdateState(const unsigned long batchFrom, const unsigned long batch
 		}
 	}
 
-	if(firstConn != NULL)
+	if(biasConn != NULL)
+	{
+		verify(isFirst == false);
+
+		/* Broadcast bias vector */
+		if(firstConn != NULL)
+		{
+			Matrix<FLOAT> firstSrcSub(firstConn->dstAct, batchFrom, batchTo);
+			engine->MatAddBias(firstSrcSub, biasConn->weights, stateSub, *stream);
+		}
+		else
+		{
+			engine->MatAddBias(stateSub, biasConn->weights, stateSub, *stream);
+		}
+	}
+	else if(firstConn != NULL)
 	{
 		//Matrix<FLOAT> firstSrcSub(firstConn->dstAct, batchFrom, batchTo);
 		//engine->MatCopy(firstSrcSub, stateSub, *stream);
@@ -24,6 +24,7 @@
 
 #include "Engine.h"
 #include "Matrix.h"
+#include "HostAct.h"
 #include "FractalCommon.h"
 
 
@@ -78,6 +79,17 @@ public:
 	inline const std::string &GetName() const { return name; }
 	inline const unsigned long GetSize() const { return size; }
 	inline const unsigned long GetBatchSize() const { return batchSize; }
+	inline const ActType GetActType() const { return actType; }
+	inline const StateType GetStateType() const { return stateType; }
+	inline const LayerSpec &GetSpec() const { return spec; }
+
+	/* Computed by a fused block of the downstream pooling connection (inference only) */
+	inline void SetFused(const bool enable) { fused = enable; }
+	inline const bool IsFused() const { return fused; }
+
+	/* Inference: quantized sigmoid and tanh from a step table of the state (rebuilt when the delta changes) */
+	inline void SetActivationLut(const bool enable) { actLut = enable; }
+	inline const bool GetActivationLut() const { return actLut; }
 
 	void SetBatchSize(const unsigned long batchSize);
 	void SetInitVal(const FLOAT val);
@@ -91,6 +103,16 @@ public:
 	void InitAct(const unsigned long batchFrom, const unsigned long batchTo);
 	void InitErr(const unsigned long batchFrom, const unsigned long batchTo);
 
+	/* Activation checkpoints for recomputation (gradient checkpointing) */
+	void SetCheckpointSize(const unsigned long nCol);
+	void SaveCheckpoint(const unsigned long ckptFrom, const unsigned long batchFrom, const unsigned long batchTo);
+	void LoadCheckpoint(const unsigned long ckptFrom, const unsigned long batchFrom, const unsigned long batchTo);
+
+	/* Dropout masks kept for the recomputation, so that it uses the masks of the first forward pass */
+	void SetDropoutHistorySize(const unsigned long nCol);
+	void SaveDropoutMask(const unsigned long histFrom, const unsigned long batchFrom, const unsigned long batchTo);
+	void LoadDropoutMask(const unsigned long histFrom, const unsigned long batchFrom, const unsigned long batchTo);
+
 	void Forward(const unsigned long batchFrom, const unsigned long batchTo);
 	void Backward(const unsigned long batchFrom, const unsigned long batchTo);
 	
@@ -143,6 +165,7 @@ protected:
 	Layer(const Layer &obj);
 
 	void Activation(const unsigned long batchFrom, const unsigned long batchTo);
+	const bool UpdateActTable(const FLOAT delta);
 	void UpdateState(const unsigned long batchFrom, const unsigned long batchTo);
 
 	void UpdateDstErr(const unsigned long batchFrom, const unsigned long batchTo);
@@ -165,8 +188,16 @@ protected:
 	ConnList dstList;
 
 	Matrix<FLOAT> act_fixed, state_fixed, act, state, srcErr, dstErr;
+	Matrix<FLOAT> actCheckpoint;
+	Matrix<FLOAT> dropoutMaskHistory;
 
 	Probe *linkedProbe;
+	bool fused;
+
+	bool actLut;
+	hostAct::StepTable<FLOAT> actTable;
+	Matrix<FLOAT> actTableThresholds, actTableValues;
+	Matrix<int> actTableCells;
 
 	FLOAT initVal, statePenalty;
         LayerParam param;
@@ -160,6 +160,28 @@ void Matrix<T>::Link(Matrix<T> &src)
 }
 
 
+template<class T>
+void Matrix<T>::Link(Matrix<T> &src, const unsigned long srcOffset)
+{
+    Lock();
+    src.Lock();
+
+    verify(src.mem != NULL);
+    verify(srcOffset + nRows * nCols <= src.nRows * src.nCols);
+
+    Clear();
+
+    mem = src.mem;
+    offset = src.offset + srcOffset;
+    engine = src.engine;
+
+    isSub = true;
+
+    Unlock();
+    src.Unlock();
+}
+
+
 template<class T>
 void Matrix<T>::Unlink()
 {
@@ -392,13 +414,25 @@ void Matrix<T>::Load(const std::string &filename)
     fileStream.read(reinterpret_cast<char *>(&_nCols), sizeof(unsigned int));
     if(isSub == true) verify(_nCols == nCols);
 
-    Resize(_nRows, _nCols);
+    /* A shared matrix is loaded in place; the rest of the memory is pulled to the host first */
+    if(isSub == false)
+        Resize(_nRows, _nCols);
 
     fileStream.read(reinterpret_cast<char *>(&tmp), sizeof(unsigned int));
     verify(tmp == sizeof(T));
 
     if(nRows * nCols > 0)
     {
+        if(isSub == true)
+        {
+            PStream stream;
+
+            engine->StreamCreate(stream, engine->GetHostLoc());
+            HostPull(stream);
+            engine->StreamSynchronize(stream);
+            engine->StreamDestroy(stream);
+        }
+
         fileStream.read(reinterpret_cast<char *>(GetHostData()), sizeof(T) * nRows * nCols);
         HostPush();
     }
@@ -59,6 +59,8 @@ public:
 
     void Resize(const unsigned long nRows, const unsigned long nCols);
     void Link(Matrix<T> &src);
+    /* Share nRows x nCols elements of src from element srcOffset of src (the content is not copied) */
+    void Link(Matrix<T> &src, const unsigned long srcOffset);
     void Unlink();
 
     void Import(const std::vector<T> &vec, PStream &stream);
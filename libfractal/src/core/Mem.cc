@@ -22,6 +22,9 @@
 namespace fractal
 {
 
+std::atomic<unsigned long> Mem::versionCounter(0);
+
+
 Mem::Mem(Engine *const engine, size_t size) : engine(engine)
 {
 	unsigned long i;
@@ -31,6 +34,7 @@ Mem::Mem(Engine *const engine, size_t size) : engine(engine)
 	ptr = new void *[numLoc];
 	valid = new bool[numLoc];
 	this->size = size;
+	version = ++versionCounter;
 
 	for(i = 0; i < numLoc; i++)
 	{
@@ -108,6 +112,7 @@ void Mem::Push(const unsigned long loc)
 		valid[i] = (i == loc);
 
 	recentLoc = loc;
+	version = ++versionCounter;
 
 	Unlock();
 }
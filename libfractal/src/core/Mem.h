@@ -20,6 +20,7 @@
 
 
 #include <mutex>
+#include <atomic>
 
 #include "FractalCommon.h"
 
@@ -45,6 +46,9 @@ public:
     inline const size_t GetSize() const { return size; }
     inline void SetSize(size_t size) { this->size = size; }
 
+    /* Changes whenever the content is written (Push); used to invalidate derived data */
+    inline const unsigned long GetVersion() const { return version; }
+
     void CopyFromHost(const size_t offsetDst, const void *ptrSrc, const size_t size, PStream &stream);
     void CopyToHost(const size_t offsetSrc, void *ptrDst, const size_t size, PStream &stream) const;
 
@@ -65,6 +69,9 @@ protected:
     size_t size;
     void **ptr;
     bool *valid;
+    unsigned long version;
+
+    static std::atomic<unsigned long> versionCounter;
 
     std::recursive_mutex mtx;
 
@@ -20,6 +20,7 @@
 
 
 #include "Rnn.h"
+#include <algorithm>
 #include <sys/stat.h>
 #include <sstream>
 #include <iostream>
@@ -34,13 +35,27 @@ static const long UNTOUCHED = -1;
 static const long TOUCHED = -2;
 static const long SCC_DETERMINED = -3;
 
+/* Alignment of the matrices in a parameter arena (bytes) */
+static const unsigned long PARAM_ARENA_ALIGN = 256;
+
 
 Rnn::Rnn()
 {
 	batchSize = 0;
+	nCheckpoint = checkpointSize = 0;
 	isReady = false;
 	engine = NULL;
 	defaultPStream = NULL;
+	nThread = 1;
+	wavefront = false;
+	biasFolding = true;
+	inferenceFusion = false;
+	poolArgmax = false;
+	activationLut = false;
+	fusedOptimizer = false;
+	compactOptimizerState = false;
+	paramArena = false;
+	taskBatchFrom = taskBatchTo = taskNStream = 0;
 }
 
 
@@ -59,6 +74,13 @@ void Rnn::SetEngine(Engine *engine)
 	ClearPStreams();
 	DestroyDefaultPStream();
 
+	/* The connections get their own memory again below */
+	for(long kind = 0; kind < N_PARAM_KIND; kind++)
+	{
+		arena[kind].Resize(0, 1);
+		arena[kind].SetEngine(engine);
+	}
+
 	this->engine = engine;
 
 	if(engine != NULL) CreateDefaultPStream(1);
@@ -310,294 +332,222 @@ void Rnn::Forward(const unsigned long batchFrom, const unsigned long batchTo, co
 	verify(nStream > 0 && nStream <= batchTo - batchFrom + 1);
 	verify((batchTo - batchFrom + 1) % nStream == 0);
 
-	unsigned long i;
-	long group;
-	bool loopDetected;
+	verify(engine != NULL);
 
-	SccList::const_iterator sccIter, sccIter_end;
-	Scc::const_iterator layerIter, layerIter_end;
-	Layer::ConnList::const_iterator connIter, connIter_end;
+	Ready();
 
-	Scc *scc;
-	Layer *layer;
-	Connection *conn;
+	if(nThread > 1)
+	{
+		taskBatchFrom = batchFrom;
+		taskBatchTo = batchTo;
+		taskNStream = nStream;
+
+		forwardTaskGraph.Run();
+	}
+	else
+	{
+		RunPlan(forwardPlan, batchFrom, batchTo, nStream);
+	}
+}
+
+
+void Rnn::Backward(const unsigned long batchFrom, const unsigned long batchTo, const unsigned long nStream)
+{
+	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
+	verify(nStream > 0 && nStream <= batchTo - batchFrom + 1);
+	verify((batchTo - batchFrom + 1) % nStream == 0);
 
 	verify(engine != NULL);
 
+	/* The activations of the fused layers are not available */
+	verify(inferenceFusion == false);
+	verify(activationLut == false);
+
 	Ready();
 
-	sccIter_end = sccList.end();
-	for(sccIter = sccList.begin(); sccIter != sccIter_end; ++sccIter)
+	if(nThread > 1)
 	{
-		/* Inter-SCC parallel propagation */
+		taskBatchFrom = batchFrom;
+		taskBatchTo = batchTo;
+		taskNStream = nStream;
 
-		scc = *sccIter;
+		backwardTaskGraph.Run();
+	}
+	else
+	{
+		RunPlan(backwardPlan, batchFrom, batchTo, nStream);
+	}
+}
 
-		layerIter_end = scc->end();
-		for(layerIter = scc->begin(); layerIter != layerIter_end; ++layerIter)
-		{
-			layer = *layerIter;
-			group = layer->GetGroup();
 
-			connIter_end = layer->GetSrcConnections().end();
-			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
-			{
-				conn = *connIter;
-				if(conn->GetSrcLayer()->GetGroup() == group) continue;
+static inline void RunPlanOp(const Rnn::PlanOp &op, const unsigned long batchFrom, const unsigned long batchTo,
+		const unsigned long nStream, const bool first, const bool last)
+{
+	const bool wait = first == true && (op.flags & Rnn::PLAN_WAIT) != 0;
+	const bool record = last == true && (op.flags & Rnn::PLAN_RECORD) != 0;
 
-				verify(conn->IsDelayed() == false); /* For now, this may cause a problem */
+	switch(op.type)
+	{
+		case Rnn::PLAN_CONN_FORWARD:
+			if(wait == true) op.conn->ForwardWait();
+			op.conn->Forward(batchFrom, batchTo, nStream);
+			if(record == true) op.conn->EventRecord();
+			break;
+
+		case Rnn::PLAN_LAYER_FORWARD:
+			if(wait == true) op.layer->ForwardWait();
+			op.layer->Forward(batchFrom, batchTo);
+			if(record == true) op.layer->EventRecord();
+			break;
+
+		case Rnn::PLAN_CONN_BACKWARD:
+			if(wait == true) op.conn->BackwardWait();
+			op.conn->UpdateDstErr(batchFrom, batchTo);
+			if((op.flags & Rnn::PLAN_PROPAGATE) != 0)
+				op.conn->Backward(batchFrom, batchTo, nStream);
+			if(record == true) op.conn->EventRecord();
+			break;
+
+		case Rnn::PLAN_LAYER_BACKWARD:
+			if(wait == true) op.layer->BackwardWait();
+			op.layer->Backward(batchFrom, batchTo);
+			if(record == true) op.layer->EventRecord();
+			break;
+
+		default:
+			verify(false);
+	}
+}
 
-				/* Inter-SCC connection */
-				conn->ForwardWait();
-				conn->Forward(batchFrom, batchTo, nStream);
-				conn->EventRecord();
-			}
-		}
 
-		/* Intra-SCC propagation */
+static void RunPlanLoop(const Rnn::PlanOp *op, const unsigned long batchFrom, const unsigned long batchTo,
+		const unsigned long nStream)
+{
+	/* Sequential propagation of the per-step ops that follow a PLAN_LOOP op */
 
-		/* Check if there are loops inside the scc */
-		if(scc->size() == 1)
-		{
-			loopDetected = false;
-			layer = scc->front();
-			group = layer->GetGroup();
+	long i;
+	const Rnn::PlanOp *stepOp, *stepOp_end;
 
-			connIter_end = layer->GetSrcConnections().end();
-			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
-			{
-				conn = *connIter;
-				if(conn->GetSrcLayer()->GetGroup() == group)
-				{
-					/* Intra-SCC connection */
-					loopDetected = true;
-					break;
-				}
-			}
-		}
-		else
-		{
-			loopDetected = true;
-		}
+	verify(op->type == Rnn::PLAN_LOOP);
 
-		if(loopDetected == true)
+	stepOp_end = op + 1 + op->nStep;
+
+	if((op->flags & Rnn::PLAN_REVERSE) == 0)
+	{
+		for(i = (long) batchFrom; i <= (long) batchTo; i += nStream)
 		{
-			/* Sequential propagation */
-			for(i = batchFrom; i <= batchTo; i += nStream)
+			for(stepOp = op + 1; stepOp != stepOp_end; ++stepOp)
 			{
-				/* Delayed connection */
-				layerIter_end = scc->end();
-				for(layerIter = scc->begin(); layerIter != layerIter_end; ++layerIter)
-				{
-					layer = *layerIter;
-					group = layer->GetGroup();
-
-					connIter_end = layer->GetSrcConnections().end();
-					for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
-					{
-						conn = *connIter;
-						if(conn->GetSrcLayer()->GetGroup() != group) continue;
-						if(conn->IsDelayed() == false) continue;
-
-						/* Intra-SCC connection */
-						if(i == batchFrom) conn->ForwardWait();
-						conn->Forward(i, i + nStream - 1, nStream);
-						if(i + nStream > batchTo) conn->EventRecord();
-					}
-				}
-
-				/* Non-delayed connection */
-				layerIter_end = scc->end();
-				for(layerIter = scc->begin(); layerIter != layerIter_end; ++layerIter)
-				{
-					layer = *layerIter;
-					group = layer->GetGroup();
-
-					connIter_end = layer->GetSrcConnections().end();
-					for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
-					{
-						conn = *connIter;
-						if(conn->GetSrcLayer()->GetGroup() != group) continue;
-						if(conn->IsDelayed() == true) continue;
-
-						/* Intra-SCC connection */
-						//if(i == batchFrom) conn->ForwardWait();
-						conn->Forward(i, i + nStream - 1, nStream);
-						//if(i + nStream > batchTo) conn->EventRecord();
-					}
-
-					/* Intra-SCC layer activation */
-					if(i == batchFrom) layer->ForwardWait();
-					layer->Forward(i, i + nStream - 1);
-					if(i + nStream > batchTo) layer->EventRecord();
-				}
+				RunPlanOp(*stepOp, i, i + nStream - 1, nStream,
+						i == (long) batchFrom, i + nStream > batchTo);
 			}
 		}
-		else /* Loop not detected */
+	}
+	else
+	{
+		for(i = (long) batchTo; i >= (long) batchFrom; i -= nStream)
 		{
-			/* Parallel activation */
-			layer->ForwardWait();
-			layer->Forward(batchFrom, batchTo);
-			layer->EventRecord();
+			for(stepOp = op + 1; stepOp != stepOp_end; ++stepOp)
+			{
+				RunPlanOp(*stepOp, i - nStream + 1, i, nStream,
+						i == (long) batchTo, i < (long) (batchFrom + nStream));
+			}
 		}
 	}
 }
 
 
-void Rnn::Backward(const unsigned long batchFrom, const unsigned long batchTo, const unsigned long nStream)
+static void RunWavefront(const Rnn::PlanOp *op, const unsigned long batchFrom, const unsigned long batchTo,
+		const unsigned long nStream, const unsigned long nThread)
 {
-	verify(batchFrom >= 0 && batchTo < batchSize && batchFrom <= batchTo);
-	verify(nStream > 0 && nStream <= batchTo - batchFrom + 1);
-	verify((batchTo - batchFrom + 1) % nStream == 0);
-
-	long i;
-	long group;
-	bool loopDetected;
+	/* A stage is a run of inter-SCC connection ops followed by a loop (or a loop-free layer) */
+	/* Stage k processes step d - k on the d-th diagonal, so the stages of one diagonal are independent */
+	/* Each layer and connection has a single event, so the stages of a diagonal are issued in
+	 * descending order: stage k + 1 waits for the event of stage k (step d - k - 1, recorded on the
+	 * previous diagonal) before stage k records it again for step d - k. Issuing in ascending order
+	 * would make every stage wait for the newest step of the one before it and serialize them. */
+	/* With CUDA, the issue order matters and the stages are issued by one thread;
+	 * the streams of the stages run concurrently on the device */
+
+	long d, k, t, nT, nStage, kFrom, kTo;
+	const Rnn::PlanOp *p, *p_end, *begin;
+	std::vector<const Rnn::PlanOp *> stageBegin, stageEnd;
+
+	verify(op->type == Rnn::PLAN_WAVEFRONT);
+
+	p_end = op + 1 + op->nStep;
+	begin = op + 1;
+	for(p = op + 1; p != p_end; ++p)
+	{
+		if(p->type == Rnn::PLAN_CONN_FORWARD || p->type == Rnn::PLAN_CONN_BACKWARD) continue;
 
-	SccList::const_reverse_iterator sccIter, sccIter_end;
-	Scc::const_reverse_iterator layerIter, layerIter_end;
-	Layer::ConnList::const_iterator connIter, connIter_end;
+		if(p->type == Rnn::PLAN_LOOP) p += p->nStep;
 
-	Scc *scc;
-	Layer *layer;
-	Connection *conn;
-        
-	verify(engine != NULL);
+		stageBegin.push_back(begin);
+		stageEnd.push_back(p + 1);
+		begin = p + 1;
+	}
+	verify(begin == p_end);
 
-	Ready();
+	nStage = stageBegin.size();
+	nT = (batchTo - batchFrom + 1) / nStream;
 
-	sccIter_end = sccList.rend();
-	for(sccIter = sccList.rbegin(); sccIter != sccIter_end; ++sccIter)
+	for(d = 0; d < nT + nStage - 1; d++)
 	{
-		/* Inter-SCC parallel propagation */
+		kFrom = d >= nT ? d - nT + 1 : 0;
+		kTo = d < nStage - 1 ? d : nStage - 1;
 
-		scc = *sccIter;
-
-		layerIter_end = scc->rend();
-		for(layerIter = scc->rbegin(); layerIter != layerIter_end; ++layerIter)
+#if defined(FRACTAL_USE_OMP) && !defined(FRACTAL_USE_CUDA)
+		#pragma omp parallel for private(t, p) if(nThread > 1)
+#endif
+		for(k = kTo; k >= kFrom; k--)
 		{
-			layer = *layerIter;
-			group = layer->GetGroup();
+			unsigned long from, to;
 
-			connIter_end = layer->GetDstConnections().end();
-			for(connIter = layer->GetDstConnections().begin(); connIter != connIter_end; ++connIter)
-			{
-				conn = *connIter;
-				if(conn->GetDstLayer()->GetGroup() == group) continue;
+			t = d - k;
 
-				verify(conn->IsDelayed() == false); /* For now, this may cause a problem */
+			if((op->flags & Rnn::PLAN_REVERSE) == 0)
+				from = batchFrom + t * nStream;
+			else
+				from = batchTo - (t + 1) * nStream + 1;
+			to = from + nStream - 1;
 
-				/* Inter-SCC connection */
-				conn->BackwardWait();
-				conn->UpdateDstErr(batchFrom, batchTo);
-                                //if(conn->spec.connType == 2)
-                                  //  printf("conv : %d\n",layer->GetSrcConnections().empty());
-                                //else 
-                                 //   printf("full : %d\n",layer->GetSrcConnections().empty());
-                                    //if(layer->GetSrcConnections().empty() == false && layer->IsLinked() == false)
-				if((layer->GetSrcConnections().empty() == false))
-					conn->Backward(batchFrom, batchTo, nStream);
-				conn->EventRecord();
+			/* Events are waited and recorded on every step since the stages advance together */
+			for(p = stageBegin[k]; p != stageEnd[k]; ++p)
+			{
+				if(p->type != Rnn::PLAN_LOOP)
+					RunPlanOp(*p, from, to, nStream, true, true);
 			}
 		}
+	}
+}
 
-		/* Intra-SCC propagation */
 
-		/* Check if there are loops inside the scc */
-		if(scc->size() == 1)
-		{
-			loopDetected = false;
-			layer = scc->front();
-			group = layer->GetGroup();
+void Rnn::RunPlan(const Plan &plan, const unsigned long batchFrom, const unsigned long batchTo, const unsigned long nStream)
+{
+	const PlanOp *op, *op_end;
 
-			connIter_end = layer->GetDstConnections().end();
-			for(connIter = layer->GetDstConnections().begin(); connIter != connIter_end; ++connIter)
-			{
-				conn = *connIter;
-				if(conn->GetDstLayer()->GetGroup() == group)
-				{
-					/* Intra-SCC connection */
-					loopDetected = true;
-					break;
-				}
-			}
-		}
-		else
+	op_end = plan.data() + plan.size();
+	for(op = plan.data(); op != op_end; ++op)
+	{
+		if(op->type == PLAN_LOOP)
 		{
-			loopDetected = true;
-		}
+			verify(op + op->nStep < op_end);
 
-		if(loopDetected == true)
+			RunPlanLoop(op, batchFrom, batchTo, nStream);
+			op += op->nStep;
+		}
+		else if(op->type == PLAN_WAVEFRONT)
 		{
-			/* Sequential propagation */
-			for(i = batchTo; i >= (long) batchFrom; i -= nStream)
-			{
-				/* Non-delayed connection */
-				layerIter_end = scc->rend();
-				for(layerIter = scc->rbegin(); layerIter != layerIter_end; ++layerIter)
-				{
-					layer = *layerIter;
-					if(layer->GetSrcConnections().empty() == true) continue;
-					group = layer->GetGroup();
-
-					/* Intra-SCC layer activation */
-					//if(layer->IsLinked() == false)
-					if(i == (long) batchTo) layer->BackwardWait();
-					layer->Backward(i - nStream + 1, i);
-					if(i < (long) (batchFrom + nStream)) layer->EventRecord();
-
-					connIter_end = layer->GetSrcConnections().end();
-					for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
-					{
-						conn = *connIter;
-						if(conn->GetSrcLayer()->GetGroup() != group) continue;
-						if(conn->IsDelayed() == true) continue;
-
-						/* Intra-SCC connection */
-						//if(i == batchTo) conn->BackwardWait();
-						conn->UpdateDstErr(i - nStream + 1, i);
-						//if(conn->GetSrcLayer()->GetSrcConnections().empty() == false && conn->GetSrcLayer()->IsLinked() == false)
-						if(conn->GetSrcLayer()->GetSrcConnections().empty() == false)
-							conn->Backward(i - nStream + 1, i, nStream);
-						//if(i < batchFrom + nStream) conn->EventRecord();
-					}
-				}
+			verify(op + op->nStep < op_end);
 
-				/* Delayed connection */
-				layerIter_end = scc->rend();
-				for(layerIter = scc->rbegin(); layerIter != layerIter_end; ++layerIter)
-				{
-					layer = *layerIter;
-					group = layer->GetGroup();
-
-					connIter_end = layer->GetSrcConnections().end();
-					for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
-					{
-						conn = *connIter;
-						if(conn->GetSrcLayer()->GetGroup() != group) continue;
-						if(conn->IsDelayed() == false) continue;
-
-						/* Intra-SCC connection */
-						//if(i == batchTo) conn->BackwardWait();
-						conn->UpdateDstErr(i - nStream + 1, i);
-						//if(conn->GetSrcLayer()->GetSrcConnections().empty() == false && conn->GetSrcLayer()->IsLinked() == false)
-						if(conn->GetSrcLayer()->GetSrcConnections().empty() == false)
-							conn->Backward(i - nStream + 1, i, nStream);
-						if(i < (long) (batchFrom + nStream)) conn->EventRecord();
-					}
-				}
-			}
+			RunWavefront(op, batchFrom, batchTo, nStream, nThread);
+			op += op->nStep;
 		}
-		else /* Loop not detected */
+		else
 		{
-			/* Parallel activation */
-			//if(layer->GetSrcConnections().empty() == false && layer->IsLinked() == false)
-			if(layer->GetSrcConnections().empty() == false)
-			{
-				layer->BackwardWait();
-				layer->Backward(batchFrom, batchTo);
-				layer->EventRecord();
-			}
+			/* Parallel propagation over the whole batch */
+			RunPlanOp(*op, batchFrom, batchTo, nStream, true, true);
 		}
 	}
 }
@@ -624,6 +574,14 @@ void Rnn::UpdateWeights(const unsigned long batchFrom, const unsigned long batch
 	verify(isReady == true);
 	verify(engine != NULL);
 
+	verify(compactOptimizerState == false || fusedOptimizer == true);
+
+	if(fusedOptimizer == true)
+	{
+		FusedUpdateWeights(batchFrom, batchTo, rate, momentum, adaptiveRates, rmsprop);
+		return;
+	}
+
 	iter_end = connSet.end();
 	for(iter = connSet.begin(); iter != iter_end; ++iter)
 	{
@@ -631,95 +589,414 @@ void Rnn::UpdateWeights(const unsigned long batchFrom, const unsigned long batch
 	}
 }
 
-void Rnn::EnableDropout(const bool enable)
-{
-    LayerMap::const_iterator iter, iter_end;
-
-    iter_end = layerMap.end();
-    for(iter = layerMap.begin(); iter != iter_end; ++iter)
-    {    
-        iter->second->EnableDropout(enable);
-    }    
-}
-
 
-void Rnn::GenerateDropoutMask(const unsigned long batchFrom, const unsigned long batchTo)
+void Rnn::FusedUpdateWeights(const unsigned long batchFrom, const unsigned long batchTo,
+		const FLOAT rate, const FLOAT momentum, const bool adaptiveRates, const bool rmsprop)
 {
-    LayerMap::const_iterator iter, iter_end;
+	ConnSet::const_iterator iter, iter_end;
+	std::vector<OptTensor> tensors;
+	std::vector<Connection *> updated;
+	std::vector<Connection *>::const_iterator connIter, connIter_end;
+	OptTensor tensor;
 
-    iter_end = layerMap.end();
-    for(iter = layerMap.begin(); iter != iter_end; ++iter)
-    {    
-        iter->second->GenerateDropoutMask(batchFrom, batchTo);
-    }    
-}
+	/* Gradients on the stream of each connection */
+	iter_end = connSet.end();
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
+	{
+		(*iter)->ComputeGradient(batchFrom, batchTo);
+	}
 
-void Rnn::Ready()
-{
-	if(isReady == true) return;
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
+	{
+		if((*iter)->GetOptTensor(tensor, rate, momentum, adaptiveRates, rmsprop) == false) continue;
 
-	verify(layerMap.empty() == false);
-	verify(engine != NULL);
+		tensors.push_back(tensor);
+		updated.push_back(*iter);
 
+		(*iter)->EventRecord();
+		(*iter)->StreamWaitEvent(*defaultPStream);
+	}
 
-	LayerMap::const_iterator layerIter, layerIter_end;
-	ConnSet::const_iterator connIter, connIter_end;
+	if(tensors.empty() == true) return;
 
+	engine->FusedUpdate(tensors, *defaultPStream);
+	engine->EventRecord(updateEvent, *defaultPStream);
 
-	layerIter_end = layerMap.end();
-	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	connIter_end = updated.end();
+	for(connIter = updated.begin(); connIter != connIter_end; ++connIter)
 	{
-		layerIter->second->UnlinkMatrices();
+		engine->StreamWaitEvent((*connIter)->GetPStream(), updateEvent);
+		(*connIter)->FinishUpdate();
 	}
+}
 
-	connIter_end = connSet.end();
-	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+void Rnn::AccumulateGradients(const unsigned long batchFrom, const unsigned long batchTo)
+{
+	ConnSet::const_iterator iter, iter_end;
+
+	verify(isReady == true);
+	verify(engine != NULL);
+
+	iter_end = connSet.end();
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
 	{
-		(*connIter)->UnlinkMatrices();
+		(*iter)->AccumulateGradient(batchFrom, batchTo);
 	}
+}
 
 
-	Tarjan();
-	ClearPStreams();
-	CreatePStreams(1);
+const unsigned long Rnn::GetMaxDelay() const
+{
+	ConnSet::const_iterator iter, iter_end;
+	unsigned long maxDelay = 0;
 
-	isReady = true;
+	iter_end = connSet.end();
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
+	{
+		maxDelay = std::max(maxDelay, (*iter)->GetDelayAmount());
+	}
+
+	return maxDelay;
 }
 
 
-void Rnn::Tarjan()
+void Rnn::SetCheckpoint(const unsigned long nCheckpoint, const unsigned long nCol)
 {
-	/* Tarjan's Algorithm (non-recursive) */
-	/* Find strongly connected components and perform topological sort */
+	/* Each checkpoint holds the last nCol columns of the source layers of the delayed connections,
+	 * which is all the state needed to resume the forward pass from the beginning of a segment */
 
-	long index, group;
-	Layer *v, *w;
-	std::stack<Layer *> dfsStack, sccStack;
+	/* The dropout masks of nCheckpoint whole segments are kept as well, since the recomputed
+	 * segments must use the masks of the forward pass that produced the checkpoints */
+
+	ConnSet::const_iterator iter, iter_end;
 	LayerMap::const_iterator layerIter, layerIter_end;
-	Layer::ConnList::const_iterator connIter, connIter_end;
 
+	verify(nCol <= batchSize);
 
-	ClearSccList();
+	this->nCheckpoint = nCheckpoint;
+	this->checkpointSize = nCol;
 
-	/* Initialize flags */
+	iter_end = connSet.end();
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
+	{
+		if((*iter)->IsDelayed() == true)
+			(*iter)->GetSrcLayer()->SetCheckpointSize(nCheckpoint * nCol);
+	}
 
 	layerIter_end = layerMap.end();
 	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
 	{
-		layerIter->second->SetVisited(false);
-		layerIter->second->SetIndex(UNTOUCHED);
+		layerIter->second->SetDropoutHistorySize(nCheckpoint * batchSize);
 	}
+}
 
 
-	index = 0;
-	group = 0;
+void Rnn::SaveCheckpoint(const unsigned long idx)
+{
+	ConnSet::const_iterator iter, iter_end;
+	std::unordered_set<Layer *> visited;
 
-	layerIter_end = layerMap.end();
-	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	verify(idx < nCheckpoint);
+
+	if(checkpointSize == 0) return;
+
+	iter_end = connSet.end();
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
 	{
-		if(layerIter->second->GetVisited() == true) continue;
+		if((*iter)->IsDelayed() == false) continue;
 
-		/* Strong conenct: depth first search */
+		Layer *layer = (*iter)->GetSrcLayer();
+		if(visited.insert(layer).second == false) continue;
+
+		layer->SaveCheckpoint(idx * checkpointSize, batchSize - checkpointSize, batchSize - 1);
+		layer->EventRecord();
+	}
+}
+
+
+void Rnn::LoadCheckpoint(const unsigned long idx)
+{
+	ConnSet::const_iterator iter, iter_end;
+	std::unordered_set<Layer *> visited;
+
+	verify(idx < nCheckpoint);
+
+	if(checkpointSize == 0) return;
+
+	/* The activations to be overwritten may still be in use by the previous segment */
+	Synchronize();
+
+	iter_end = connSet.end();
+	for(iter = connSet.begin(); iter != iter_end; ++iter)
+	{
+		if((*iter)->IsDelayed() == false) continue;
+
+		Layer *layer = (*iter)->GetSrcLayer();
+		if(visited.insert(layer).second == false) continue;
+
+		layer->LoadCheckpoint(idx * checkpointSize, batchSize - checkpointSize, batchSize - 1);
+		layer->EventRecord();
+	}
+}
+
+
+void Rnn::SaveDropoutMask(const unsigned long idx)
+{
+	LayerMap::const_iterator iter, iter_end;
+
+	verify(idx < nCheckpoint);
+
+	iter_end = layerMap.end();
+	for(iter = layerMap.begin(); iter != iter_end; ++iter)
+	{
+		iter->second->SaveDropoutMask(idx * batchSize, 0, batchSize - 1);
+	}
+}
+
+
+void Rnn::LoadDropoutMask(const unsigned long idx)
+{
+	LayerMap::const_iterator iter, iter_end;
+
+	verify(idx < nCheckpoint);
+
+	iter_end = layerMap.end();
+	for(iter = layerMap.begin(); iter != iter_end; ++iter)
+	{
+		iter->second->LoadDropoutMask(idx * batchSize, 0, batchSize - 1);
+	}
+}
+
+
+void Rnn::EnableDropout(const bool enable)
+{
+    LayerMap::const_iterator iter, iter_end;
+
+    iter_end = layerMap.end();
+    for(iter = layerMap.begin(); iter != iter_end; ++iter)
+    {    
+        iter->second->EnableDropout(enable);
+    }    
+}
+
+
+void Rnn::GenerateDropoutMask(const unsigned long batchFrom, const unsigned long batchTo)
+{
+    LayerMap::const_iterator iter, iter_end;
+
+    iter_end = layerMap.end();
+    for(iter = layerMap.begin(); iter != iter_end; ++iter)
+    {    
+        iter->second->GenerateDropoutMask(batchFrom, batchTo);
+    }    
+}
+
+void Rnn::Ready()
+{
+	if(isReady == true) return;
+
+	verify(layerMap.empty() == false);
+	verify(engine != NULL);
+
+
+	LayerMap::const_iterator layerIter, layerIter_end;
+	ConnSet::const_iterator connIter, connIter_end;
+
+
+	ReleaseParamArena();
+
+	layerIter_end = layerMap.end();
+	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	{
+		layerIter->second->UnlinkMatrices();
+	}
+
+	connIter_end = connSet.end();
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		(*connIter)->UnlinkMatrices();
+	}
+
+
+	FoldBiases();
+	FuseConvBlocks();
+	ApplyPoolArgmax();
+
+	layerIter_end = layerMap.end();
+	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	{
+		layerIter->second->SetActivationLut(activationLut);
+	}
+
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		(*connIter)->SetCompactState(compactOptimizerState);
+	}
+
+	if(paramArena == true) CreateParamArena();
+
+	Tarjan();
+	CompilePlan();
+	ClearPStreams();
+	CreatePStreams(1);
+
+	isReady = true;
+}
+
+
+void Rnn::CreateParamArena()
+{
+	/* Each matrix starts at a multiple of PARAM_ARENA_ALIGN bytes */
+	const unsigned long align = PARAM_ARENA_ALIGN / sizeof(FLOAT);
+
+	ConnSet::const_iterator iter, iter_end;
+	Matrix<FLOAT> *mat;
+	unsigned long size, offset;
+
+	Synchronize();
+	engine->StreamSynchronize(*defaultPStream);
+
+	iter_end = connSet.end();
+
+	for(long kind = 0; kind < N_PARAM_KIND; kind++)
+	{
+		size = 0;
+		for(iter = connSet.begin(); iter != iter_end; ++iter)
+		{
+			mat = (*iter)->GetParamMatrix((ParamKind) kind);
+			if(mat == NULL) continue;
+
+			size += (mat->GetNumRows() * mat->GetNumCols() + align - 1) / align * align;
+		}
+
+		if(size == 0) continue;
+
+		arena[kind].Resize(size, 1);
+
+		/* Copy the current content into the arena */
+		offset = 0;
+		for(iter = connSet.begin(); iter != iter_end; ++iter)
+		{
+			mat = (*iter)->GetParamMatrix((ParamKind) kind);
+			if(mat == NULL) continue;
+
+			/* Nothing to copy if the matrix has never been written */
+			if(mat->GetMem()->IsValid(mat->GetMem()->GetRecentLoc()) == true)
+			{
+				Matrix<FLOAT> view(mat->GetNumRows(), mat->GetNumCols());
+				view.Link(arena[kind], offset);
+				mat->Export(view, *defaultPStream);
+			}
+
+			offset += (mat->GetNumRows() * mat->GetNumCols() + align - 1) / align * align;
+		}
+	}
+
+	engine->StreamSynchronize(*defaultPStream);
+
+	/* Replace the memory of the matrices with the views */
+	for(long kind = 0; kind < N_PARAM_KIND; kind++)
+	{
+		if(arena[kind].GetNumRows() == 0) continue;
+
+		offset = 0;
+		for(iter = connSet.begin(); iter != iter_end; ++iter)
+		{
+			mat = (*iter)->GetParamMatrix((ParamKind) kind);
+			if(mat == NULL) continue;
+
+			mat->Link(arena[kind], offset);
+
+			offset += (mat->GetNumRows() * mat->GetNumCols() + align - 1) / align * align;
+		}
+	}
+}
+
+
+void Rnn::ReleaseParamArena()
+{
+	/* Give the matrices their own memory again, keeping the content */
+
+	ConnSet::const_iterator iter, iter_end;
+	Matrix<FLOAT> *mat;
+	unsigned long offset;
+	bool valid;
+
+	if(engine == NULL) return;
+
+	Synchronize();
+	engine->StreamSynchronize(*defaultPStream);
+
+	iter_end = connSet.end();
+
+	for(long kind = 0; kind < N_PARAM_KIND; kind++)
+	{
+		if(arena[kind].GetNumRows() == 0) continue;
+
+		valid = arena[kind].GetMem()->IsValid(arena[kind].GetMem()->GetRecentLoc());
+
+		for(iter = connSet.begin(); iter != iter_end; ++iter)
+		{
+			mat = (*iter)->GetParamMatrix((ParamKind) kind);
+
+			/* Skip the matrices resized after the arena was created */
+			if(mat == NULL || mat->GetMem() != arena[kind].GetMem()) continue;
+
+			offset = mat->GetOffset();
+
+			mat->Unlink();
+
+			if(valid == true)
+			{
+				Matrix<FLOAT> view(mat->GetNumRows(), mat->GetNumCols());
+				view.Link(arena[kind], offset);
+				mat->Import(view, *defaultPStream);
+			}
+		}
+	}
+
+	engine->StreamSynchronize(*defaultPStream);
+
+	for(long kind = 0; kind < N_PARAM_KIND; kind++)
+	{
+		arena[kind].Resize(0, 1);
+	}
+}
+
+
+void Rnn::Tarjan()
+{
+	/* Tarjan's Algorithm (non-recursive) */
+	/* Find strongly connected components and perform topological sort */
+
+	long index, group;
+	Layer *v, *w;
+	std::stack<Layer *> dfsStack, sccStack;
+	LayerMap::const_iterator layerIter, layerIter_end;
+	Layer::ConnList::const_iterator connIter, connIter_end;
+
+
+	ClearSccList();
+
+	/* Initialize flags */
+
+	layerIter_end = layerMap.end();
+	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	{
+		layerIter->second->SetVisited(false);
+		layerIter->second->SetIndex(UNTOUCHED);
+	}
+
+
+	index = 0;
+	group = 0;
+
+	layerIter_end = layerMap.end();
+	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	{
+		if(layerIter->second->GetVisited() == true) continue;
+
+		/* Strong conenct: depth first search */
 
 		dfsStack.push(layerIter->second);
 
@@ -790,79 +1067,553 @@ Rnn::Scc *const Rnn::CreateScc(std::stack<Layer *> &sccStack, const Layer *const
 	Layer::ConnList::const_iterator connIter, connIter_end;
 
 
-	printf("%ld: ", group);
+	printf("%ld: ", group);
+
+	scc = new Scc;
+
+	do
+	{
+		v = sccStack.top();
+		sccStack.pop();
+
+		v->SetIndex(UNTOUCHED);
+		v->SetGroup(group);
+		v->SetVisited(false);
+
+		sccLayerList.push_front(v);
+	} while(v != root);
+
+
+	layerIter_end = sccLayerList.end();
+	for(layerIter = sccLayerList.begin(); layerIter != layerIter_end; ++layerIter)
+	{
+		if((*layerIter)->GetVisited() == true) continue;
+		
+
+		/* Depth first search */
+
+		dfsStack.push(*layerIter);
+
+		while(dfsStack.empty() == false)
+		{
+			v = dfsStack.top();
+
+			if(v->GetIndex() == UNTOUCHED)
+			{
+				v->SetIndex(TOUCHED);
+
+				const Layer::ConnList srcConnList = v->GetSrcConnections();
+
+				connIter_end = srcConnList.end();
+				for(connIter = srcConnList.begin(); connIter != connIter_end; ++connIter)
+				{
+					if((*connIter)->IsDelayed() == true) continue;
+
+					w = (*connIter)->GetSrcLayer();
+
+					if(w->GetIndex() == UNTOUCHED)
+						dfsStack.push(w);
+					else if(w->GetIndex() == TOUCHED)
+					{  /* Loop detected */
+						fprintf(stderr, "\nLoop detected !!\n");
+						verify(false);
+					}
+				}
+
+				continue;
+			}
+
+			dfsStack.pop();
+			if(v->GetVisited() == true) continue;
+
+			v->SetIndex(SCC_DETERMINED);
+
+			/* Post visit */
+
+			scc->push_back(v);
+			printf("%s ", v->GetName().c_str());
+
+			v->SetVisited(true);
+		}
+	}
+
+	printf("\n");
+
+	return scc;
+}
+
+
+const bool Rnn::IsLoop(const Scc *const scc) const
+{
+	Layer *layer;
+	long group;
+	Layer::ConnList::const_iterator connIter, connIter_end;
+
+	if(scc->size() != 1) return true;
+
+	layer = scc->front();
+	group = layer->GetGroup();
+
+	connIter_end = layer->GetSrcConnections().end();
+	for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
+	{
+		/* Intra-SCC connection */
+		if((*connIter)->GetSrcLayer()->GetGroup() == group) return true;
+	}
+
+	return false;
+}
+
+
+void Rnn::CompilePlan()
+{
+	/* Lower the SCC list into flat op arrays for Forward() and Backward() */
+	/* Group membership, loop detection and the propagation conditions are resolved here once */
+
+	long group;
+	bool loopDetected;
+	unsigned long loopIdx;
+
+	SccList::const_iterator sccIter, sccIter_end;
+	SccList::const_reverse_iterator sccRIter, sccRIter_end;
+	Scc::const_iterator layerIter, layerIter_end;
+	Scc::const_reverse_iterator layerRIter, layerRIter_end;
+	Layer::ConnList::const_iterator connIter, connIter_end;
+
+	Scc *scc;
+	Layer *layer;
+	Connection *conn;
+	PlanOp op;
+
+	forwardPlan.clear();
+	backwardPlan.clear();
+
+
+	/* Forward plan */
+
+	sccIter_end = sccList.end();
+	for(sccIter = sccList.begin(); sccIter != sccIter_end; ++sccIter)
+	{
+		scc = *sccIter;
+
+		/* Inter-SCC connections */
+		layerIter_end = scc->end();
+		for(layerIter = scc->begin(); layerIter != layerIter_end; ++layerIter)
+		{
+			layer = *layerIter;
+			group = layer->GetGroup();
+
+			connIter_end = layer->GetSrcConnections().end();
+			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
+			{
+				conn = *connIter;
+				if(conn->GetSrcLayer()->GetGroup() == group) continue;
+
+				verify(conn->IsDelayed() == false); /* For now, this may cause a problem */
+
+				op.type = PLAN_CONN_FORWARD;
+				op.flags = PLAN_WAIT | PLAN_RECORD;
+				op.layer = NULL;
+				op.conn = conn;
+				op.nStep = 0;
+				forwardPlan.push_back(op);
+			}
+		}
+
+		loopDetected = IsLoop(scc);
+
+		if(loopDetected == false)
+		{
+			/* Parallel activation */
+			op.type = PLAN_LAYER_FORWARD;
+			op.flags = PLAN_WAIT | PLAN_RECORD;
+			op.layer = scc->front();
+			op.conn = NULL;
+			op.nStep = 0;
+			forwardPlan.push_back(op);
+
+			continue;
+		}
+
+		/* Sequential propagation */
+		loopIdx = forwardPlan.size();
+
+		op.type = PLAN_LOOP;
+		op.flags = 0;
+		op.layer = NULL;
+		op.conn = NULL;
+		op.nStep = 0;
+		forwardPlan.push_back(op);
+
+		/* Delayed connections */
+		layerIter_end = scc->end();
+		for(layerIter = scc->begin(); layerIter != layerIter_end; ++layerIter)
+		{
+			layer = *layerIter;
+			group = layer->GetGroup();
+
+			connIter_end = layer->GetSrcConnections().end();
+			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
+			{
+				conn = *connIter;
+				if(conn->GetSrcLayer()->GetGroup() != group) continue;
+				if(conn->IsDelayed() == false) continue;
+
+				op.type = PLAN_CONN_FORWARD;
+				op.flags = PLAN_WAIT | PLAN_RECORD;
+				op.layer = NULL;
+				op.conn = conn;
+				forwardPlan.push_back(op);
+			}
+		}
+
+		/* Non-delayed connections and layer activations */
+		layerIter_end = scc->end();
+		for(layerIter = scc->begin(); layerIter != layerIter_end; ++layerIter)
+		{
+			layer = *layerIter;
+			group = layer->GetGroup();
+
+			connIter_end = layer->GetSrcConnections().end();
+			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
+			{
+				conn = *connIter;
+				if(conn->GetSrcLayer()->GetGroup() != group) continue;
+				if(conn->IsDelayed() == true) continue;
+
+				op.type = PLAN_CONN_FORWARD;
+				op.flags = 0;
+				op.layer = NULL;
+				op.conn = conn;
+				forwardPlan.push_back(op);
+			}
+
+			op.type = PLAN_LAYER_FORWARD;
+			op.flags = PLAN_WAIT | PLAN_RECORD;
+			op.layer = layer;
+			op.conn = NULL;
+			forwardPlan.push_back(op);
+		}
+
+		forwardPlan[loopIdx].nStep = forwardPlan.size() - loopIdx - 1;
+	}
+
+
+	/* Backward plan */
+
+	sccRIter_end = sccList.rend();
+	for(sccRIter = sccList.rbegin(); sccRIter != sccRIter_end; ++sccRIter)
+	{
+		scc = *sccRIter;
+
+		/* Inter-SCC connections */
+		layerRIter_end = scc->rend();
+		for(layerRIter = scc->rbegin(); layerRIter != layerRIter_end; ++layerRIter)
+		{
+			layer = *layerRIter;
+			group = layer->GetGroup();
+
+			connIter_end = layer->GetDstConnections().end();
+			for(connIter = layer->GetDstConnections().begin(); connIter != connIter_end; ++connIter)
+			{
+				conn = *connIter;
+				if(conn->GetDstLayer()->GetGroup() == group) continue;
+
+				verify(conn->IsDelayed() == false); /* For now, this may cause a problem */
+
+				op.type = PLAN_CONN_BACKWARD;
+				op.flags = PLAN_WAIT | PLAN_RECORD;
+				if(layer->GetSrcConnections().empty() == false) op.flags |= PLAN_PROPAGATE;
+				op.layer = NULL;
+				op.conn = conn;
+				op.nStep = 0;
+				backwardPlan.push_back(op);
+			}
+		}
+
+		loopDetected = IsLoop(scc);
+
+		if(loopDetected == false)
+		{
+			/* Parallel activation */
+			layer = scc->front();
+			if(layer->GetSrcConnections().empty() == true) continue;
+
+			op.type = PLAN_LAYER_BACKWARD;
+			op.flags = PLAN_WAIT | PLAN_RECORD;
+			op.layer = layer;
+			op.conn = NULL;
+			op.nStep = 0;
+			backwardPlan.push_back(op);
+
+			continue;
+		}
+
+		/* Sequential propagation */
+		loopIdx = backwardPlan.size();
+
+		op.type = PLAN_LOOP;
+		op.flags = PLAN_REVERSE;
+		op.layer = NULL;
+		op.conn = NULL;
+		op.nStep = 0;
+		backwardPlan.push_back(op);
+
+		/* Layer activations and non-delayed connections */
+		layerRIter_end = scc->rend();
+		for(layerRIter = scc->rbegin(); layerRIter != layerRIter_end; ++layerRIter)
+		{
+			layer = *layerRIter;
+			if(layer->GetSrcConnections().empty() == true) continue;
+			group = layer->GetGroup();
+
+			op.type = PLAN_LAYER_BACKWARD;
+			op.flags = PLAN_WAIT | PLAN_RECORD;
+			op.layer = layer;
+			op.conn = NULL;
+			backwardPlan.push_back(op);
+
+			connIter_end = layer->GetSrcConnections().end();
+			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
+			{
+				conn = *connIter;
+				if(conn->GetSrcLayer()->GetGroup() != group) continue;
+				if(conn->IsDelayed() == true) continue;
+
+				op.type = PLAN_CONN_BACKWARD;
+				op.flags = 0;
+				if(conn->GetSrcLayer()->GetSrcConnections().empty() == false) op.flags |= PLAN_PROPAGATE;
+				op.layer = NULL;
+				op.conn = conn;
+				backwardPlan.push_back(op);
+			}
+		}
+
+		/* Delayed connections */
+		layerRIter_end = scc->rend();
+		for(layerRIter = scc->rbegin(); layerRIter != layerRIter_end; ++layerRIter)
+		{
+			layer = *layerRIter;
+			group = layer->GetGroup();
+
+			connIter_end = layer->GetSrcConnections().end();
+			for(connIter = layer->GetSrcConnections().begin(); connIter != connIter_end; ++connIter)
+			{
+				conn = *connIter;
+				if(conn->GetSrcLayer()->GetGroup() != group) continue;
+				if(conn->IsDelayed() == false) continue;
+
+				op.type = PLAN_CONN_BACKWARD;
+				op.flags = PLAN_RECORD;
+				if(conn->GetSrcLayer()->GetSrcConnections().empty() == false) op.flags |= PLAN_PROPAGATE;
+				op.layer = NULL;
+				op.conn = conn;
+				backwardPlan.push_back(op);
+			}
+		}
+
+		backwardPlan[loopIdx].nStep = backwardPlan.size() - loopIdx - 1;
+	}
+
+	if(wavefront == true)
+	{
+		ApplyWavefront(forwardPlan);
+		ApplyWavefront(backwardPlan);
+	}
+
+	CompileTaskGraph(forwardPlan, forwardTaskGraph, false);
+	CompileTaskGraph(backwardPlan, backwardTaskGraph, true);
+}
+
+
+void Rnn::CompileTaskGraph(const Plan &plan, TaskGraph &taskGraph, const bool backward)
+{
+	/* Each top-level op (an inter-SCC connection, a loop-free layer, a whole loop or a wavefront) becomes a task */
+	/* A task depends on the tasks producing the activations (forward) or errors (backward) it reads */
+
+	unsigned long opIdx, taskIdx;
+	const PlanOp *op, *stepOp, *stepOp_end;
+	std::string name;
+	std::vector<const Layer *> layers;
+	std::vector<const Layer *>::const_iterator layerIter, layerIter_end;
+	std::vector<unsigned long> deps;
+	std::vector<unsigned long>::const_iterator depIter, depIter_end;
+	std::unordered_map<const Layer *, unsigned long> layerTask;
+	std::unordered_map<const Layer *, std::vector<unsigned long>> connTasks;
+	std::unordered_map<const Layer *, unsigned long>::const_iterator producer;
+
+	taskGraph.Clear();
+
+	if(nThread <= 1) return;
+
+	for(opIdx = 0; opIdx < plan.size(); opIdx++)
+	{
+		op = &plan[opIdx];
+
+		if(op->type == PLAN_CONN_FORWARD || op->type == PLAN_CONN_BACKWARD)
+		{
+			const Layer *from = backward == false ? op->conn->GetSrcLayer() : op->conn->GetDstLayer();
+			const Layer *to = backward == false ? op->conn->GetDstLayer() : op->conn->GetSrcLayer();
+
+			name = op->conn->GetSrcLayer()->GetName() + " -> " + op->conn->GetDstLayer()->GetName();
+
+			taskIdx = taskGraph.AddTask(name, [this, op] {
+					RunPlanOp(*op, taskBatchFrom, taskBatchTo, taskNStream, true, true); });
+
+			producer = layerTask.find(from);
+			if(producer != layerTask.end())
+				taskGraph.AddDependency(producer->second, taskIdx);
+
+			connTasks[to].push_back(taskIdx);
+
+			continue;
+		}
+
+		/* Collect the layers computed by this op and the tasks it depends on */
+		layers.clear();
+		deps.clear();
+
+		if(op->type == PLAN_LOOP || op->type == PLAN_WAVEFRONT)
+		{
+			stepOp_end = op + 1 + op->nStep;
+			for(stepOp = op + 1; stepOp != stepOp_end; ++stepOp)
+			{
+				if(stepOp->type == PLAN_LOOP) continue;
 
-	scc = new Scc;
+				if(stepOp->layer != NULL)
+				{
+					layers.push_back(stepOp->layer);
+					continue;
+				}
 
-	do
-	{
-		v = sccStack.top();
-		sccStack.pop();
+				/* Nested connections may read layers computed by earlier tasks */
+				producer = layerTask.find(backward == false ? stepOp->conn->GetSrcLayer() : stepOp->conn->GetDstLayer());
+				if(producer != layerTask.end()) deps.push_back(producer->second);
 
-		v->SetIndex(UNTOUCHED);
-		v->SetGroup(group);
-		v->SetVisited(false);
+				if(backward == true) layers.push_back(stepOp->conn->GetDstLayer());
+			}
 
-		sccLayerList.push_front(v);
-	} while(v != root);
+			if(op->type == PLAN_LOOP)
+			{
+				name = "loop";
+				taskIdx = taskGraph.AddTask(name, [this, op] {
+						RunPlanLoop(op, taskBatchFrom, taskBatchTo, taskNStream); });
+			}
+			else
+			{
+				name = "wavefront";
+				taskIdx = taskGraph.AddTask(name, [this, op] {
+						RunWavefront(op, taskBatchFrom, taskBatchTo, taskNStream, nThread); });
+			}
 
+			opIdx += op->nStep;
+		}
+		else
+		{
+			layers.push_back(op->layer);
 
-	layerIter_end = sccLayerList.end();
-	for(layerIter = sccLayerList.begin(); layerIter != layerIter_end; ++layerIter)
-	{
-		if((*layerIter)->GetVisited() == true) continue;
-		
+			name = op->layer->GetName();
+			taskIdx = taskGraph.AddTask(name, [this, op] {
+					RunPlanOp(*op, taskBatchFrom, taskBatchTo, taskNStream, true, true); });
+		}
 
-		/* Depth first search */
+		layerIter_end = layers.end();
+		for(layerIter = layers.begin(); layerIter != layerIter_end; ++layerIter)
+		{
+			if(layerTask.find(*layerIter) != layerTask.end()) continue;
 
-		dfsStack.push(*layerIter);
+			const std::vector<unsigned long> &connDeps = connTasks[*layerIter];
+			deps.insert(deps.end(), connDeps.begin(), connDeps.end());
+		}
 
-		while(dfsStack.empty() == false)
+		std::sort(deps.begin(), deps.end());
+		deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+
+		depIter_end = deps.end();
+		for(depIter = deps.begin(); depIter != depIter_end; ++depIter)
 		{
-			v = dfsStack.top();
+			taskGraph.AddDependency(*depIter, taskIdx);
+		}
 
-			if(v->GetIndex() == UNTOUCHED)
-			{
-				v->SetIndex(TOUCHED);
+		layerIter_end = layers.end();
+		for(layerIter = layers.begin(); layerIter != layerIter_end; ++layerIter)
+		{
+			if(layerTask.find(*layerIter) == layerTask.end())
+				layerTask[*layerIter] = taskIdx;
+		}
+	}
+}
 
-				const Layer::ConnList srcConnList = v->GetSrcConnections();
 
-				connIter_end = srcConnList.end();
-				for(connIter = srcConnList.begin(); connIter != connIter_end; ++connIter)
-				{
-					if((*connIter)->IsDelayed() == true) continue;
+void Rnn::ApplyWavefront(Plan &plan)
+{
+	/* Merge runs of stages that start and end with a loop into PLAN_WAVEFRONT ops */
+	/* Stages are in topological order, so stage k only reads stages before it at the same step */
 
-					w = (*connIter)->GetSrcLayer();
+	unsigned long opIdx, stageIdx, runEnd, nLoop, nRunLoop;
+	unsigned long flags;
+	Plan newPlan;
+	PlanOp op;
 
-					if(w->GetIndex() == UNTOUCHED)
-						dfsStack.push(w);
-					else if(w->GetIndex() == TOUCHED)
-					{  /* Loop detected */
-						fprintf(stderr, "\nLoop detected !!\n");
-						verify(false);
-					}
-				}
+	flags = 0;
+	opIdx = 0;
 
-				continue;
-			}
+	while(opIdx < plan.size())
+	{
+		/* Find the longest run of stages ending with a loop */
+		stageIdx = opIdx;
+		runEnd = opIdx;
+		nLoop = 0;
+		nRunLoop = 0;
 
-			dfsStack.pop();
-			if(v->GetVisited() == true) continue;
+		while(stageIdx < plan.size())
+		{
+			while(stageIdx < plan.size() &&
+					(plan[stageIdx].type == PLAN_CONN_FORWARD || plan[stageIdx].type == PLAN_CONN_BACKWARD))
+				stageIdx++;
 
-			v->SetIndex(SCC_DETERMINED);
+			if(stageIdx == plan.size()) break;
 
-			/* Post visit */
+			if(plan[stageIdx].type == PLAN_LOOP)
+			{
+				flags = plan[stageIdx].flags;
+				stageIdx += plan[stageIdx].nStep + 1;
+				nLoop++;
 
-			scc->push_back(v);
-			printf("%s ", v->GetName().c_str());
+				runEnd = stageIdx;
+				nRunLoop = nLoop;
+			}
+			else
+			{
+				/* A loop-free layer can only be inside a run */
+				if(nLoop == 0) break;
+				stageIdx++;
+			}
+		}
 
-			v->SetVisited(true);
+		if(nRunLoop < 2)
+		{
+			/* Nothing to pipeline: copy the first op (with its nested ops) */
+			runEnd = opIdx + 1;
+			if(plan[opIdx].type == PLAN_LOOP) runEnd += plan[opIdx].nStep;
+
+			newPlan.insert(newPlan.end(), plan.begin() + opIdx, plan.begin() + runEnd);
+			opIdx = runEnd;
+			continue;
 		}
-	}
 
-	printf("\n");
+		op.type = PLAN_WAVEFRONT;
+		op.flags = flags & PLAN_REVERSE;
+		op.layer = NULL;
+		op.conn = NULL;
+		op.nStep = runEnd - opIdx;
+		newPlan.push_back(op);
 
-	return scc;
+		newPlan.insert(newPlan.end(), plan.begin() + opIdx, plan.begin() + runEnd);
+		opIdx = runEnd;
+	}
+
+	plan.swap(newPlan);
 }
 
 
@@ -1118,6 +1869,7 @@ void Rnn::CreateDefaultPStream(const unsigned long loc)
 
 	defaultPStream = new PStream();
 	engine->StreamCreate(*defaultPStream, loc);
+	engine->EventCreate(updateEvent, loc);
 }
 
 
@@ -1125,6 +1877,7 @@ void Rnn::DestroyDefaultPStream()
 {
 	if(defaultPStream == NULL) return;
 
+	engine->EventDestroy(updateEvent);
 	engine->StreamDestroy(*defaultPStream);
 
 	delete defaultPStream;
@@ -1170,8 +1923,304 @@ void Rnn::StreamWait(PStream &stream)
 }
 
 
+void Rnn::SetNumThreads(const unsigned long nThread)
+{
+	verify(nThread > 0);
+
+	this->nThread = nThread;
+
+	forwardTaskGraph.SetNumThreads(nThread);
+	backwardTaskGraph.SetNumThreads(nThread);
+
+	isReady = false;
+}
+
+
+const unsigned long Rnn::GetNumThreads() const
+{
+	return nThread;
+}
+
+
+void Rnn::SetWavefront(const bool enable)
+{
+	wavefront = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetWavefront() const
+{
+	return wavefront;
+}
+
+
+void Rnn::SetBiasFolding(const bool enable)
+{
+	biasFolding = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetBiasFolding() const
+{
+	return biasFolding;
+}
+
+
+void Rnn::FoldBiases()
+{
+	/* A full connection from a single-unit ACT_BIAS layer multiplies the weight column by a
+	 * constant one, so the destination layer can add the weights as a bias vector directly.
+	 * The connection stays in the graph (its events order the weight updates and the error
+	 * is still distributed through it), but Connection::Forward() becomes a no-op. */
+
+	ConnSet::const_iterator connIter, connIter_end;
+	Layer::ConnList::const_iterator iter, iter_end;
+
+	connIter_end = connSet.end();
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		(*connIter)->SetFoldedBias(false);
+	}
+
+	if(biasFolding == false) return;
+
+	connIter_end = connSet.end();
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		Connection *conn = *connIter;
+		Layer *srcLayer = conn->GetSrcLayer();
+		Layer *dstLayer = conn->GetDstLayer();
+
+		if(srcLayer->GetActType() != ACT_BIAS || srcLayer->GetSize() != 1) continue;
+		if(conn->spec.connType != CONN_FULL) continue;
+		if(conn->IsIdentity() == true || conn->IsDelayed() == true) continue;
+		if(dstLayer->GetStateType() != AGG_SUM) continue;
+
+		/* Only one folded bias per layer, and at least one regular source to add it to */
+		bool hasBias = false, hasSrc = false;
+
+		iter_end = dstLayer->GetSrcConnections().end();
+		for(iter = dstLayer->GetSrcConnections().begin(); iter != iter_end; ++iter)
+		{
+			if((*iter)->IsFoldedBias() == true)
+				hasBias = true;
+			else if((*iter) != conn && (*iter)->GetSrcLayer()->GetActType() != ACT_BIAS)
+				hasSrc = true;
+		}
+
+		if(hasBias == true || hasSrc == false) continue;
+
+		conn->SetFoldedBias(true);
+	}
+}
+
+
+void Rnn::SetInferenceFusion(const bool enable)
+{
+	inferenceFusion = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetInferenceFusion() const
+{
+	return inferenceFusion;
+}
+
+
+void Rnn::FuseConvBlocks()
+{
+	/* CONN_CONV (+ CONN_CONVBIAS) -> ACT_RECTLINEAR layer -> CONN_POOL: the pooling connection computes
+	 * the pooled activation directly (Engine::ConvActPoolForward()). The fused connections and the
+	 * convolution layer stay in the plans so that the events keep their order, but do nothing. */
+
+	ConnSet::const_iterator connIter, connIter_end;
+	LayerMap::const_iterator layerIter, layerIter_end;
+	Layer::ConnList::const_iterator iter, iter_end;
+
+	connIter_end = connSet.end();
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		(*connIter)->SetFused(false);
+		(*connIter)->SetFusedBlock(NULL, NULL);
+	}
+
+	layerIter_end = layerMap.end();
+	for(layerIter = layerMap.begin(); layerIter != layerIter_end; ++layerIter)
+	{
+		layerIter->second->SetFused(false);
+	}
+
+	if(inferenceFusion == false) return;
+
+	connIter_end = connSet.end();
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		Connection *poolConn = *connIter;
+		Layer *convLayer = poolConn->GetSrcLayer();
+		Connection *convConn = NULL, *biasConn = NULL;
+		bool isValid = true;
+
+		if(poolConn->spec.connType != CONN_POOL) continue;
+		if(poolConn->IsIdentity() == true || poolConn->IsDelayed() == true) continue;
+
+		/* The activation must not be needed by anything else */
+		if(convLayer->GetActType() != ACT_RECTLINEAR || convLayer->GetStateType() != AGG_SUM) continue;
+		if(convLayer->IsLinked() == true || convLayer->GetDstConnections().size() != 1) continue;
+
+#if QUANT_RELU
+		/* The quantization step is still being calibrated from the activations */
+		if(convLayer->relu_delta_decision == 0 && convLayer->M_relu != 100) continue;
+#endif
+
+		iter_end = convLayer->GetSrcConnections().end();
+		for(iter = convLayer->GetSrcConnections().begin(); iter != iter_end; ++iter)
+		{
+			if((*iter)->IsIdentity() == true || (*iter)->IsDelayed() == true || (*iter)->IsFoldedBias() == true)
+				isValid = false;
+			else if((*iter)->spec.connType == CONN_CONV && convConn == NULL)
+				convConn = *iter;
+			else if((*iter)->spec.connType == CONN_CONVBIAS && biasConn == NULL)
+				biasConn = *iter;
+			else
+				isValid = false;
+		}
+
+		if(isValid == false || convConn == NULL) continue;
+
+		const LayerSpec &convSpec = convLayer->GetSpec();
+		const LayerSpec &poolSpec = poolConn->GetDstLayer()->GetSpec();
+
+		if(convSpec.numMaps != poolSpec.numMaps) continue;
+		if(poolSpec.dimX != (convSpec.dimX - POOL_WINDOW) / POOL_STRIDE + 1) continue;
+		if(poolSpec.dimY != (convSpec.dimY - POOL_WINDOW) / POOL_STRIDE + 1) continue;
+
+		convConn->SetFused(true);
+		if(biasConn != NULL) biasConn->SetFused(true);
+		convLayer->SetFused(true);
+		poolConn->SetFusedBlock(convConn, biasConn);
+	}
+}
+
+
+void Rnn::SetPoolArgmax(const bool enable)
+{
+	poolArgmax = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetPoolArgmax() const
+{
+	return poolArgmax;
+}
+
+
+void Rnn::SetActivationLut(const bool enable)
+{
+	activationLut = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetActivationLut() const
+{
+	return activationLut;
+}
+
+
+void Rnn::SetFusedOptimizer(const bool enable)
+{
+	fusedOptimizer = enable;
+}
+
+
+const bool Rnn::GetFusedOptimizer() const
+{
+	return fusedOptimizer;
+}
+
+
+void Rnn::SetCompactOptimizerState(const bool enable)
+{
+	compactOptimizerState = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetCompactOptimizerState() const
+{
+	return compactOptimizerState;
+}
+
+
+void Rnn::SetParamArena(const bool enable)
+{
+	paramArena = enable;
+
+	isReady = false;
+}
+
+
+const bool Rnn::GetParamArena() const
+{
+	return paramArena;
+}
+
+
+Matrix<FLOAT> *const Rnn::GetParamArena(const ParamKind kind)
+{
+	verify(kind >= 0 && kind < N_PARAM_KIND);
+
+	if(arena[kind].GetNumRows() == 0) return NULL;
+
+	return &arena[kind];
+}
+
+
+void Rnn::ApplyPoolArgmax()
+{
+	ConnSet::const_iterator connIter, connIter_end;
+
+	connIter_end = connSet.end();
+	for(connIter = connSet.begin(); connIter != connIter_end; ++connIter)
+	{
+		Connection *conn = *connIter;
+
+		if(conn->spec.connType != CONN_POOL || conn->IsIdentity() == true) continue;
+
+		/* A fused block does not produce the pooling input, and it is inference only anyway */
+		conn->SetPoolArgmax(poolArgmax == true && conn->IsFusedBlock() == false);
+	}
+}
+
+
+TaskGraph &Rnn::GetForwardTaskGraph()
+{
+	return forwardTaskGraph;
+}
+
+
+TaskGraph &Rnn::GetBackwardTaskGraph()
+{
+	return backwardTaskGraph;
+}
+
+
 void Rnn::Clear()
 {
+	forwardPlan.clear();
+	backwardPlan.clear();
+	forwardTaskGraph.Clear();
+	backwardTaskGraph.Clear();
 	ClearSccList();
 	ClearConnections();
 	ClearLayers();
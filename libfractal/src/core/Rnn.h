@@ -23,12 +23,14 @@
 #include <list>
 #include <stack>
 #include <string>
+#include <vector>
 
 #include "InitWeightParam.h"
 #include "Engine.h"
 #include "Layer.h"
 #include "Probe.h"
 #include "Connection.h"
+#include "TaskGraph.h"
 #include "FractalCommon.h"
 
 namespace fractal
@@ -80,9 +82,65 @@ public:
 	void UpdateWeights(const unsigned long batchFrom, const unsigned long batchTo, const unsigned long nFrame,
 			const FLOAT rate, const FLOAT momentum, const bool adaptiveRates, const bool rmsprop);
 
+	/* Compute the gradients of all connections first and then update every weight tensor with one fused
+	 * kernel (momentum, Rmsprop/Adadelta and the weight requantization in a single pass) on the default stream */
+	void SetFusedOptimizer(const bool enable);
+	const bool GetFusedOptimizer() const;
+
+	/* Keep the momentum in bfloat16 and the Rmsprop/Adadelta mean squares in 8 bits with a scale per block
+	 * (see hostOpt::UpdateParam) between the updates; requires the fused optimizer */
+	void SetCompactOptimizerState(const bool enable);
+	const bool GetCompactOptimizerState() const;
+
+	/* Carve the weights of all connections out of one contiguous arena, and each kind of optimizer state
+	 * (see ParamKind) out of another, when the network gets ready; the matrices of the connections are
+	 * views into the arenas. GetParamArena() returns NULL if the arena is disabled or empty. */
+	void SetParamArena(const bool enable);
+	const bool GetParamArena() const;
+	Matrix<FLOAT> *const GetParamArena(const ParamKind kind);
+
+	/* Gradient checkpointing: snapshots of the recurrent state and gradient accumulation over segments */
+	const unsigned long GetMaxDelay() const;
+	void SetCheckpoint(const unsigned long nCheckpoint, const unsigned long nCol);
+	void SaveCheckpoint(const unsigned long idx);
+	void LoadCheckpoint(const unsigned long idx);
+	void SaveDropoutMask(const unsigned long idx);
+	void LoadDropoutMask(const unsigned long idx);
+	void AccumulateGradients(const unsigned long batchFrom, const unsigned long batchTo);
+
 	void Synchronize();
 	void StreamWait(PStream &stream);
 
+	/* Task-graph execution of independent SCCs by nThread host threads (1: sequential plan interpreter);
+	 * with CUDA, the threads issue the ops to the streams of their layers concurrently */
+	void SetNumThreads(const unsigned long nThread);
+	const unsigned long GetNumThreads() const;
+	TaskGraph &GetForwardTaskGraph();
+	TaskGraph &GetBackwardTaskGraph();
+
+	/* Pipeline consecutive recurrent SCCs over time: SCC k runs step t while SCC k+1 runs step t-1 */
+	void SetWavefront(const bool enable);
+	const bool GetWavefront() const;
+
+	/* Apply ACT_BIAS connections as broadcast bias vectors in the destination layer instead of a GEMM */
+	void SetBiasFolding(const bool enable);
+	const bool GetBiasFolding() const;
+
+	/* Inference only: compute CONN_CONV (+ CONN_CONVBIAS) -> rectlinear layer -> CONN_POOL in one pass
+	 * without materializing the activation of the convolution layer. Backward() is not allowed. */
+	void SetInferenceFusion(const bool enable);
+	const bool GetInferenceFusion() const;
+
+	/* Store the argmax of the max-pooling windows (one byte per output) so that the backward pass of
+	 * CONN_POOL is a scatter of the error instead of a rescan of the pooling input and output */
+	void SetPoolArgmax(const bool enable);
+	const bool GetPoolArgmax() const;
+
+	/* Inference with signal quantization: quantized sigmoid and tanh layers look up a step table of
+	 * the state instead of evaluating exp(). Backward() is not allowed (no unquantized activation). */
+	void SetActivationLut(const bool enable);
+	const bool GetActivationLut() const;
+
 	void Ready();
 
 	void Clear();
@@ -105,6 +163,25 @@ public:
 	typedef std::list<Scc *> SccList;
 	typedef std::list<PStream *> PStreamList;
 	SccList sccList;
+
+	/* Compiled execution plan */
+	enum PlanOpType {PLAN_CONN_FORWARD, PLAN_LAYER_FORWARD, PLAN_CONN_BACKWARD, PLAN_LAYER_BACKWARD, PLAN_LOOP, PLAN_WAVEFRONT};
+
+	static const unsigned long PLAN_WAIT = 0x1;		/* Wait for the dependencies before the first step */
+	static const unsigned long PLAN_RECORD = 0x2;	/* Record the event after the last step */
+	static const unsigned long PLAN_PROPAGATE = 0x4;	/* Propagate the error to the source layer */
+	static const unsigned long PLAN_REVERSE = 0x8;	/* Iterate the loop backward in time */
+
+	struct PlanOp
+	{
+		PlanOpType type;
+		unsigned long flags;
+		Layer *layer;
+		Connection *conn;
+		unsigned long nStep; /* PLAN_LOOP, PLAN_WAVEFRONT: the number of nested ops that follow */
+	};
+
+	typedef std::vector<PlanOp> Plan;
 protected:
 
 	Layer *FindLayer(const std::string &layerName);
@@ -114,6 +191,18 @@ protected:
 	void DeleteConnection(Layer *const from, Layer *const to);
 
 	void Tarjan();
+	void CompilePlan();
+	void RunPlan(const Plan &plan, const unsigned long batchFrom, const unsigned long batchTo, const unsigned long nStream);
+	void CompileTaskGraph(const Plan &plan, TaskGraph &taskGraph, const bool backward);
+	void ApplyWavefront(Plan &plan);
+	void FoldBiases();
+	void FuseConvBlocks();
+	void ApplyPoolArgmax();
+	void CreateParamArena();
+	void ReleaseParamArena();
+	void FusedUpdateWeights(const unsigned long batchFrom, const unsigned long batchTo,
+			const FLOAT rate, const FLOAT momentum, const bool adaptiveRates, const bool rmsprop);
+	const bool IsLoop(const Scc *const scc) const;
 	void LinkProbe(Probe &probe, Layer *const layer);
 
 	void ClearLayers();
@@ -133,8 +222,25 @@ protected:
 	ConnSet connSet;
 	PStreamList pStreamList;
 	PStream *defaultPStream;
+	PEvent updateEvent; /* end of the fused optimizer step on the default stream */
+
+	Plan forwardPlan, backwardPlan;
+
+	TaskGraph forwardTaskGraph, backwardTaskGraph;
+	unsigned long nThread;
+	bool wavefront;
+	bool biasFolding;
+	bool inferenceFusion;
+	bool poolArgmax;
+	bool activationLut;
+	bool fusedOptimizer;
+	bool compactOptimizerState;
+	bool paramArena;
+	Matrix<FLOAT> arena[N_PARAM_KIND];
+	unsigned long taskBatchFrom, taskBatchTo, taskNStream;
 
 	unsigned long batchSize;
+	unsigned long nCheckpoint, checkpointSize;
 
 	bool isReady;
 };
@@ -0,0 +1,448 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "TaskGraph.h"
+
+#include <cstdio>
+#include <algorithm>
+
+
+namespace fractal
+{
+
+TaskGraph::TaskGraph()
+{
+	pending = NULL;
+	pendingSize = 0;
+	remaining = 0;
+	nReady = 0;
+	nSleeping = 0;
+	nThread = 1;
+	runId = 0;
+	nActive = 0;
+	quit = false;
+
+	StartWorkers();
+}
+
+
+TaskGraph::~TaskGraph()
+{
+	StopWorkers();
+
+	if(pending != NULL) delete[] pending;
+}
+
+
+void TaskGraph::SetNumThreads(const unsigned long nThread)
+{
+	verify(nThread > 0);
+
+	if(this->nThread == nThread) return;
+
+	StopWorkers();
+	this->nThread = nThread;
+	StartWorkers();
+}
+
+
+const unsigned long TaskGraph::AddTask(const std::string &name, const TaskFunc &func)
+{
+	Task task;
+
+	task.name = name;
+	task.func = func;
+	task.nPred = 0;
+	task.startTime = 0.0;
+	task.endTime = 0.0;
+	task.threadIdx = 0;
+
+	taskList.push_back(task);
+
+	return taskList.size() - 1;
+}
+
+
+void TaskGraph::AddDependency(const unsigned long taskFrom, const unsigned long taskTo)
+{
+	/* Forward edges only, so that the graph is acyclic by construction */
+	verify(taskFrom < taskTo && taskTo < taskList.size());
+
+	taskList[taskFrom].succ.push_back(taskTo);
+	taskList[taskTo].nPred++;
+}
+
+
+void TaskGraph::Clear()
+{
+	taskList.clear();
+}
+
+
+void TaskGraph::Run()
+{
+	unsigned long i, nTask, nRoot;
+
+	nTask = taskList.size();
+	if(nTask == 0) return;
+
+	if(pendingSize != nTask)
+	{
+		if(pending != NULL) delete[] pending;
+		pending = new std::atomic<unsigned long>[nTask];
+		pendingSize = nTask;
+	}
+
+	for(i = 0; i < nTask; i++)
+	{
+		pending[i] = taskList[i].nPred;
+	}
+
+	remaining = nTask;
+	nReady = 0;
+	runStart = std::chrono::steady_clock::now();
+
+	/* Distribute the root tasks round-robin */
+	nRoot = 0;
+	for(i = 0; i < nTask; i++)
+	{
+		if(taskList[i].nPred > 0) continue;
+
+		Push(nRoot % nThread, i);
+		nRoot++;
+	}
+
+	verify(nRoot > 0);
+
+	if(nThread > 1)
+	{
+		std::lock_guard<std::mutex> lock(mtxRun);
+		runId++;
+		cvRun.notify_all();
+	}
+
+	/* The calling thread acts as the worker 0 */
+	Work(0);
+
+	if(nThread > 1)
+	{
+		std::unique_lock<std::mutex> lock(mtxRun);
+		cvDone.wait(lock, [this] { return nActive == 0; });
+	}
+}
+
+
+const std::string &TaskGraph::GetTaskName(const unsigned long taskIdx) const
+{
+	verify(taskIdx < taskList.size());
+
+	return taskList[taskIdx].name;
+}
+
+
+const double TaskGraph::GetTaskStartTime(const unsigned long taskIdx) const
+{
+	verify(taskIdx < taskList.size());
+
+	return taskList[taskIdx].startTime;
+}
+
+
+const double TaskGraph::GetTaskEndTime(const unsigned long taskIdx) const
+{
+	verify(taskIdx < taskList.size());
+
+	return taskList[taskIdx].endTime;
+}
+
+
+const unsigned long TaskGraph::GetTaskThread(const unsigned long taskIdx) const
+{
+	verify(taskIdx < taskList.size());
+
+	return taskList[taskIdx].threadIdx;
+}
+
+
+const double TaskGraph::GetCriticalPath(std::vector<unsigned long> &path) const
+{
+	unsigned long i, j, nTask, last;
+	double t;
+	std::vector<double> finish;
+	std::vector<unsigned long> prev;
+
+	nTask = taskList.size();
+	path.clear();
+
+	if(nTask == 0) return 0.0;
+
+	finish.assign(nTask, 0.0);
+	prev.assign(nTask, nTask);
+
+	/* Tasks are stored in topological order */
+	for(i = 0; i < nTask; i++)
+	{
+		finish[i] += taskList[i].endTime - taskList[i].startTime;
+
+		for(j = 0; j < taskList[i].succ.size(); j++)
+		{
+			const unsigned long s = taskList[i].succ[j];
+
+			if(finish[i] > finish[s])
+			{
+				finish[s] = finish[i];
+				prev[s] = i;
+			}
+		}
+	}
+
+	last = 0;
+	for(i = 1; i < nTask; i++)
+	{
+		if(finish[i] > finish[last]) last = i;
+	}
+
+	t = finish[last];
+
+	for(i = last; i < nTask; i = prev[i])
+	{
+		path.insert(path.begin(), i);
+	}
+
+	return t;
+}
+
+
+void TaskGraph::PrintTiming() const
+{
+	unsigned long i;
+	double total, span;
+	std::vector<unsigned long> path;
+
+	total = 0.0;
+	span = 0.0;
+
+	for(i = 0; i < taskList.size(); i++)
+	{
+		const Task &task = taskList[i];
+
+		printf("%4lu [thread %2lu] %10.6f - %10.6f  %s\n", i, task.threadIdx,
+				task.startTime, task.endTime, task.name.c_str());
+
+		total += task.endTime - task.startTime;
+		span = std::max(span, task.endTime);
+	}
+
+	printf("Total task time: %.6f s, elapsed: %.6f s, threads: %lu\n", total, span, nThread);
+	printf("Critical path: %.6f s\n", GetCriticalPath(path));
+
+	for(i = 0; i < path.size(); i++)
+	{
+		printf("  %s\n", taskList[path[i]].name.c_str());
+	}
+}
+
+
+void TaskGraph::StartWorkers()
+{
+	unsigned long i;
+
+	verify(workers.empty() == true);
+	verify(queues.empty() == true);
+
+	quit = false;
+
+	for(i = 0; i < nThread; i++)
+	{
+		queues.push_back(new WorkQueue);
+	}
+
+	for(i = 1; i < nThread; i++)
+	{
+		workers.push_back(std::thread(&TaskGraph::WorkerMain, this, i));
+	}
+}
+
+
+void TaskGraph::StopWorkers()
+{
+	unsigned long i;
+
+	{
+		std::lock_guard<std::mutex> lock(mtxRun);
+		quit = true;
+		cvRun.notify_all();
+	}
+
+	for(i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	for(i = 0; i < queues.size(); i++)
+	{
+		delete queues[i];
+	}
+
+	workers.clear();
+	queues.clear();
+}
+
+
+void TaskGraph::WorkerMain(const unsigned long threadIdx)
+{
+	unsigned long seenRunId = 0;
+
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtxRun);
+			cvRun.wait(lock, [this, seenRunId] { return quit == true || runId != seenRunId; });
+
+			if(quit == true) return;
+
+			seenRunId = runId;
+			nActive++;
+		}
+
+		Work(threadIdx);
+
+		{
+			std::lock_guard<std::mutex> lock(mtxRun);
+			nActive--;
+			if(nActive == 0) cvDone.notify_all();
+		}
+	}
+}
+
+
+void TaskGraph::Work(const unsigned long threadIdx)
+{
+	unsigned long taskIdx;
+
+	while(remaining > 0)
+	{
+		if(Pop(threadIdx, taskIdx) == true || Steal(threadIdx, taskIdx) == true)
+		{
+			nReady--;
+			Execute(threadIdx, taskIdx);
+		}
+		else
+		{
+			/* Nothing to run or steal: sleep until Push() or the last task wakes us up.
+			 * nSleeping is raised before nReady is checked and Push() raises nReady before
+			 * checking nSleeping, so a push is never missed. */
+			std::unique_lock<std::mutex> lock(mtxIdle);
+
+			nSleeping++;
+			cvIdle.wait(lock, [this] { return nReady > 0 || remaining == 0; });
+			nSleeping--;
+		}
+	}
+}
+
+
+void TaskGraph::Wake(const bool all)
+{
+	if(nSleeping == 0) return;
+
+	std::lock_guard<std::mutex> lock(mtxIdle);
+
+	if(all == true)
+		cvIdle.notify_all();
+	else
+		cvIdle.notify_one();
+}
+
+
+void TaskGraph::Execute(const unsigned long threadIdx, const unsigned long taskIdx)
+{
+	unsigned long i;
+	Task &task = taskList[taskIdx];
+
+	task.threadIdx = threadIdx;
+	task.startTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+	task.func();
+
+	task.endTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+	/* Release the successors; ready tasks stay on this thread for locality */
+	for(i = 0; i < task.succ.size(); i++)
+	{
+		if(--pending[task.succ[i]] == 0)
+			Push(threadIdx, task.succ[i]);
+	}
+
+	if(--remaining == 0) Wake(true);
+}
+
+
+void TaskGraph::Push(const unsigned long threadIdx, const unsigned long taskIdx)
+{
+	WorkQueue *q = queues[threadIdx];
+
+	{
+		std::lock_guard<std::mutex> lock(q->mtx);
+		q->queue.push_back(taskIdx);
+	}
+
+	nReady++;
+	Wake(false);
+}
+
+
+const bool TaskGraph::Pop(const unsigned long threadIdx, unsigned long &taskIdx)
+{
+	WorkQueue *q = queues[threadIdx];
+
+	std::lock_guard<std::mutex> lock(q->mtx);
+
+	if(q->queue.empty() == true) return false;
+
+	/* LIFO for the owner */
+	taskIdx = q->queue.back();
+	q->queue.pop_back();
+
+	return true;
+}
+
+
+const bool TaskGraph::Steal(const unsigned long threadIdx, unsigned long &taskIdx)
+{
+	unsigned long i;
+
+	for(i = 1; i < nThread; i++)
+	{
+		WorkQueue *q = queues[(threadIdx + i) % nThread];
+
+		std::lock_guard<std::mutex> lock(q->mtx);
+
+		if(q->queue.empty() == true) continue;
+
+		/* FIFO for the thieves */
+		taskIdx = q->queue.front();
+		q->queue.pop_front();
+
+		return true;
+	}
+
+	return false;
+}
+
+}
+
@@ -0,0 +1,122 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_TASKGRAPH_H_
+#define FRACTAL_TASKGRAPH_H_
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "FractalCommon.h"
+
+
+namespace fractal
+{
+
+/* Task graph executed by a work-stealing thread pool on the host */
+/* Tasks must be added in topological order (dependencies point forward) */
+class TaskGraph
+{
+public:
+	typedef std::function<void()> TaskFunc;
+
+	TaskGraph();
+	virtual ~TaskGraph();
+
+	void SetNumThreads(const unsigned long nThread);
+	inline const unsigned long GetNumThreads() const { return nThread; }
+
+	const unsigned long AddTask(const std::string &name, const TaskFunc &func);
+	void AddDependency(const unsigned long taskFrom, const unsigned long taskTo);
+	void Clear();
+
+	void Run();
+
+	inline const unsigned long GetNumTasks() const { return taskList.size(); }
+	const std::string &GetTaskName(const unsigned long taskIdx) const;
+
+	/* Timing of the last run (in seconds from the start of the run) */
+	const double GetTaskStartTime(const unsigned long taskIdx) const;
+	const double GetTaskEndTime(const unsigned long taskIdx) const;
+	const unsigned long GetTaskThread(const unsigned long taskIdx) const;
+
+	/* Longest dependency chain of the last run, weighted by the measured task time */
+	const double GetCriticalPath(std::vector<unsigned long> &path) const;
+	void PrintTiming() const;
+
+protected:
+	TaskGraph(const TaskGraph &obj);
+
+	struct Task
+	{
+		std::string name;
+		TaskFunc func;
+		std::vector<unsigned long> succ;
+		unsigned long nPred;
+		double startTime, endTime;
+		unsigned long threadIdx;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex mtx;
+		std::deque<unsigned long> queue;
+	};
+
+	void StartWorkers();
+	void StopWorkers();
+	void WorkerMain(const unsigned long threadIdx);
+	void Work(const unsigned long threadIdx);
+	void Wake(const bool all);
+	void Execute(const unsigned long threadIdx, const unsigned long taskIdx);
+	void Push(const unsigned long threadIdx, const unsigned long taskIdx);
+	const bool Pop(const unsigned long threadIdx, unsigned long &taskIdx);
+	const bool Steal(const unsigned long threadIdx, unsigned long &taskIdx);
+
+	std::vector<Task> taskList;
+	std::atomic<unsigned long> *pending;
+	unsigned long pendingSize;
+	std::atomic<unsigned long> remaining;
+
+	unsigned long nThread;
+	std::vector<std::thread> workers;
+	std::vector<WorkQueue *> queues;
+
+	/* Idle workers sleep until a task is pushed or the run ends */
+	std::atomic<unsigned long> nReady, nSleeping;
+	std::mutex mtxIdle;
+	std::condition_variable cvIdle;
+
+	std::mutex mtxRun;
+	std::condition_variable cvRun, cvDone;
+	unsigned long runId, nActive;
+	bool quit;
+
+	std::chrono::steady_clock::time_point runStart;
+};
+
+}
+
+#endif /* FRACTAL_TASKGRAPH_H_ */
+
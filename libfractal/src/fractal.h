@@ -19,21 +19,29 @@
 #define FRACTAL_H_
 
 #include "core/Connection.h"
+#include "core/ConvPlanner.h"
 #include "core/CudaKernels.h"
 #include "core/Engine.h"
 #include "core/FractalCommon.h"
+#include "core/HostAct.h"
+#include "core/HostConv.h"
+#include "core/HostOpt.h"
 #include "core/InitWeightParam.h"
 #include "core/Layer.h"
 #include "core/Matrix.h"
 #include "core/Mem.h"
 #include "core/Probe.h"
 #include "core/Rnn.h"
+#include "core/TaskGraph.h"
 #include "util/AutoOptimizer.h"
 #include "util/BasicLayers.h"
 #include "util/ClassificationEvaluator.h"
 #include "util/DataSet.h"
 #include "util/DataStream.h"
 #include "util/Evaluator.h"
+#include "util/HtkDataSet.h"
+#include "util/InputBuffer.h"
+#include "util/MmapDataSet.h"
 #include "util/Optimizer.h"
 #include "util/Pipe.h"
 #include "util/PortMap.h"
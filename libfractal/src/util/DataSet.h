@@ -23,6 +23,11 @@
 namespace fractal
 {
 
+/* Element type of the frames of a channel. FRAME_UINT8 code c stands for the value table[c] of the channel;
+ * FRAME_FP16 is IEEE half precision. */
+enum FrameType {FRAME_FLOAT, FRAME_UINT8, FRAME_FP16};
+
+
 class DataSet
 {
 public:
@@ -33,6 +38,22 @@ public:
 
 	virtual void GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
 			const unsigned long frameIdx, FLOAT *const frame) = 0;
+
+	/* Compact channels (optional): GetCompactFrameData() writes the frame in the type of the channel,
+	 * which must match GetFrameData() after the conversion */
+	virtual const FrameType GetFrameType(const unsigned long channelIdx) const { return FRAME_FLOAT; }
+
+	virtual void GetCompactFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+			const unsigned long frameIdx, void *const frame) { verify(false); }
+
+	/* 256 values of the codes of a FRAME_UINT8 channel */
+	virtual void GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const { verify(false); }
+
+	/* Hint (optional): the sequence will be read soon */
+	virtual void Prefetch(const unsigned long seqIdx) {}
+
+	/* Called by DataStream when a stream starts the sequence, before its frames are read */
+	virtual void BeginSeq(const unsigned long seqIdx) {}
 };
 
 }
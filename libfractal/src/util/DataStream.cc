@@ -18,19 +18,31 @@
 #include "DataStream.h"
 
 #include <cstring>
+#include <algorithm>
 
 #include "DataSet.h"
+#include "../core/HostAct.h"
 
 
 namespace fractal
 {
 
+static const unsigned long RING_ALIGN = 64;
+
+
 DataStream::DataStream()
 {
     nStream = 1;
     nChannel = 0;
     dataSet = NULL;
     dataOrder = ORDER_SHUFFLE;
+    prefetchDepth = 0;
+    bucketSize = 1024;
+    bucketFrame = 0;
+    bucketPadFrame = 0;
+    bucketPadFrameShuffle = 0;
+    shuffleBufferSize = 4096;
+    blockSize = 1024;
 
     Alloc();
 }
@@ -46,17 +58,47 @@ void DataStream::LinkDataSet(DataSet *dataSet)
 
     dim.clear();
     delay.clear();
+    frameType.clear();
+    frameBytes.clear();
+    dequantTable.clear();
 
     dim.shrink_to_fit();
     delay.shrink_to_fit();
+    frameType.shrink_to_fit();
+    frameBytes.shrink_to_fit();
+    dequantTable.shrink_to_fit();
 
     dim.resize(nChannel);
     delay.resize(nChannel);
+    frameType.resize(nChannel);
+    frameBytes.resize(nChannel);
+    dequantTable.resize(nChannel);
 
     for(channelIdx = 0; channelIdx < nChannel; channelIdx++)
     {
         dim[channelIdx] = dataSet->GetDimension(channelIdx);
         delay[channelIdx] = 0;
+        frameType[channelIdx] = dataSet->GetFrameType(channelIdx);
+
+        switch(frameType[channelIdx])
+        {
+            case(FRAME_FLOAT):
+                frameBytes[channelIdx] = sizeof(FLOAT) * dim[channelIdx];
+                break;
+
+            case(FRAME_UINT8):
+                frameBytes[channelIdx] = sizeof(unsigned char) * dim[channelIdx];
+                dequantTable[channelIdx].resize(256);
+                dataSet->GetDequantTable(channelIdx, dequantTable[channelIdx].data());
+                break;
+
+            case(FRAME_FP16):
+                frameBytes[channelIdx] = sizeof(unsigned short) * dim[channelIdx];
+                break;
+
+            default:
+                verify(false);
+        }
     }
 
     Alloc();
@@ -75,32 +117,32 @@ void DataStream::UnlinkDataSet()
 
 void DataStream::Alloc()
 {
-    unsigned long streamIdx, channelIdx;
+    unsigned long channelIdx, size;
 
-    seqIdx.clear();
-    frameIdx.clear();
-    bufIdx.clear();
-    buf.clear();
+    seqIdx.assign(nStream, 0);
+    frameIdx.assign(nStream, 0);
+    ringPos.assign(nStream, 0);
 
-    seqIdx.shrink_to_fit();
-    frameIdx.shrink_to_fit();
-    bufIdx.shrink_to_fit();
-    buf.shrink_to_fit();
+    frameStride.resize(nChannel);
+    ring.resize(nChannel);
+    ringBase.resize(nChannel);
 
-    seqIdx.resize(nStream);
-    frameIdx.resize(nStream);
-    bufIdx.resize(nStream);
-    buf.resize(nStream);
-
-    for(streamIdx = 0; streamIdx < nStream; streamIdx++)
+    for(channelIdx = 0; channelIdx < nChannel; channelIdx++)
     {
-        bufIdx[streamIdx].resize(nChannel);
-        buf[streamIdx].resize(nChannel);
+        frameStride[channelIdx] = (frameBytes[channelIdx] + RING_ALIGN - 1) / RING_ALIGN * RING_ALIGN;
+        size = nStream * delay[channelIdx] * frameStride[channelIdx];
 
-        for(channelIdx = 0; channelIdx < nChannel; channelIdx++)
+        if(size == 0)
         {
-            buf[streamIdx][channelIdx].resize(delay[channelIdx] * dim[channelIdx]);
+            ring[channelIdx].clear();
+            ring[channelIdx].shrink_to_fit();
+            ringBase[channelIdx] = NULL;
+            continue;
         }
+
+        ring[channelIdx].resize(size + RING_ALIGN - 1);
+        ringBase[channelIdx] = ring[channelIdx].data()
+            + (RING_ALIGN - reinterpret_cast<unsigned long>(ring[channelIdx].data()) % RING_ALIGN) % RING_ALIGN;
     }
 }
 
@@ -141,13 +183,7 @@ void DataStream::Reset()
     unsigned long streamIdx, channelIdx;
     unsigned long i, maxDelay;
 
-    for(streamIdx = 0; streamIdx < nStream; streamIdx++)
-    {
-        for(channelIdx = 0; channelIdx < nChannel; channelIdx++)
-        {
-            bufIdx[streamIdx][channelIdx] = 0;
-        }
-    }
+    ringPos.assign(nStream, 0);
 
     maxDelay = 0;
     for(channelIdx = 0; channelIdx < nChannel; channelIdx++)
@@ -158,6 +194,8 @@ void DataStream::Reset()
     switch(dataOrder)
     {
         case(ORDER_SHUFFLE):
+        case(ORDER_BUCKETED):
+        case(ORDER_BLOCK_SHUFFLE):
             Shuffle();
             nextSeqIdx = 0;
             break;
@@ -169,10 +207,17 @@ void DataStream::Reset()
             nextSeqIdx = 0;
             break;
 
+        case(ORDER_SHUFFLE_BUFFER):
+            shuffleBuffer.clear();
+            nextSeqIdx = 0;
+            break;
+
         default:
             verify(false);
     }
 
+    PrefetchSeq(0, prefetchDepth);
+
     for(streamIdx = 0; streamIdx < nStream; streamIdx++)
     {
         NewSeq(streamIdx);
@@ -187,28 +232,29 @@ void DataStream::Reset()
 
 void DataStream::Next(const unsigned long streamIdx)
 {
-    unsigned long channelIdx, curSeqIdx, curFrameIdx, curBufIdx, curDim;
-    FLOAT *curBuf;
+    unsigned long channelIdx, curSeqIdx, curFrameIdx;
+    unsigned char *curBuf;
 
     verify(dataSet != NULL);
 
     curSeqIdx = seqIdx[streamIdx];
     curFrameIdx = frameIdx[streamIdx];
 
-    /* Copy and store delayed frames */
+    /* Store delayed frames in place of the oldest ones */
     for(channelIdx = 0; channelIdx < nChannel; channelIdx++)
     {
         if(delay[channelIdx] == 0) continue;
 
-        curBufIdx = bufIdx[streamIdx][channelIdx];
-        curDim = dim[channelIdx];
-        curBuf = buf[streamIdx][channelIdx].data() + curBufIdx * curDim;
+        curBuf = RingFrame(streamIdx, channelIdx);
 
-        dataSet->GetFrameData(curSeqIdx, channelIdx, curFrameIdx, curBuf);
-
-        bufIdx[streamIdx][channelIdx] = (curBufIdx + 1) % delay[channelIdx];
+        if(frameType[channelIdx] == FRAME_FLOAT)
+            dataSet->GetFrameData(curSeqIdx, channelIdx, curFrameIdx, reinterpret_cast<FLOAT *>(curBuf));
+        else
+            dataSet->GetCompactFrameData(curSeqIdx, channelIdx, curFrameIdx, curBuf);
     }
 
+    ringPos[streamIdx]++;
+
 
     /* Increase the indices */
     frameIdx[streamIdx]++;
@@ -222,8 +268,8 @@ void DataStream::Next(const unsigned long streamIdx)
 
 void DataStream::GenerateFrame(const unsigned long streamIdx, const unsigned long channelIdx, FLOAT *const frame)
 {
-    unsigned long curSeqIdx, curFrameIdx, curDim, curBufIdx;
-    FLOAT *curBuf;
+    unsigned long curSeqIdx, curFrameIdx, curDim;
+    unsigned char *curBuf;
 
     verify(dataSet != NULL);
 
@@ -231,10 +277,25 @@ void DataStream::GenerateFrame(const unsigned long streamIdx, const unsigned lon
 
     if(delay[channelIdx] > 0)
     {
-        curBufIdx = bufIdx[streamIdx][channelIdx];
-        curBuf = buf[streamIdx][channelIdx].data() + curBufIdx * curDim;
+        curBuf = RingFrame(streamIdx, channelIdx);
 
-        memcpy(frame, curBuf, sizeof(FLOAT) * curDim);
+        switch(frameType[channelIdx])
+        {
+            case(FRAME_FLOAT):
+                memcpy(frame, curBuf, frameBytes[channelIdx]);
+                break;
+
+            case(FRAME_UINT8):
+                hostAct::Dequant<FLOAT>(curBuf, frame, curDim, dequantTable[channelIdx].data());
+                break;
+
+            case(FRAME_FP16):
+                hostAct::HalfToFloat<FLOAT>(reinterpret_cast<unsigned short *>(curBuf), frame, curDim);
+                break;
+
+            default:
+                verify(false);
+        }
     }
     else
     {
@@ -246,6 +307,47 @@ void DataStream::GenerateFrame(const unsigned long streamIdx, const unsigned lon
 }
 
 
+const FrameType DataStream::GetFrameType(const unsigned long channelIdx) const
+{
+    verify(channelIdx < nChannel);
+
+    return frameType[channelIdx];
+}
+
+
+void DataStream::GenerateCompactFrame(const unsigned long streamIdx, const unsigned long channelIdx, void *const frame)
+{
+    verify(dataSet != NULL);
+    verify(frameType[channelIdx] != FRAME_FLOAT);
+
+    if(delay[channelIdx] > 0)
+    {
+        memcpy(frame, RingFrame(streamIdx, channelIdx), frameBytes[channelIdx]);
+    }
+    else
+    {
+        dataSet->GetCompactFrameData(seqIdx[streamIdx], channelIdx, frameIdx[streamIdx], frame);
+    }
+}
+
+
+const void *DataStream::GetFramePtr(const unsigned long streamIdx, const unsigned long channelIdx) const
+{
+    verify(streamIdx < nStream && channelIdx < nChannel);
+
+    return (delay[channelIdx] > 0) ? RingFrame(streamIdx, channelIdx) : NULL;
+}
+
+
+void DataStream::GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const
+{
+    verify(channelIdx < nChannel);
+    verify(frameType[channelIdx] == FRAME_UINT8);
+
+    memcpy(table, dequantTable[channelIdx].data(), sizeof(FLOAT) * 256);
+}
+
+
 void DataStream::SetDelay(const unsigned long channelIdx, const unsigned long delay)
 {
     verify(channelIdx < nChannel);
@@ -269,6 +371,8 @@ void DataStream::NewSeq(const unsigned long streamIdx)
     switch(dataOrder)
     {
         case(ORDER_SHUFFLE):
+        case(ORDER_BUCKETED):
+        case(ORDER_BLOCK_SHUFFLE):
 
             verify(shuffledSeqIdx.size() == nSeq);
 
@@ -278,6 +382,11 @@ void DataStream::NewSeq(const unsigned long streamIdx)
             {
                 Shuffle();
                 nextSeqIdx = 0;
+                PrefetchSeq(0, prefetchDepth);
+            }
+            else if(prefetchDepth > 0)
+            {
+                PrefetchSeq(nextSeqIdx + prefetchDepth - 1, 1);
             }
 
             break;
@@ -295,6 +404,33 @@ void DataStream::NewSeq(const unsigned long streamIdx)
             newSeqIdx = nextSeqIdx;
             nextSeqIdx = (nextSeqIdx + 1) % nSeq;
 
+            if(prefetchDepth > 0)
+                PrefetchSeq(nextSeqIdx + prefetchDepth - 1, 1);
+
+            break;
+
+        case(ORDER_SHUFFLE_BUFFER):
+
+            /* Read the sequences in order into the buffer (nextSeqIdx is the read position) */
+            while(shuffleBuffer.size() < std::min(shuffleBufferSize, nSeq))
+            {
+                shuffleBuffer.push_back(nextSeqIdx);
+                nextSeqIdx = (nextSeqIdx + 1) % nSeq;
+
+                if(prefetchDepth > 0)
+                    PrefetchSeq(nextSeqIdx + prefetchDepth - 1, 1);
+            }
+
+            /* Draw one at random */
+            {
+                std::uniform_int_distribution<unsigned long> randDist(0, shuffleBuffer.size() - 1);
+                unsigned long j = randDist(randGen);
+
+                newSeqIdx = shuffleBuffer[j];
+                shuffleBuffer[j] = shuffleBuffer.back();
+                shuffleBuffer.pop_back();
+            }
+
             break;
 
         default:
@@ -303,6 +439,7 @@ void DataStream::NewSeq(const unsigned long streamIdx)
 
     frameIdx[streamIdx] = 0;
     seqIdx[streamIdx] = newSeqIdx;
+    dataSet->BeginSeq(newSeqIdx);
     verify(dataSet->GetNumFrame(newSeqIdx) > 0);
 }
 
@@ -325,6 +462,12 @@ void DataStream::Shuffle()
         }
     }
 
+    if(dataOrder == ORDER_BLOCK_SHUFFLE)
+    {
+        BlockShuffle();
+        return;
+    }
+
     for(unsigned long i = 0; i < nSeq - 1; i++)
     {
         std::uniform_int_distribution<unsigned long> randDist(i, nSeq - 1);
@@ -335,6 +478,159 @@ void DataStream::Shuffle()
         shuffledSeqIdx[i] = shuffledSeqIdx[j];
         shuffledSeqIdx[j] = tmp;
     }
+
+    if(dataOrder == ORDER_BUCKETED)
+    {
+        BucketShuffle();
+    }
+}
+
+
+/* Reorder the shuffled sequences by length: sort, shuffle within the buckets and shuffle the groups */
+void DataStream::BucketShuffle()
+{
+    unsigned long nSeq, nGroup, i, j, k;
+    std::vector<unsigned long> seqLen, group, order;
+
+    nSeq = shuffledSeqIdx.size();
+
+    seqLen.resize(nSeq);
+    for(i = 0; i < nSeq; i++)
+    {
+        seqLen[i] = dataSet->GetNumFrame(i);
+    }
+
+    bucketPadFrameShuffle = PadFrames(shuffledSeqIdx, seqLen);
+
+    /* Sort by length (stable, so equal lengths keep the shuffled order) */
+    std::stable_sort(shuffledSeqIdx.begin(), shuffledSeqIdx.end(),
+            [&seqLen](const unsigned long a, const unsigned long b) { return seqLen[a] < seqLen[b]; });
+
+    /* Shuffle within the buckets */
+    for(i = 0; i < nSeq; i += bucketSize)
+    {
+        std::shuffle(shuffledSeqIdx.begin() + i, shuffledSeqIdx.begin() + std::min(i + bucketSize, nSeq), randGen);
+    }
+
+    /* Shuffle the groups of nStream sequences across the buckets */
+    nGroup = (nSeq + nStream - 1) / nStream;
+
+    group.resize(nGroup);
+    for(i = 0; i < nGroup; i++)
+    {
+        group[i] = i;
+    }
+    std::shuffle(group.begin(), group.end(), randGen);
+
+    order.reserve(nSeq);
+    for(i = 0; i < nGroup; i++)
+    {
+        j = group[i] * nStream;
+        for(k = j; k < std::min(j + nStream, nSeq); k++)
+        {
+            order.push_back(shuffledSeqIdx[k]);
+        }
+    }
+    shuffledSeqIdx.swap(order);
+
+    bucketPadFrame = PadFrames(shuffledSeqIdx, seqLen);
+
+    bucketFrame = 0;
+    for(i = 0; i < nSeq; i++)
+    {
+        bucketFrame += seqLen[i];
+    }
+}
+
+
+/* Shuffle the order of the blocks of consecutive sequences, then the sequences within each block */
+void DataStream::BlockShuffle()
+{
+    unsigned long nSeq, nBlock, i, j, k, pos;
+    std::vector<unsigned long> block;
+
+    nSeq = shuffledSeqIdx.size();
+    nBlock = (nSeq + blockSize - 1) / blockSize;
+
+    block.resize(nBlock);
+    for(i = 0; i < nBlock; i++)
+    {
+        block[i] = i;
+    }
+    std::shuffle(block.begin(), block.end(), randGen);
+
+    pos = 0;
+    for(i = 0; i < nBlock; i++)
+    {
+        j = pos;
+        for(k = block[i] * blockSize; k < std::min((block[i] + 1) * blockSize, nSeq); k++)
+        {
+            shuffledSeqIdx[pos++] = k;
+        }
+        std::shuffle(shuffledSeqIdx.begin() + j, shuffledSeqIdx.begin() + pos, randGen);
+    }
+}
+
+
+/* Frames to pad each group of nStream consecutive sequences of the order to its longest sequence */
+const unsigned long DataStream::PadFrames(const std::vector<unsigned long> &order, const std::vector<unsigned long> &seqLen) const
+{
+    unsigned long i, j, end, maxLen, nPad;
+
+    nPad = 0;
+    for(i = 0; i < order.size(); i += nStream)
+    {
+        end = std::min(i + nStream, (unsigned long) order.size());
+
+        maxLen = 0;
+        for(j = i; j < end; j++)
+        {
+            maxLen = std::max(maxLen, seqLen[order[j]]);
+        }
+        for(j = i; j < end; j++)
+        {
+            nPad += maxLen - seqLen[order[j]];
+        }
+    }
+
+    return nPad;
+}
+
+
+/* Hint the sequences at positions [from, from + n) of the order (of reading, with ORDER_SHUFFLE_BUFFER) */
+void DataStream::PrefetchSeq(const unsigned long from, const unsigned long n)
+{
+    unsigned long i, nSeq;
+
+    verify(dataSet != NULL);
+
+    nSeq = dataSet->GetNumSeq();
+
+    for(i = from; i < from + n; i++)
+    {
+        switch(dataOrder)
+        {
+            case(ORDER_SHUFFLE):
+            case(ORDER_BUCKETED):
+            case(ORDER_BLOCK_SHUFFLE):
+                if(i < nSeq) dataSet->Prefetch(shuffledSeqIdx[i]);
+                break;
+
+            case(ORDER_SEQUENTIAL):
+            case(ORDER_SHUFFLE_BUFFER):
+                dataSet->Prefetch(i % nSeq);
+                break;
+
+            default:
+                return;
+        }
+    }
+}
+
+
+void DataStream::SetPrefetchDepth(const unsigned long depth)
+{
+    prefetchDepth = depth;
 }
 
 
@@ -350,5 +646,37 @@ void DataStream::SetDataOrder(const DataOrder order)
 }
 
 
+void DataStream::SetBucketSize(const unsigned long bucketSize)
+{
+    verify(bucketSize > 0);
+
+    this->bucketSize = bucketSize;
+}
+
+
+void DataStream::SetShuffleBufferSize(const unsigned long shuffleBufferSize)
+{
+    verify(shuffleBufferSize > 0);
+
+    this->shuffleBufferSize = shuffleBufferSize;
+}
+
+
+void DataStream::SetBlockSize(const unsigned long blockSize)
+{
+    verify(blockSize > 0);
+
+    this->blockSize = blockSize;
+}
+
+
+void DataStream::GetBucketStats(unsigned long &nFrame, unsigned long &nPadFrame, unsigned long &nPadFrameShuffle) const
+{
+    nFrame = bucketFrame;
+    nPadFrame = bucketPadFrame;
+    nPadFrameShuffle = bucketPadFrameShuffle;
+}
+
+
 }
 
@@ -35,7 +35,27 @@ class DataSet;
 class DataStream : public Stream
 {
 public:
-    enum DataOrder {ORDER_SHUFFLE, ORDER_RANDOM, ORDER_SEQUENTIAL};
+    /* ORDER_BUCKETED: sequences of similar length (DataSet::GetNumFrame) are handed out nStream at a
+       time, so that the streams start and end their sequences at about the same time. The sequences
+       are sorted by length (ties in random order), cut into buckets of bucketSize sequences,
+       shuffled within each bucket and then cut into groups of nStream, and the order of the groups
+       is shuffled across the buckets. A smaller bucket size groups more similar lengths at the
+       cost of less randomness.
+
+       Out-of-core orders, for data sets that are read from storage and do not fit in the page cache:
+
+       ORDER_SHUFFLE_BUFFER: the sequences are read in sequential order into a buffer of shuffleBufferSize
+       sequences, and each new sequence is drawn at random from the buffer. The accesses stay within a
+       window of about shuffleBufferSize consecutive sequences. The passes over the data set are
+       continuous, so a sequence read near the end of a pass may be drawn in the next one.
+
+       ORDER_BLOCK_SHUFFLE: the data set is cut into blocks of blockSize consecutive sequences, the order
+       of the blocks is shuffled and then the sequences within each block. The accesses stay within one
+       block at a time.
+
+       Both are deterministic given SetRandomSeed(). */
+    enum DataOrder {ORDER_SHUFFLE, ORDER_RANDOM, ORDER_SEQUENTIAL, ORDER_BUCKETED,
+        ORDER_SHUFFLE_BUFFER, ORDER_BLOCK_SHUFFLE};
 
     DataStream();
 
@@ -49,29 +69,72 @@ public:
     void Next(const unsigned long streamIdx);
     void GenerateFrame(const unsigned long streamIdx, const unsigned long channelIdx, FLOAT *const frame);
 
+    const FrameType GetFrameType(const unsigned long channelIdx) const;
+    void GenerateCompactFrame(const unsigned long streamIdx, const unsigned long channelIdx, void *const frame);
+    void GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const;
+
+    /* Frame of a delayed channel in place (in the type of the channel), valid until the next Next(streamIdx);
+       NULL if the channel is not delayed */
+    const void *GetFramePtr(const unsigned long streamIdx, const unsigned long channelIdx) const;
+
     void SetDelay(const unsigned long channelIdx, const unsigned long delay);
     void LinkDataSet(DataSet *dataSet);
     void UnlinkDataSet();
 
     void SetRandomSeed(const unsigned long long seed);
     void SetDataOrder(const DataOrder order);
+    void SetBucketSize(const unsigned long bucketSize);
+    void SetShuffleBufferSize(const unsigned long shuffleBufferSize);
+    void SetBlockSize(const unsigned long blockSize);
+
+    /* Boundary waste of the current ORDER_BUCKETED order: the frames the streams would be padded with
+       if each group of nStream sequences were padded to its longest sequence (nPadFrame), and the same
+       for the plain shuffled order (nPadFrameShuffle), against nFrame frames of data */
+    void GetBucketStats(unsigned long &nFrame, unsigned long &nPadFrame, unsigned long &nPadFrameShuffle) const;
+
+    /* Number of sequences ahead of the streams passed to DataSet::Prefetch() (not with ORDER_RANDOM) */
+    void SetPrefetchDepth(const unsigned long depth);
 
 protected:
     void Alloc();
     void NewSeq(const unsigned long streamIdx);
     void Shuffle();
+    void BucketShuffle();
+    void BlockShuffle();
+    const unsigned long PadFrames(const std::vector<unsigned long> &order, const std::vector<unsigned long> &seqLen) const;
+    void PrefetchSeq(const unsigned long from, const unsigned long n);
+    inline unsigned char *RingFrame(const unsigned long streamIdx, const unsigned long channelIdx) const
+    {
+        return ringBase[channelIdx] + (streamIdx * delay[channelIdx] + ringPos[streamIdx] % delay[channelIdx]) * frameStride[channelIdx];
+    }
 
     unsigned long nStream;
     unsigned long nChannel;
 
     std::vector<unsigned long> dim;
     std::vector<unsigned long> delay;
+    std::vector<FrameType> frameType;
+    std::vector<unsigned long> frameBytes;
+    std::vector<std::vector<FLOAT>> dequantTable;
     std::vector<unsigned long> seqIdx, frameIdx;
-    std::vector<std::vector<unsigned long>> bufIdx;
-    std::vector<std::vector<std::vector<FLOAT>>> buf;
+
+    /* Delayed frames in the type of the channel: one ring per channel of delay frames per stream,
+       frame (stream, slot) at (stream * delay + slot) * frameStride bytes from the aligned ringBase */
+    std::vector<unsigned long> ringPos; /* frames stored since Reset(), per stream */
+    std::vector<unsigned long> frameStride;
+    std::vector<std::vector<unsigned char>> ring;
+    std::vector<unsigned char *> ringBase;
 
     std::vector<unsigned long> shuffledSeqIdx;
     unsigned long nextSeqIdx;
+    unsigned long prefetchDepth;
+
+    unsigned long bucketSize;
+    unsigned long bucketFrame, bucketPadFrame, bucketPadFrameShuffle;
+
+    unsigned long shuffleBufferSize;
+    std::vector<unsigned long> shuffleBuffer;
+    unsigned long blockSize;
 
     DataSet *dataSet;
 
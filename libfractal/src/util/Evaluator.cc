@@ -56,7 +56,7 @@ void Evaluator::Evaluate(Rnn &rnn, Stream &stream, const PortMapList &inputPorts
 	std::vector<Probe> inputProbe(args.nInput);
 	std::vector<Probe> outputProbe(args.nOutput);
 
-	std::vector<Matrix<FLOAT>> input(args.nInput);
+	std::vector<InputBuffer> input(args.nInput);
 	std::vector<Matrix<FLOAT>> output(args.nOutput);
 	std::vector<Matrix<FLOAT>> outputBuf(args.nOutput);
 
@@ -115,8 +115,7 @@ void Evaluator::Evaluate(Rnn &rnn, Stream &stream, const PortMapList &inputPorts
 		unsigned long dim = stream.GetDimension(inputChannel[i]);
 		verify(inputProbe[i].GetLayerSize() == dim);
 
-		input[i].Resize(dim, args.frameStep);
-		input[i].SetEngine(engine);
+		input[i].Init(stream, inputChannel[i], args.frameStep, engine);
 	}
 
 	portIter_end = outputPorts.end();
@@ -239,9 +238,7 @@ void Evaluator::EvaluatePipe0(Evaluator *evaluator, EvaluateArgs &args)
 			{
 				for(unsigned long j = 0; j < args.nInput; j++)
 				{
-					unsigned long dim = args.stream->GetDimension(args.inputChannel[j]);
-					args.stream->GenerateFrame(streamIdx, args.inputChannel[j],
-							args.input[j].GetHostData() + (i * args.nStream + streamIdx) * dim);
+					args.input[j].GenerateFrame(*args.stream, streamIdx, i * args.nStream + streamIdx);
 				}
 
 				for(unsigned long j = 0; j < args.nOutput; j++)
@@ -274,8 +271,7 @@ void Evaluator::EvaluatePipe1(Evaluator *evaluator, EvaluateArgs &args)
 		for(unsigned long i = 0; i < args.nInput; i++)
 		{
 			args.input[i].HostPush();
-			engine->MemPull(args.input[i].GetMem(), LOC, evaluator->pStreamDataTransferToBuf);
-			//args.input[i].Pull(LOC, evaluator->pStreamDataTransferToBuf);
+			args.input[i].MemPull(LOC, evaluator->pStreamDataTransferToBuf);
 		}
 
 		/* Propagate the target sequences */
@@ -310,9 +306,8 @@ void Evaluator::EvaluatePipe2(Evaluator *evaluator, EvaluateArgs &args)
 		for(unsigned long i = 0; i < args.nInput; i++)
 		{
 			Matrix<FLOAT> stateSub(args.inputProbe[i].GetState(), batchFrom, batchTo);
-			Matrix<FLOAT> inputSub(args.input[i], 0, batchTo - batchFrom);
 
-			engine->MatCopy(inputSub, stateSub, evaluator->pStreamDataTransferToRnn);
+			args.input[i].CopyTo(stateSub, evaluator->pStreamDataTransferToRnn);
 
 			engine->EventRecord(evaluator->pEventDataTransferToRnn, evaluator->pStreamDataTransferToRnn);
 			engine->StreamWaitEvent(args.inputProbe[i].GetPStream(), evaluator->pEventDataTransferToRnn);
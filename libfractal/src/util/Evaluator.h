@@ -18,6 +18,7 @@
 #ifndef FRACTAL_EVALUATOR_H_
 #define FRACTAL_EVALUATOR_H_
 
+#include "InputBuffer.h"
 #include "Pipe.h"
 #include "PortMap.h"
 #include "Stream.h"
@@ -46,7 +47,7 @@ public:
 	unsigned long *inputChannel;
 	unsigned long *outputChannel;
 
-	Matrix<FLOAT> *input;
+	InputBuffer *input;
 	Matrix<FLOAT> *output, *outputBuf;
 	Matrix<FLOAT> *target;
 	Matrix<FLOAT> *targetPipe1, *targetPipe2, *targetPipe3, *targetPipe4, *targetPipe5;
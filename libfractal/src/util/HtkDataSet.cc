@@ -0,0 +1,588 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "HtkDataSet.h"
+
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+
+/* Hints beyond this are dropped */
+#define PREFETCH_QUEUE_MAX 4096
+
+/* Parameter kind flags */
+#define HTK_WAVEFORM 0
+#define HTK_KIND_MASK 077
+#define HTK_COMPRESSED 02000
+
+
+namespace fractal
+{
+
+namespace
+{
+
+inline uint32_t Swap32(const uint32_t x)
+{
+	return __builtin_bswap32(x);
+}
+
+
+inline uint16_t Swap16(const uint16_t x)
+{
+	return __builtin_bswap16(x);
+}
+
+
+/* n samples of 4-byte floats in the byte order of the file */
+void ReadSamples(const unsigned char *src, FLOAT *dst, const unsigned long n, const bool bigEndian)
+{
+	unsigned long i = 0;
+
+#ifdef FRACTAL_SINGLE_PRECISION
+	if(bigEndian == false)
+	{
+		memcpy(dst, src, sizeof(float) * n);
+		return;
+	}
+
+#if defined(__AVX2__)
+	const __m256i shuffle = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for(; i + 8 <= n; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + sizeof(float) * i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(v, shuffle));
+	}
+#elif defined(__SSSE3__)
+	const __m128i shuffle = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for(; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + sizeof(float) * i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(v, shuffle));
+	}
+#endif
+#endif /* FRACTAL_SINGLE_PRECISION */
+
+	for(; i < n; i++)
+	{
+		uint32_t u;
+		float f;
+
+		memcpy(&u, src + sizeof(float) * i, sizeof(uint32_t));
+		if(bigEndian == true) u = Swap32(u);
+		memcpy(&f, &u, sizeof(float));
+
+		dst[i] = (FLOAT) f;
+	}
+}
+
+}
+
+
+HtkDataSet::HtkDataSet()
+{
+	dim = 0;
+	sampSize = 0;
+	sampPeriod = 0;
+	maxMapped = 1024;
+	nPrefetchThread = 1;
+	prefetchStop = false;
+}
+
+
+HtkDataSet::~HtkDataSet()
+{
+	Close();
+}
+
+
+void HtkDataSet::Open(const std::string &scriptFile)
+{
+	std::ifstream fileStream;
+	std::string line;
+	std::unordered_map<std::string, unsigned long> fileIdx;
+	unsigned long i;
+
+	Close();
+
+	fileStream.open(scriptFile);
+	verify(fileStream.is_open() == true);
+
+	while(std::getline(fileStream, line))
+	{
+		size_t begin = line.find_first_not_of(" \t\r");
+		size_t end = line.find_last_not_of(" \t\r");
+
+		if(begin == std::string::npos) continue;
+		line = line.substr(begin, end - begin + 1);
+
+		Seq s;
+		std::string path = line;
+		size_t eq = line.find('=');
+
+		s.first = -1;
+		s.last = -1;
+
+		if(eq != std::string::npos)
+			path = line.substr(eq + 1);
+
+		if(path.back() == ']')
+		{
+			size_t bracket = path.rfind('[');
+			verify(bracket != std::string::npos);
+
+			const char *range = path.c_str() + bracket + 1;
+			char *next;
+
+			s.first = strtol(range, &next, 10);
+			verify(*next == ',');
+			s.last = strtol(next + 1, &next, 10);
+			verify(*next == ']');
+			verify(s.first >= 0 && s.last >= s.first);
+
+			path = path.substr(0, bracket);
+		}
+
+		s.name = (eq != std::string::npos) ? line.substr(0, eq) : path;
+
+		std::unordered_map<std::string, unsigned long>::iterator iter = fileIdx.find(path);
+		if(iter == fileIdx.end())
+		{
+			iter = fileIdx.insert(std::make_pair(path, file.size())).first;
+			file.push_back(File());
+			file.back().path = path;
+		}
+		s.fileIdx = iter->second;
+
+		seq.push_back(s);
+	}
+
+	verify(seq.empty() == false);
+
+	nFrame.reset(new std::atomic<long>[seq.size()]);
+	seqBase.reset(new std::atomic<const unsigned char *>[seq.size()]);
+	for(i = 0; i < seq.size(); i++)
+	{
+		nFrame[i] = (seq[i].first >= 0) ? seq[i].last - seq[i].first + 1 : -1;
+		seqBase[i] = NULL;
+	}
+
+	/* The first header gives the dimension */
+	LoadHeader(seq[0].fileIdx);
+
+	sampSize = file[seq[0].fileIdx].sampSize;
+	sampPeriod = file[seq[0].fileIdx].sampPeriod;
+	dim = sampSize / sizeof(float);
+
+	SetNumPrefetchThread(nPrefetchThread);
+}
+
+
+void HtkDataSet::Close()
+{
+	std::vector<File>::iterator iter, iter_end;
+	unsigned long i;
+
+	StopPrefetch();
+
+	/* Sequences not read to the end */
+	for(i = 0; i < seq.size(); i++)
+	{
+		if(seqBase[i].exchange(NULL) != NULL)
+			Unpin(seq[i].fileIdx);
+	}
+
+	iter_end = file.end();
+	for(iter = file.begin(); iter != iter_end; iter++)
+	{
+		verify(iter->nPin == 0);
+
+		if(iter->base != NULL)
+			munmap(const_cast<unsigned char *>(iter->base), iter->size);
+	}
+
+	seq.clear();
+	file.clear();
+	lru.clear();
+	nFrame.reset();
+	seqBase.reset();
+
+	dim = 0;
+	sampSize = 0;
+	sampPeriod = 0;
+}
+
+
+void HtkDataSet::SetNumPrefetchThread(const unsigned long nThread)
+{
+	unsigned long i;
+
+	StopPrefetch();
+
+	nPrefetchThread = nThread;
+
+	if(seq.empty() == true) return;
+
+	for(i = 0; i < nPrefetchThread; i++)
+		prefetchThread.push_back(std::thread(&HtkDataSet::PrefetchWorker, this));
+}
+
+
+void HtkDataSet::SetMaxMapped(const unsigned long maxMapped)
+{
+	verify(maxMapped > 0);
+
+	std::lock_guard<std::mutex> lock(mtx);
+
+	this->maxMapped = maxMapped;
+}
+
+
+const unsigned long HtkDataSet::GetNumChannel() const
+{
+	return 1;
+}
+
+
+const unsigned long HtkDataSet::GetDimension(const unsigned long channelIdx) const
+{
+	verify(channelIdx == 0);
+
+	return dim;
+}
+
+
+const unsigned long HtkDataSet::GetNumSeq() const
+{
+	return seq.size();
+}
+
+
+const unsigned long HtkDataSet::GetNumFrame(const unsigned long seqIdx) const
+{
+	verify(seqIdx < seq.size());
+
+	long n = nFrame[seqIdx].load(std::memory_order_acquire);
+
+	if(n < 0)
+	{
+		LoadHeader(seq[seqIdx].fileIdx);
+
+		std::lock_guard<std::mutex> lock(mtx);
+
+		n = file[seq[seqIdx].fileIdx].nSample;
+		nFrame[seqIdx].store(n, std::memory_order_release);
+	}
+
+	return n;
+}
+
+
+void HtkDataSet::GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+		const unsigned long frameIdx, FLOAT *const frame)
+{
+	verify(channelIdx == 0);
+	verify(frameIdx < GetNumFrame(seqIdx));
+
+	const Seq &s = seq[seqIdx];
+	const unsigned long offset = HEADER_SIZE + ((s.first >= 0 ? s.first : 0) + frameIdx) * sampSize;
+	const unsigned char *base = seqBase[seqIdx].load(std::memory_order_acquire);
+
+	/* Pin the file on the first frame read and keep it until the last one */
+	if(base == NULL)
+	{
+		base = Pin(s.fileIdx);
+		seqBase[seqIdx].store(base, std::memory_order_release);
+	}
+
+	const File &f = file[s.fileIdx];
+
+	verify(offset + sampSize <= f.size);
+
+	ReadSamples(base + offset, frame, dim, f.bigEndian);
+
+	if(frameIdx + 1 == GetNumFrame(seqIdx))
+	{
+		seqBase[seqIdx].store(NULL, std::memory_order_relaxed);
+		Unpin(s.fileIdx);
+	}
+}
+
+
+void HtkDataSet::Prefetch(const unsigned long seqIdx)
+{
+	verify(seqIdx < seq.size());
+
+	if(prefetchThread.empty() == true) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+
+		if(prefetchQueue.size() >= PREFETCH_QUEUE_MAX) return;
+		prefetchQueue.push_back(seqIdx);
+	}
+
+	prefetchCv.notify_one();
+}
+
+
+const std::string &HtkDataSet::GetName(const unsigned long seqIdx) const
+{
+	verify(seqIdx < seq.size());
+
+	return seq[seqIdx].name;
+}
+
+
+const unsigned long HtkDataSet::GetSamplePeriod() const
+{
+	return sampPeriod;
+}
+
+
+void HtkDataSet::ReadHeader(File &f) const
+{
+	unsigned char header[HEADER_SIZE];
+	uint32_t nSampleRaw, periodRaw;
+	uint16_t sizeRaw, kindRaw;
+	struct stat st;
+	int fd;
+	bool validBig, validLittle;
+
+	fd = open(f.path.c_str(), O_RDONLY);
+	verify(fd >= 0);
+	verify(fstat(fd, &st) == 0);
+	verify(pread(fd, header, HEADER_SIZE, 0) == (ssize_t) HEADER_SIZE);
+	close(fd);
+
+	memcpy(&nSampleRaw, header, sizeof(uint32_t));
+	memcpy(&periodRaw, header + 4, sizeof(uint32_t));
+	memcpy(&sizeRaw, header + 8, sizeof(uint16_t));
+	memcpy(&kindRaw, header + 10, sizeof(uint16_t));
+
+	/* HTK writes big endian; take little endian only if the big-endian header does not fit the file */
+	validBig = Swap16(sizeRaw) > 0 && Swap16(sizeRaw) % sizeof(float) == 0 && (Swap16(kindRaw) & HTK_KIND_MASK) != HTK_WAVEFORM
+		&& HEADER_SIZE + (unsigned long) Swap32(nSampleRaw) * Swap16(sizeRaw) <= (unsigned long) st.st_size;
+	validLittle = sizeRaw > 0 && sizeRaw % sizeof(float) == 0 && (kindRaw & HTK_KIND_MASK) != HTK_WAVEFORM
+		&& HEADER_SIZE + (unsigned long) nSampleRaw * sizeRaw <= (unsigned long) st.st_size;
+
+	verify(validBig == true || validLittle == true);
+
+	f.bigEndian = validBig;
+	if(f.bigEndian == true)
+	{
+		nSampleRaw = Swap32(nSampleRaw);
+		periodRaw = Swap32(periodRaw);
+		sizeRaw = Swap16(sizeRaw);
+		kindRaw = Swap16(kindRaw);
+	}
+
+	verify((kindRaw & HTK_COMPRESSED) == 0);
+
+	/* All files have the dimension of the first one */
+	verify(sampSize == 0 || sizeRaw == sampSize);
+
+	f.nSample = nSampleRaw;
+	f.sampSize = sizeRaw;
+	f.sampPeriod = periodRaw;
+	f.size = st.st_size;
+	f.headerRead = true;
+}
+
+
+void HtkDataSet::LoadHeader(const unsigned long fileIdx) const
+{
+	File header;
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+
+		if(file[fileIdx].headerRead == true) return;
+	}
+
+	/* The path does not change after Open() */
+	header.path = file[fileIdx].path;
+	ReadHeader(header);
+
+	std::lock_guard<std::mutex> lock(mtx);
+	File &f = file[fileIdx];
+
+	if(f.headerRead == true) return;
+
+	f.bigEndian = header.bigEndian;
+	f.nSample = header.nSample;
+	f.sampSize = header.sampSize;
+	f.sampPeriod = header.sampPeriod;
+	f.size = header.size;
+	f.headerRead = true;
+}
+
+
+const unsigned char *HtkDataSet::Pin(const unsigned long fileIdx)
+{
+	File &f = file[fileIdx];
+	const unsigned char *base;
+	unsigned long size;
+	void *addr;
+	int fd;
+
+	LoadHeader(fileIdx);
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+
+		if(f.base != NULL)
+		{
+			if(f.nPin == 0) lru.erase(f.lruIter);
+			f.nPin++;
+
+			return f.base;
+		}
+
+		size = f.size;
+	}
+
+	/* Map the file outside the lock */
+	fd = open(f.path.c_str(), O_RDONLY);
+	verify(fd >= 0);
+
+	addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	verify(addr != MAP_FAILED);
+	close(fd);
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+
+		if(f.base == NULL)
+		{
+			f.base = reinterpret_cast<const unsigned char *>(addr);
+			addr = NULL;
+
+			/* Unmap the least recently used files beyond maxMapped (counting this one) */
+			while(lru.size() >= maxMapped)
+			{
+				File &victim = file[lru.front()];
+
+				munmap(const_cast<unsigned char *>(victim.base), victim.size);
+				victim.base = NULL;
+				lru.pop_front();
+			}
+		}
+		else if(f.nPin == 0)
+		{
+			/* Mapped by another thread meanwhile */
+			lru.erase(f.lruIter);
+		}
+
+		f.nPin++;
+		base = f.base;
+	}
+
+	if(addr != NULL)
+		munmap(addr, size);
+
+	return base;
+}
+
+
+void HtkDataSet::Unpin(const unsigned long fileIdx)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	File &f = file[fileIdx];
+
+	verify(f.nPin > 0);
+
+	f.nPin--;
+
+	if(f.nPin == 0)
+		f.lruIter = lru.insert(lru.end(), fileIdx);
+}
+
+
+void HtkDataSet::PrefetchWorker()
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+
+	while(true)
+	{
+		unsigned long seqIdx;
+
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+
+			while(prefetchQueue.empty() == true && prefetchStop == false)
+				prefetchCv.wait(lock);
+
+			if(prefetchStop == true) return;
+
+			seqIdx = prefetchQueue.front();
+			prefetchQueue.pop_front();
+		}
+
+		const Seq &s = seq[seqIdx];
+		const unsigned long n = GetNumFrame(seqIdx);
+		const unsigned char *base = Pin(s.fileIdx);
+
+		unsigned long from = HEADER_SIZE + (s.first >= 0 ? s.first : 0) * sampSize;
+		unsigned long to = std::min(from + n * sampSize, file[s.fileIdx].size);
+
+		from = from / pageSize * pageSize;
+		if(to > from)
+			madvise(const_cast<unsigned char *>(base) + from, to - from, MADV_WILLNEED);
+
+		Unpin(s.fileIdx);
+	}
+}
+
+
+void HtkDataSet::StopPrefetch()
+{
+	std::vector<std::thread>::iterator iter, iter_end;
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		prefetchStop = true;
+	}
+	prefetchCv.notify_all();
+
+	iter_end = prefetchThread.end();
+	for(iter = prefetchThread.begin(); iter != iter_end; iter++)
+		iter->join();
+
+	prefetchThread.clear();
+	prefetchQueue.clear();
+	prefetchStop = false;
+}
+
+}
+
@@ -0,0 +1,138 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_HTKDATASET_H_
+#define FRACTAL_HTKDATASET_H_
+
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "DataSet.h"
+#include "../core/FractalCommon.h"
+
+
+namespace fractal
+{
+
+/* HTK feature files as a data set of one channel (the feature vectors).
+ *
+ * The script file lists one sequence per line as "[name=]file[[first,last]]": the frames first to
+ * last of the file (HTK extended file name), or the whole file. Several sequences may share a file
+ * (archive). Only the first header is read by Open(); the other headers are read when the length of
+ * a sequence is needed, and the files are memory-mapped when read, so that nothing is preloaded and
+ * the corpus may be much larger than the memory. At most maxMapped files stay mapped (LRU).
+ *
+ * Prefetch() (called by DataStream ahead of the sequences it will read) queues a sequence for the
+ * prefetch threads, which read its header, map its file and ask the kernel to read the frames ahead
+ * (MADV_WILLNEED). The headers are read and the files mapped outside the lock, so the prefetch I/O
+ * does not stall the reading thread.
+ *
+ * The file of a sequence is pinned from the first frame read until its last frame is read, so that
+ * the frames in between need no locking. A sequence is read by one thread at a time (as DataStream
+ * does); a sequence left before its end keeps its file mapped until it is read to the end or Close().
+ *
+ * The samples are big endian as written by HTK, or little endian if the header only makes sense in
+ * that order. Compressed (_C) and waveform files are not supported. */
+class HtkDataSet : public DataSet
+{
+public:
+	HtkDataSet();
+	virtual ~HtkDataSet();
+
+	void Open(const std::string &scriptFile);
+	void Close();
+
+	void SetNumPrefetchThread(const unsigned long nThread);
+	void SetMaxMapped(const unsigned long maxMapped);
+
+	const unsigned long GetNumChannel() const;
+	const unsigned long GetDimension(const unsigned long channelIdx) const;
+	const unsigned long GetNumSeq() const;
+	const unsigned long GetNumFrame(const unsigned long seqIdx) const;
+
+	void GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+			const unsigned long frameIdx, FLOAT *const frame);
+
+	void Prefetch(const unsigned long seqIdx);
+
+	const std::string &GetName(const unsigned long seqIdx) const;
+	const unsigned long GetSamplePeriod() const; /* in 100 ns */
+
+protected:
+	class File
+	{
+	public:
+		File() : headerRead(false), bigEndian(true), nSample(0), sampSize(0), sampPeriod(0), base(NULL), size(0), nPin(0) {}
+
+		std::string path;
+		bool headerRead;
+		bool bigEndian;
+		unsigned long nSample, sampSize, sampPeriod;
+		const unsigned char *base; /* NULL if not mapped */
+		unsigned long size;
+		unsigned long nPin;
+		std::list<unsigned long>::iterator lruIter;
+	};
+
+	class Seq
+	{
+	public:
+		std::string name;
+		unsigned long fileIdx;
+		long first, last; /* -1: whole file */
+	};
+
+	static const unsigned long HEADER_SIZE = 12;
+
+	void ReadHeader(File &file) const; /* without mtx locked, into a copy */
+	void LoadHeader(const unsigned long fileIdx) const; /* reads and publishes the header once */
+	const unsigned char *Pin(const unsigned long fileIdx); /* maps the file */
+	void Unpin(const unsigned long fileIdx);
+	void PrefetchWorker();
+	void StopPrefetch();
+
+	unsigned long dim;
+	unsigned long sampSize;
+	unsigned long sampPeriod;
+
+	std::vector<Seq> seq;
+	mutable std::vector<File> file;
+	std::unique_ptr<std::atomic<long>[]> nFrame; /* -1 until the header is read */
+	std::unique_ptr<std::atomic<const unsigned char *>[]> seqBase; /* mapping pinned by each sequence being read */
+
+	mutable std::mutex mtx;
+	std::list<unsigned long> lru; /* mapped files, unpinned last at the front */
+	unsigned long maxMapped;
+
+	unsigned long nPrefetchThread;
+	std::vector<std::thread> prefetchThread;
+	std::deque<unsigned long> prefetchQueue;
+	std::condition_variable prefetchCv;
+	bool prefetchStop;
+};
+
+}
+
+#endif /* FRACTAL_HTKDATASET_H_ */
+
@@ -0,0 +1,168 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "InputBuffer.h"
+
+
+namespace fractal
+{
+
+InputBuffer::InputBuffer()
+{
+	frameType = FRAME_FLOAT;
+	channelIdx = 0;
+	dim = 0;
+	engine = NULL;
+}
+
+
+void InputBuffer::Init(Stream &stream, const unsigned long channelIdx, const unsigned long nCols, Engine *engine)
+{
+	this->channelIdx = channelIdx;
+	this->engine = engine;
+
+	frameType = stream.GetFrameType(channelIdx);
+	dim = stream.GetDimension(channelIdx);
+
+	switch(frameType)
+	{
+		case FRAME_FLOAT:
+			data.Resize(dim, nCols);
+			data.SetEngine(engine);
+			break;
+
+		case FRAME_UINT8:
+			dataU8.Resize(dim, nCols);
+			dataU8.SetEngine(engine);
+
+			table.Resize(256, 1);
+			table.SetEngine(engine);
+			stream.GetDequantTable(channelIdx, table.GetHostData());
+			table.HostPush();
+			break;
+
+		case FRAME_FP16:
+			dataF16.Resize(dim, nCols);
+			dataF16.SetEngine(engine);
+			break;
+
+		default:
+			verify(false);
+	}
+}
+
+
+void InputBuffer::GenerateFrame(Stream &stream, const unsigned long streamIdx, const unsigned long col)
+{
+	switch(frameType)
+	{
+		case FRAME_FLOAT:
+			stream.GenerateFrame(streamIdx, channelIdx, data.GetHostData() + col * dim);
+			break;
+
+		case FRAME_UINT8:
+			stream.GenerateCompactFrame(streamIdx, channelIdx, dataU8.GetHostData() + col * dim);
+			break;
+
+		case FRAME_FP16:
+			stream.GenerateCompactFrame(streamIdx, channelIdx, dataF16.GetHostData() + col * dim);
+			break;
+
+		default:
+			verify(false);
+	}
+}
+
+
+void InputBuffer::HostPush()
+{
+	switch(frameType)
+	{
+		case FRAME_FLOAT:
+			data.HostPush();
+			break;
+
+		case FRAME_UINT8:
+			dataU8.HostPush();
+			break;
+
+		case FRAME_FP16:
+			dataF16.HostPush();
+			break;
+
+		default:
+			verify(false);
+	}
+}
+
+
+void InputBuffer::MemPull(const unsigned long loc, PStream &stream)
+{
+	switch(frameType)
+	{
+		case FRAME_FLOAT:
+			engine->MemPull(data.GetMem(), loc, stream);
+			break;
+
+		case FRAME_UINT8:
+			engine->MemPull(dataU8.GetMem(), loc, stream);
+			break;
+
+		case FRAME_FP16:
+			engine->MemPull(dataF16.GetMem(), loc, stream);
+			break;
+
+		default:
+			verify(false);
+	}
+}
+
+
+void InputBuffer::CopyTo(Matrix<FLOAT> &dst, PStream &stream)
+{
+	verify(dst.GetNumCols() > 0);
+
+	switch(frameType)
+	{
+		case FRAME_FLOAT:
+			{
+				Matrix<FLOAT> dataSub(data, 0, dst.GetNumCols() - 1);
+				engine->MatCopy(dataSub, dst, stream);
+			}
+			break;
+
+		case FRAME_UINT8:
+			{
+				Matrix<unsigned char> dataSub(dataU8, 0, dst.GetNumCols() - 1);
+				engine->Dequant(dataSub, table, dst, stream);
+			}
+			break;
+
+		case FRAME_FP16:
+			{
+				Matrix<unsigned short> dataSub(dataF16, 0, dst.GetNumCols() - 1);
+				engine->HalfToFloat(dataSub, dst, stream);
+			}
+			break;
+
+		default:
+			verify(false);
+	}
+}
+
+}
+
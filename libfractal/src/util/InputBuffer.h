@@ -0,0 +1,68 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_INPUTBUFFER_H_
+#define FRACTAL_INPUTBUFFER_H_
+
+#include "Stream.h"
+#include "../core/Engine.h"
+#include "../core/Matrix.h"
+#include "../core/FractalCommon.h"
+
+
+namespace fractal
+{
+
+/* Staging buffer of the frames of an input channel. The frames stay in the type of the channel
+ * (Stream::GetFrameType) on the host and through the transfer to the engine, and are converted
+ * to FLOAT by the copy into the RNN. A uint8 (fp16) channel takes 1/4 (1/2) of the host memory
+ * and of the transfer volume of a FLOAT channel. */
+class InputBuffer
+{
+public:
+	InputBuffer();
+
+	/* nCols frames of channel channelIdx of the stream */
+	void Init(Stream &stream, const unsigned long channelIdx, const unsigned long nCols, Engine *engine);
+
+	inline const FrameType GetFrameType() const { return frameType; }
+
+	/* Column col = the current frame of stream streamIdx */
+	void GenerateFrame(Stream &stream, const unsigned long streamIdx, const unsigned long col);
+
+	void HostPush();
+	void MemPull(const unsigned long loc, PStream &stream);
+
+	/* dst = frames [0, dst.GetNumCols()) in FLOAT */
+	void CopyTo(Matrix<FLOAT> &dst, PStream &stream);
+
+protected:
+	FrameType frameType;
+	unsigned long channelIdx;
+	unsigned long dim;
+	Engine *engine;
+
+	Matrix<FLOAT> data;
+	Matrix<unsigned char> dataU8;
+	Matrix<unsigned short> dataF16;
+	Matrix<FLOAT> table;
+};
+
+}
+
+#endif /* FRACTAL_INPUTBUFFER_H_ */
+
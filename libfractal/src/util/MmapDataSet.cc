@@ -0,0 +1,544 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "MmapDataSet.h"
+#include "../core/HostAct.h"
+
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace fractal
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'F', 'R', 'A', 'C', 'M', 'M', 'A', 'P'};
+const uint32_t VERSION = 1;
+const uint64_t ALIGN = 4096;
+const uint64_t WRITE_CHUNK = 64 << 20; /* bytes of frames gathered before writing the channel blocks */
+
+class FileHeader
+{
+public:
+	char magic[8];
+	uint32_t version;
+	uint32_t nChannel;
+	uint64_t nSeq;
+	uint64_t nFrame;
+};
+
+class FileChannel
+{
+public:
+	uint32_t format;
+	uint32_t reserved;
+	uint64_t dim;
+	uint64_t offset; /* of the block, from the beginning of the file */
+	float table[256];
+};
+
+
+inline uint64_t Align(const uint64_t x)
+{
+	return (x + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+
+/* Round to nearest even; NaN becomes a quiet NaN */
+uint16_t FloatToHalf(const float x)
+{
+	const uint32_t infBits = 255u << 23;
+	const uint32_t maxBits = (127u + 16u) << 23; /* 2^16, rounds to infinity */
+	const uint32_t denormBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+	uint32_t u, sign;
+	uint16_t h;
+
+	memcpy(&u, &x, sizeof(uint32_t));
+	sign = u & 0x80000000u;
+	u ^= sign;
+
+	if(u >= maxBits)
+	{
+		h = (u > infBits) ? 0x7e00 : 0x7c00;
+	}
+	else if(u < (113u << 23))
+	{
+		/* Subnormal or zero: let the float adder round the mantissa */
+		float f, denorm;
+
+		memcpy(&f, &u, sizeof(float));
+		memcpy(&denorm, &denormBits, sizeof(float));
+		f += denorm;
+		memcpy(&u, &f, sizeof(uint32_t));
+		h = (uint16_t) (u - denormBits);
+	}
+	else
+	{
+		uint32_t mantOdd = (u >> 13) & 1;
+
+		u += ((uint32_t) (15 - 127) << 23) + 0xfff;
+		u += mantOdd;
+		h = (uint16_t) (u >> 13);
+	}
+
+	return h | (uint16_t) (sign >> 16);
+}
+
+
+/* Index of the nearest entry of a sorted table */
+unsigned char NearestCode(const float *table, const float x)
+{
+	const float *it = std::lower_bound(table, table + 256, x);
+
+	if(it == table + 256) return 255;
+	if(it == table) return 0;
+	if(x - *(it - 1) <= *it - x) it--;
+
+	return (unsigned char) (it - table);
+}
+
+}
+
+
+const unsigned long MmapDataSet::FRAME_BYTES[] = {sizeof(float), sizeof(uint16_t), sizeof(unsigned char), sizeof(uint32_t)};
+
+
+MmapDataSet::MmapDataSet()
+{
+	fd = -1;
+	base = NULL;
+	size = 0;
+	nSeq = 0;
+	seqFrame = NULL;
+}
+
+
+MmapDataSet::~MmapDataSet()
+{
+	Close();
+}
+
+
+void MmapDataSet::Open(const std::string &filename)
+{
+	struct stat st;
+	void *addr;
+	const FileHeader *header;
+	const FileChannel *fileChannel;
+	unsigned long i, j;
+
+	Close();
+
+	fd = open(filename.c_str(), O_RDONLY);
+	verify(fd >= 0);
+
+	verify(fstat(fd, &st) == 0);
+	size = st.st_size;
+	verify(size >= sizeof(FileHeader));
+
+	addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	verify(addr != MAP_FAILED);
+	base = reinterpret_cast<unsigned char *>(addr);
+
+	header = reinterpret_cast<const FileHeader *>(base);
+	verify(memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0);
+	verify(header->version == VERSION);
+
+	/* Check the counts against the file size before using them as offsets */
+	verify(header->nChannel <= (size - sizeof(FileHeader)) / sizeof(FileChannel));
+	verify(header->nSeq < (size - sizeof(FileHeader) - header->nChannel * sizeof(FileChannel)) / sizeof(uint64_t));
+
+	nSeq = header->nSeq;
+	fileChannel = reinterpret_cast<const FileChannel *>(header + 1);
+	seqFrame = reinterpret_cast<const uint64_t *>(fileChannel + header->nChannel);
+	verify(seqFrame[nSeq] == header->nFrame);
+
+	channel.resize(header->nChannel);
+
+	for(i = 0; i < header->nChannel; i++)
+	{
+		Channel &c = channel[i];
+
+		verify(fileChannel[i].format <= FORMAT_LABEL);
+		c.format = static_cast<Format>(fileChannel[i].format);
+		c.dim = fileChannel[i].dim;
+		c.frameBytes = (c.format == FORMAT_LABEL) ? FRAME_BYTES[c.format] : c.dim * FRAME_BYTES[c.format];
+		verify(c.dim > 0);
+		verify(fileChannel[i].offset <= size && header->nFrame <= (size - fileChannel[i].offset) / c.frameBytes);
+		c.data = base + fileChannel[i].offset;
+
+		for(j = 0; j < 256; j++)
+			c.table[j] = (FLOAT) fileChannel[i].table[j];
+	}
+}
+
+
+void MmapDataSet::Close()
+{
+	if(base != NULL)
+	{
+		munmap(base, size);
+		base = NULL;
+	}
+
+	if(fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+
+	size = 0;
+	nSeq = 0;
+	seqFrame = NULL;
+	channel.clear();
+}
+
+
+/* Frames are read sequence by sequence, all channels of a frame in channel order, as a data stream does.
+ * With a FORMAT_UINT8 channel, the data set is read twice and must return the same data both times. */
+void MmapDataSet::Write(DataSet &dataSet, const std::vector<Format> &formats, const std::string &filename)
+{
+	unsigned long nChannel = dataSet.GetNumChannel();
+	unsigned long nSeqSrc = dataSet.GetNumSeq();
+	unsigned long i, j, k, m, seqIdx, frameIdx;
+
+	std::vector<FileChannel> fileChannel(nChannel);
+	std::vector<uint64_t> frameBytes(nChannel);
+	std::vector<uint64_t> seqFrameSrc(nSeqSrc + 1);
+	std::vector<std::vector<FLOAT>> frame(nChannel);
+	FileHeader header;
+
+	verify(formats.size() == nChannel);
+
+	seqFrameSrc[0] = 0;
+	for(seqIdx = 0; seqIdx < nSeqSrc; seqIdx++)
+		seqFrameSrc[seqIdx + 1] = seqFrameSrc[seqIdx] + dataSet.GetNumFrame(seqIdx);
+
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.nChannel = nChannel;
+	header.nSeq = nSeqSrc;
+	header.nFrame = seqFrameSrc[nSeqSrc];
+
+	for(i = 0; i < nChannel; i++)
+	{
+		memset(&fileChannel[i], 0, sizeof(FileChannel));
+		fileChannel[i].format = formats[i];
+		fileChannel[i].dim = dataSet.GetDimension(i);
+		frameBytes[i] = (formats[i] == FORMAT_LABEL) ? FRAME_BYTES[formats[i]] : fileChannel[i].dim * FRAME_BYTES[formats[i]];
+		frame[i].resize(fileChannel[i].dim);
+	}
+
+
+	/* Tables of the uint8 channels: the distinct values, or a uniform grid from the minimum to the maximum */
+	if(std::find(formats.begin(), formats.end(), FORMAT_UINT8) != formats.end())
+	{
+		std::vector<std::set<float>> values(nChannel);
+		std::vector<float> minValue(nChannel, INFINITY), maxValue(nChannel, -INFINITY);
+
+		for(seqIdx = 0; seqIdx < nSeqSrc; seqIdx++)
+		{
+			for(frameIdx = 0; frameIdx < seqFrameSrc[seqIdx + 1] - seqFrameSrc[seqIdx]; frameIdx++)
+			{
+				for(i = 0; i < nChannel; i++)
+				{
+					dataSet.GetFrameData(seqIdx, i, frameIdx, frame[i].data());
+					if(formats[i] != FORMAT_UINT8) continue;
+
+					for(k = 0; k < fileChannel[i].dim; k++)
+					{
+						float x = (float) frame[i][k];
+
+						minValue[i] = std::min(minValue[i], x);
+						maxValue[i] = std::max(maxValue[i], x);
+						if(values[i].size() <= 256) values[i].insert(x);
+					}
+				}
+			}
+		}
+
+		for(i = 0; i < nChannel; i++)
+		{
+			if(formats[i] != FORMAT_UINT8 || values[i].empty() == true) continue;
+
+			float *table = fileChannel[i].table;
+
+			if(values[i].size() <= 256)
+			{
+				std::copy(values[i].begin(), values[i].end(), table);
+				std::fill(table + values[i].size(), table + 256, *values[i].rbegin());
+			}
+			else
+			{
+				for(j = 0; j < 256; j++)
+					table[j] = minValue[i] + (maxValue[i] - minValue[i]) * (float) j / 255.0f;
+			}
+		}
+	}
+
+
+	/* Layout */
+	uint64_t end = sizeof(FileHeader) + nChannel * sizeof(FileChannel) + (nSeqSrc + 1) * sizeof(uint64_t);
+
+	for(i = 0; i < nChannel; i++)
+	{
+		fileChannel[i].offset = Align(end);
+		end = fileChannel[i].offset + header.nFrame * frameBytes[i];
+	}
+
+	std::ofstream fileStream;
+
+	fileStream.open(filename, std::ofstream::binary | std::ofstream::out | std::ofstream::trunc);
+	verify(fileStream.is_open() == true);
+
+	fileStream.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+	fileStream.write(reinterpret_cast<const char *>(fileChannel.data()), nChannel * sizeof(FileChannel));
+	fileStream.write(reinterpret_cast<const char *>(seqFrameSrc.data()), (nSeqSrc + 1) * sizeof(uint64_t));
+
+
+	/* Payload, gathered into per-channel chunks of consecutive sequences */
+	uint64_t bytesPerFrame = 0;
+	uint64_t chunkFrame;
+
+	for(i = 0; i < nChannel; i++)
+		bytesPerFrame += frameBytes[i];
+
+	chunkFrame = std::max((uint64_t) 1, WRITE_CHUNK / std::max(bytesPerFrame, (uint64_t) 1));
+
+	std::vector<std::vector<unsigned char>> chunk(nChannel);
+
+	seqIdx = 0;
+	while(seqIdx < nSeqSrc)
+	{
+		unsigned long seqEnd = seqIdx;
+
+		while(seqEnd < nSeqSrc && (seqEnd == seqIdx || seqFrameSrc[seqEnd + 1] - seqFrameSrc[seqIdx] <= chunkFrame))
+			seqEnd++;
+
+		for(i = 0; i < nChannel; i++)
+			chunk[i].resize((seqFrameSrc[seqEnd] - seqFrameSrc[seqIdx]) * frameBytes[i]);
+
+		for(m = seqIdx; m < seqEnd; m++)
+		{
+			for(frameIdx = 0; frameIdx < seqFrameSrc[m + 1] - seqFrameSrc[m]; frameIdx++)
+			{
+				uint64_t pos = seqFrameSrc[m] - seqFrameSrc[seqIdx] + frameIdx;
+
+				for(i = 0; i < nChannel; i++)
+				{
+					unsigned char *dst = chunk[i].data() + pos * frameBytes[i];
+					unsigned long dim = fileChannel[i].dim;
+
+					dataSet.GetFrameData(m, i, frameIdx, frame[i].data());
+
+					switch(formats[i])
+					{
+						case FORMAT_FP32:
+							for(k = 0; k < dim; k++)
+								reinterpret_cast<float *>(dst)[k] = (float) frame[i][k];
+							break;
+
+						case FORMAT_FP16:
+							for(k = 0; k < dim; k++)
+								reinterpret_cast<uint16_t *>(dst)[k] = FloatToHalf((float) frame[i][k]);
+							break;
+
+						case FORMAT_UINT8:
+							for(k = 0; k < dim; k++)
+								dst[k] = NearestCode(fileChannel[i].table, (float) frame[i][k]);
+							break;
+
+						case FORMAT_LABEL:
+						{
+							uint32_t label = dim;
+
+							for(k = 0; k < dim; k++)
+							{
+								if(frame[i][k] == (FLOAT) 1 && label == dim)
+									label = k;
+								else
+									verify(frame[i][k] == (FLOAT) 0);
+							}
+							verify(label < dim);
+
+							*reinterpret_cast<uint32_t *>(dst) = label;
+							break;
+						}
+
+						default:
+							verify(false);
+					}
+				}
+			}
+		}
+
+		for(i = 0; i < nChannel; i++)
+		{
+			fileStream.seekp(fileChannel[i].offset + seqFrameSrc[seqIdx] * frameBytes[i]);
+			fileStream.write(reinterpret_cast<const char *>(chunk[i].data()), chunk[i].size());
+		}
+
+		seqIdx = seqEnd;
+	}
+
+	/* Pad the file to a whole page */
+	if(Align(end) > end)
+	{
+		char zero = 0;
+
+		fileStream.seekp(Align(end) - 1);
+		fileStream.write(&zero, 1);
+	}
+
+	verify(fileStream.good() == true);
+	fileStream.close();
+}
+
+
+const unsigned long MmapDataSet::GetNumChannel() const
+{
+	return channel.size();
+}
+
+
+const unsigned long MmapDataSet::GetDimension(const unsigned long channelIdx) const
+{
+	verify(channelIdx < channel.size());
+
+	return channel[channelIdx].dim;
+}
+
+
+const unsigned long MmapDataSet::GetNumSeq() const
+{
+	return nSeq;
+}
+
+
+const unsigned long MmapDataSet::GetNumFrame(const unsigned long seqIdx) const
+{
+	verify(seqIdx < nSeq);
+
+	return seqFrame[seqIdx + 1] - seqFrame[seqIdx];
+}
+
+
+void MmapDataSet::GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+		const unsigned long frameIdx, FLOAT *const frame)
+{
+	verify(channelIdx < channel.size());
+	verify(seqIdx < nSeq);
+	verify(frameIdx < seqFrame[seqIdx + 1] - seqFrame[seqIdx]);
+
+	const Channel &c = channel[channelIdx];
+	const unsigned char *src = c.data + (seqFrame[seqIdx] + frameIdx) * c.frameBytes;
+	unsigned long i;
+
+	switch(c.format)
+	{
+		case FORMAT_FP32:
+			for(i = 0; i < c.dim; i++)
+				frame[i] = (FLOAT) reinterpret_cast<const float *>(src)[i];
+			break;
+
+		case FORMAT_FP16:
+			hostAct::HalfToFloat<FLOAT>(reinterpret_cast<const unsigned short *>(src), frame, c.dim);
+			break;
+
+		case FORMAT_UINT8:
+			for(i = 0; i < c.dim; i++)
+				frame[i] = c.table[src[i]];
+			break;
+
+		case FORMAT_LABEL:
+			{
+				const uint32_t label = *reinterpret_cast<const uint32_t *>(src);
+
+				verify(label < c.dim);
+
+				memset(frame, 0, sizeof(FLOAT) * c.dim);
+				frame[label] = (FLOAT) 1;
+			}
+			break;
+
+		default:
+			verify(false);
+	}
+}
+
+
+const FrameType MmapDataSet::GetFrameType(const unsigned long channelIdx) const
+{
+	verify(channelIdx < channel.size());
+
+	switch(channel[channelIdx].format)
+	{
+		case FORMAT_UINT8:
+			return FRAME_UINT8;
+
+		case FORMAT_FP16:
+			return FRAME_FP16;
+
+		default:
+			return FRAME_FLOAT;
+	}
+}
+
+
+void MmapDataSet::GetCompactFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+		const unsigned long frameIdx, void *const frame)
+{
+	verify(channelIdx < channel.size());
+	verify(seqIdx < nSeq);
+	verify(frameIdx < seqFrame[seqIdx + 1] - seqFrame[seqIdx]);
+
+	const Channel &c = channel[channelIdx];
+
+	verify(c.format == FORMAT_UINT8 || c.format == FORMAT_FP16);
+
+	memcpy(frame, c.data + (seqFrame[seqIdx] + frameIdx) * c.frameBytes, c.frameBytes);
+}
+
+
+void MmapDataSet::GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const
+{
+	verify(channelIdx < channel.size());
+	verify(channel[channelIdx].format == FORMAT_UINT8);
+
+	memcpy(table, channel[channelIdx].table, sizeof(FLOAT) * 256);
+}
+
+
+const MmapDataSet::Format MmapDataSet::GetFormat(const unsigned long channelIdx) const
+{
+	verify(channelIdx < channel.size());
+
+	return channel[channelIdx].format;
+}
+
+}
+
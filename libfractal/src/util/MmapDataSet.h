@@ -0,0 +1,100 @@
+/*
+   Copyright 2015 Kyuyeon Hwang (kyuyeon.hwang@gmail.com)
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef FRACTAL_MMAPDATASET_H_
+#define FRACTAL_MMAPDATASET_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "DataSet.h"
+#include "../core/FractalCommon.h"
+
+
+namespace fractal
+{
+
+/* Data set in one memory-mapped file, written from any data set by Write(). Opening takes constant
+ * time and the pages are shared through the page cache by all processes that read the same file.
+ *
+ * File layout (little endian):
+ *   header, nChannel channel headers, first frame of each sequence (nSeq + 1 uint64),
+ *   then one page-aligned block per channel holding the frames of all sequences in order.
+ *
+ * Formats of a channel:
+ *   FORMAT_FP32   FLOAT values
+ *   FORMAT_FP16   half precision, rounded to nearest even
+ *   FORMAT_UINT8  indices into a table of 256 values: the distinct values of the channel if there
+ *                 are at most 256 of them (lossless, e.g. 8-bit images), a uniform grid otherwise
+ *   FORMAT_LABEL  one uint32 class index per frame of a one-hot channel */
+class MmapDataSet : public DataSet
+{
+public:
+	enum Format {FORMAT_FP32, FORMAT_FP16, FORMAT_UINT8, FORMAT_LABEL};
+
+	MmapDataSet();
+	virtual ~MmapDataSet();
+
+	void Open(const std::string &filename);
+	void Close();
+
+	/* Converter: formats[channelIdx] is the format of each channel of dataSet */
+	static void Write(DataSet &dataSet, const std::vector<Format> &formats, const std::string &filename);
+
+	const unsigned long GetNumChannel() const;
+	const unsigned long GetDimension(const unsigned long channelIdx) const;
+	const unsigned long GetNumSeq() const;
+	const unsigned long GetNumFrame(const unsigned long seqIdx) const;
+
+	void GetFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+			const unsigned long frameIdx, FLOAT *const frame);
+
+	/* FORMAT_UINT8 and FORMAT_FP16 channels are compact (FRAME_UINT8 and FRAME_FP16) */
+	const FrameType GetFrameType(const unsigned long channelIdx) const;
+	void GetCompactFrameData(const unsigned long seqIdx, const unsigned long channelIdx,
+			const unsigned long frameIdx, void *const frame);
+	void GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const;
+
+	const Format GetFormat(const unsigned long channelIdx) const;
+
+protected:
+	class Channel
+	{
+	public:
+		Format format;
+		unsigned long dim;
+		unsigned long frameBytes;
+		const unsigned char *data;
+		FLOAT table[256]; /* FORMAT_UINT8 */
+	};
+
+	static const unsigned long FRAME_BYTES[];
+
+	int fd;
+	unsigned char *base;
+	unsigned long size;
+
+	unsigned long nSeq;
+	const uint64_t *seqFrame; /* nSeq + 1 entries */
+	std::vector<Channel> channel;
+};
+
+}
+
+#endif /* FRACTAL_MMAPDATASET_H_ */
+
@@ -40,6 +40,8 @@ Optimizer::Optimizer()
 	adadelta = false;
 
 	rmsprop = false;
+
+	checkpointInterval = 0;
 }
 
 
@@ -310,8 +312,10 @@ void Optimizer::Backprop(Rnn &rnn, Stream &stream, const PortMapList &inputPorts
 	std::vector<Probe> inputProbe(args.nInput);
 	std::vector<Probe> outputProbe(args.nOutput);
 
-	std::vector<Matrix<FLOAT>> input(args.nInput);
+	std::vector<InputBuffer> input(args.nInput);
 	std::vector<Matrix<FLOAT>> target(args.nOutput);
+	std::vector<Matrix<FLOAT>> inputHistory(args.nInput);
+	std::vector<Matrix<FLOAT>> targetHistory(args.nOutput);
 	std::vector<unsigned long> inputChannel(args.nInput);
 	std::vector<unsigned long> outputChannel(args.nOutput);
 
@@ -330,6 +334,10 @@ void Optimizer::Backprop(Rnn &rnn, Stream &stream, const PortMapList &inputPorts
 	args.outputChannel = outputChannel.data();
 	args.input = input.data();
 	args.target = target.data();
+	args.inputHistory = inputHistory.data();
+	args.targetHistory = targetHistory.data();
+	args.segmentSize = 0;
+	args.nCheckpoint = 0;
 
 	//verify(numFrame % nStream == 0);
 	verify(args.numFrame % (args.nStream * stepSize) == 0);
@@ -348,8 +356,13 @@ void Optimizer::Backprop(Rnn &rnn, Stream &stream, const PortMapList &inputPorts
 		unsigned long dim = stream.GetDimension(inputChannel[i]);
 		verify(inputProbe[i].GetLayerSize() == dim);
 
-		input[i].Resize(dim, args.frameStep);
-		input[i].SetEngine(engine);
+		input[i].Init(stream, inputChannel[i], args.frameStep, engine);
+
+		if(checkpointInterval > 0)
+		{
+			inputHistory[i].Resize(dim, args.batchSize);
+			inputHistory[i].SetEngine(engine);
+		}
 	}
 
 	portIter_end = outputPorts.end();
@@ -367,13 +380,39 @@ void Optimizer::Backprop(Rnn &rnn, Stream &stream, const PortMapList &inputPorts
 
 		target[i].Resize(dim, args.frameStep);
 		target[i].SetEngine(engine);
+
+		if(checkpointInterval > 0)
+		{
+			targetHistory[i].Resize(dim, args.frameStep);
+			targetHistory[i].SetEngine(engine);
+		}
 	}
 
 
 	/* Initialize the RNN */
-	rnn.SetBatchSize(args.batchSize);
-	//rnn.InitForward(args.batchSize - args.nStream, args.batchSize - 1);
-	rnn.InitForward(0, args.batchSize - 1);
+	if(checkpointInterval > 0)
+	{
+		/* Gradient checkpointing: the RNN holds a single segment of checkpointInterval frames.
+		 * The recurrent state is saved at every segment boundary of the window, and the
+		 * activations of the older segments are recomputed during the backward pass.
+		 * With checkpointInterval ~ sqrt(windowSize), the memory scales as sqrt(windowSize). */
+		verify(windowSize % checkpointInterval == 0 && stepSize % checkpointInterval == 0);
+		verify(checkpointInterval >= rnn.GetMaxDelay());
+
+		args.segmentSize = checkpointInterval * args.nStream;
+		args.nCheckpoint = windowSize / checkpointInterval + 1;
+
+		rnn.SetBatchSize(args.segmentSize);
+		rnn.InitForward(0, args.segmentSize - 1);
+		rnn.SetCheckpoint(args.nCheckpoint, rnn.GetMaxDelay() * args.nStream);
+		rnn.SaveCheckpoint(0);
+	}
+	else
+	{
+		rnn.SetBatchSize(args.batchSize);
+		//rnn.InitForward(args.batchSize - args.nStream, args.batchSize - 1);
+		rnn.InitForward(0, args.batchSize - 1);
+	}
         rnn.EnableDropout(true);
 
 	/* Main loop */
@@ -437,9 +476,7 @@ void Optimizer::BackpropPipe0(Optimizer *optimizer, BackpropArgs &args)
 			{
 				for(unsigned long j = 0; j < args.nInput; j++)
 				{
-					unsigned long dim = args.stream->GetDimension(args.inputChannel[j]);
-					args.stream->GenerateFrame(streamIdx, args.inputChannel[j],
-							args.input[j].GetHostData() + (i * args.nStream + streamIdx) * dim);
+					args.input[j].GenerateFrame(*args.stream, streamIdx, i * args.nStream + streamIdx);
 				}
 
 				for(unsigned long j = 0; j < args.nOutput; j++)
@@ -473,8 +510,7 @@ void Optimizer::BackpropPipe1(Optimizer *optimizer, BackpropArgs &args)
 		for(unsigned long i = 0; i < args.nInput; i++)
 		{
 			args.input[i].HostPush();
-			engine->MemPull(args.input[i].GetMem(), LOC, optimizer->pStreamDataTransferToBuf);
-			//args.input[i].Pull(LOC, optimizer->pStreamDataTransferToBuf);
+			args.input[i].MemPull(LOC, optimizer->pStreamDataTransferToBuf);
 		}
 
 		for(unsigned long i = 0; i < args.nOutput; i++)
@@ -504,18 +540,46 @@ void Optimizer::BackpropPipe2(Optimizer *optimizer, BackpropArgs &args)
 		optimizer->pipe[2].Wait(2);
 
 		//args.rnn->Synchronize();
+
+		/* The history buffers may still be read by the recomputation of the previous window */
+		if(args.segmentSize > 0)
+			args.rnn->Synchronize();
 		engine->StreamWaitEvent(optimizer->pStreamDataTransferToRnn, optimizer->pEventDataTransferToBuf);
 		args.rnn->StreamWait(optimizer->pStreamDataTransferToRnn);
 
 
 		/* Copy the sequences to the RNN */
 
+		if(args.segmentSize > 0)
+		{
+			/* Gradient checkpointing: keep the sequences for the recomputation */
+			for(unsigned long i = 0; i < args.nInput; i++)
+			{
+				Matrix<FLOAT> historySub(args.inputHistory[i], batchFrom, batchTo);
+
+				args.input[i].CopyTo(historySub, optimizer->pStreamDataTransferToRnn);
+			}
+
+			for(unsigned long i = 0; i < args.nOutput; i++)
+			{
+				Matrix<FLOAT> historySub(args.targetHistory[i], 0, batchTo - batchFrom);
+				Matrix<FLOAT> targetSub(args.target[i], 0, batchTo - batchFrom);
+
+				engine->MatCopy(targetSub, historySub, optimizer->pStreamDataTransferToRnn);
+			}
+
+			engine->StreamSynchronize(optimizer->pStreamDataTransferToRnn);
+
+			optimizer->pipe[1].SendSignal();
+			optimizer->pipe[3].SendSignal();
+			continue;
+		}
+
 		for(unsigned long i = 0; i < args.nInput; i++)
 		{
 			Matrix<FLOAT> stateSub(args.inputProbe[i].GetState(), batchFrom, batchTo);
-			Matrix<FLOAT> inputSub(args.input[i], 0, batchTo - batchFrom);
 
-			engine->MatCopy(inputSub, stateSub, optimizer->pStreamDataTransferToRnn);
+			args.input[i].CopyTo(stateSub, optimizer->pStreamDataTransferToRnn);
 
 			engine->EventRecord(optimizer->pEventDataTransferToRnn, optimizer->pStreamDataTransferToRnn);
 			engine->StreamWaitEvent(args.inputProbe[i].GetPStream(), optimizer->pEventDataTransferToRnn);
@@ -551,6 +615,14 @@ void Optimizer::BackpropPipe3(Optimizer *optimizer, BackpropArgs &args)
 	{
 		optimizer->pipe[3].Wait(1);
 
+		if(args.segmentSize > 0)
+		{
+			BackpropCheckpoint(optimizer, args, frameIdx);
+
+			optimizer->pipe[2].SendSignal();
+			continue;
+		}
+
 		unsigned long batchFrom = frameIdx % args.batchSize;
 		unsigned long batchTo = batchFrom + std::min(args.numFrame - frameIdx, args.frameStep) - 1;
 		unsigned long nForwardFrame = batchTo - batchFrom + 1;
@@ -630,6 +702,117 @@ void Optimizer::BackpropPipe3(Optimizer *optimizer, BackpropArgs &args)
 		optimizer->pipe[2].SendSignal();
 	}
 }
+
+
+void Optimizer::BackpropCheckpoint(Optimizer *optimizer, BackpropArgs &args, const unsigned long frameIdx)
+{
+	Engine *engine = args.rnn->GetEngine();
+
+	unsigned long segSize = args.segmentSize;
+	unsigned long nForwardFrame = std::min(args.numFrame - frameIdx, args.frameStep);
+
+	/* Segments are numbered from the beginning of the sequence;
+	 * checkpoint (segIdx % nCheckpoint) holds the state entering the segment */
+	unsigned long segFirst = frameIdx / segSize;
+	unsigned long segEnd = (frameIdx + nForwardFrame) / segSize;
+	unsigned long segBegin = segEnd - std::min(segEnd, args.batchSize / segSize);
+
+
+	/* Forward pass over the new frames, saving the state at the segment boundaries */
+	args.rnn->LoadCheckpoint(segFirst % args.nCheckpoint);
+
+	for(unsigned long segIdx = segFirst; segIdx < segEnd; segIdx++)
+	{
+		if(segIdx > segFirst)
+			args.rnn->SaveCheckpoint(segIdx % args.nCheckpoint);
+
+		LoadSegmentInput(args, segIdx);
+
+		args.rnn->GenerateDropoutMask(0, segSize - 1);
+		args.rnn->SaveDropoutMask(segIdx % args.nCheckpoint);
+		args.rnn->Forward(0, segSize - 1, args.nStream);
+	}
+
+	args.rnn->SaveCheckpoint(segEnd % args.nCheckpoint);
+
+
+	/* Backward pass over the window, recomputing the activations of each segment from its checkpoint */
+	args.rnn->InitBackward(0, segSize - 1);
+
+	for(unsigned long segIdx = segEnd; segIdx-- > segBegin;)
+	{
+		/* The activations of the newest segment are still in the RNN */
+		if(segIdx + 1 < segEnd)
+		{
+			args.rnn->LoadCheckpoint(segIdx % args.nCheckpoint);
+
+			LoadSegmentInput(args, segIdx);
+
+			/* Same dropout masks as in the forward pass that saved the checkpoint of the next segment */
+			args.rnn->LoadDropoutMask(segIdx % args.nCheckpoint);
+			args.rnn->Forward(0, segSize - 1, args.nStream);
+		}
+
+
+		/* Compute output errors (only the new frames have targets) */
+		for(unsigned long i = 0; i < args.nOutput; i++)
+		{
+			Matrix<FLOAT> &act = args.outputProbe[i].GetActivation();
+			Matrix<FLOAT> &err = args.outputProbe[i].GetError();
+
+			args.outputProbe[i].Wait();
+
+			engine->MatSet(err, (FLOAT) 0, args.outputProbe[i].GetPStream());
+
+			if(segIdx >= segFirst)
+			{
+				Matrix<FLOAT> targetSub(args.targetHistory[i], (segIdx - segFirst) * segSize, (segIdx - segFirst + 1) * segSize - 1);
+
+				/* err = target - act */
+				engine->MatCopy(targetSub, err, args.outputProbe[i].GetPStream());
+				engine->MatAdd(act, err, (FLOAT) -1, args.outputProbe[i].GetPStream());
+			}
+
+			args.outputProbe[i].EventRecord();
+		}
+
+
+		/* Compute derivatives of the activation functions */
+		args.rnn->CalcActDeriv(0, segSize - 1);
+
+
+		/* Backward pass; the errors of the delayed connections carry over to the previous segment */
+		args.rnn->Backward(0, segSize - 1, args.nStream);
+
+		args.rnn->AccumulateGradients(0, segSize - 1);
+	}
+
+
+	/* Update weights */
+	args.rnn->UpdateWeights(0, segSize - 1, nForwardFrame,
+			optimizer->learningRate, optimizer->momentum, optimizer->adadelta, optimizer->rmsprop);
+}
+
+
+void Optimizer::LoadSegmentInput(BackpropArgs &args, const unsigned long segIdx)
+{
+	Engine *engine = args.rnn->GetEngine();
+
+	unsigned long segSize = args.segmentSize;
+	unsigned long histFrom = (segIdx * segSize) % args.batchSize;
+
+	/* The previous segment may still read the inputs */
+	args.rnn->Synchronize();
+
+	for(unsigned long i = 0; i < args.nInput; i++)
+	{
+		Matrix<FLOAT> historySub(args.inputHistory[i], histFrom, histFrom + segSize - 1);
+
+		engine->MatCopy(historySub, args.inputProbe[i].GetState(), args.inputProbe[i].GetPStream());
+
+		args.inputProbe[i].EventRecord();
+	}
+}
 #endif
 
 
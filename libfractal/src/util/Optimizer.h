@@ -18,6 +18,7 @@
 #ifndef FRACTAL_OPTIMIZER_H_
 #define FRACTAL_OPTIMIZER_H_
 
+#include "InputBuffer.h"
 #include "Pipe.h"
 #include "PortMap.h"
 #include "Stream.h"
@@ -47,8 +48,14 @@ public:
 	unsigned long *inputChannel;
 	unsigned long *outputChannel;
 
-	Matrix<FLOAT> *input;
+	InputBuffer *input;
 	Matrix<FLOAT> *target;
+
+	/* Gradient checkpointing */
+	unsigned long segmentSize;
+	unsigned long nCheckpoint;
+	Matrix<FLOAT> *inputHistory;
+	Matrix<FLOAT> *targetHistory;
 };
 
 
@@ -66,17 +73,21 @@ public:
 	inline void SetMomentum(const FLOAT val) { momentum = val; }
 	inline void SetAdadelta(const bool val) { adadelta = val; }
 	inline void SetRmsprop(const bool val) { rmsprop = val; }
+	inline void SetCheckpointInterval(const unsigned long val) { checkpointInterval = val; }
 
 	inline const FLOAT GetLearningRate() { return learningRate; }
 	inline const FLOAT GetMomentum() { return momentum; }
 	inline const bool GetAdadelta() { return adadelta; }
 	inline const bool GetRmsprop() { return rmsprop; }
+	inline const unsigned long GetCheckpointInterval() { return checkpointInterval; }
 
 protected:
 	static void BackpropPipe0(Optimizer *optimizer, BackpropArgs &args);
 	static void BackpropPipe1(Optimizer *optimizer, BackpropArgs &args);
 	static void BackpropPipe2(Optimizer *optimizer, BackpropArgs &args);
 	static void BackpropPipe3(Optimizer *optimizer, BackpropArgs &args);
+	static void BackpropCheckpoint(Optimizer *optimizer, BackpropArgs &args, const unsigned long frameIdx);
+	static void LoadSegmentInput(BackpropArgs &args, const unsigned long segIdx);
 
 	FLOAT learningRate;
 	FLOAT momentum;
@@ -89,6 +100,9 @@ protected:
 
 	bool adadelta;
 	bool rmsprop;
+
+	/* Store the recurrent state every checkpointInterval frames and recompute the rest (0: disabled) */
+	unsigned long checkpointInterval;
 };
 
 }
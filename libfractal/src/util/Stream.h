@@ -20,6 +20,7 @@
 
 #include <vector>
 
+#include "DataSet.h"
 #include "../core/FractalCommon.h"
 
 
@@ -39,6 +40,11 @@ public:
 	virtual void Reset() = 0;
 	virtual void Next(const unsigned long streamIdx) = 0;
 	virtual void GenerateFrame(const unsigned long streamIdx, const unsigned long channelIdx, FLOAT *const frame) = 0;
+
+	/* Compact channels (optional, see DataSet::GetFrameType) */
+	virtual const FrameType GetFrameType(const unsigned long channelIdx) const { return FRAME_FLOAT; }
+	virtual void GenerateCompactFrame(const unsigned long streamIdx, const unsigned long channelIdx, void *const frame) { verify(false); }
+	virtual void GetDequantTable(const unsigned long channelIdx, FLOAT *const table) const { verify(false); }
 };
 
 